@@ -0,0 +1,199 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct _Bench {
+    const char *name;
+    BenchFunc func;
+} Bench;
+
+typedef struct _BenchResult {
+    double nsPerIter;
+    int64_t iterations;
+    const char *counterName;
+    double counter;
+} BenchResult;
+
+static Bench benches[BENCH_MAX];
+static int numBenches = 0;
+
+static int64_t _now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int _compare_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+void register_bench(const char *name, BenchFunc func) {
+    if(numBenches >= BENCH_MAX) {
+        fprintf(stderr, "Error: more than %d benchmarks, %s left out.\n", BENCH_MAX, name);
+        return;
+    }
+
+    benches[numBenches].name = name;
+    benches[numBenches].func = func;
+    numBenches++;
+}
+
+void pause_timing(BenchState *state) {
+    state->pauseStart = _now_ns();
+}
+
+void resume_timing(BenchState *state) {
+    state->pausedNs += _now_ns() - state->pauseStart;
+}
+
+void set_bench_counter(BenchState *state, const char *name, const double value) {
+    state->counterName = name;
+    state->counter = value;
+}
+
+// Time of one run of iterations, paused time taken out
+static int64_t _run(const Bench *bench, BenchState *state, const int64_t iterations) {
+    memset(state, 0, sizeof(*state));
+    state->iterations = iterations;
+
+    int64_t start = _now_ns();
+    bench->func(state);
+    return _now_ns() - start - state->pausedNs;
+}
+
+static void _measure(const Bench *bench, const int minTimeMs, BenchResult *result) {
+    BenchState state;
+    int64_t minNs = (int64_t)minTimeMs * 1000000;
+    int64_t iterations = 1;
+    int64_t ns;
+
+    // Grow the loop until one run is long enough to time well
+    while((ns = _run(bench, &state, iterations)) < minNs && iterations < ((int64_t)1 << 40)) {
+        int64_t next = (ns > 0) ? (iterations * minNs * 14 / 10) / ns : iterations * 100;
+        if(next > iterations * 100)
+            next = iterations * 100;
+        iterations = (next > iterations) ? next : iterations * 2;
+    }
+
+    double times[BENCH_REPETITIONS];
+    for(int i = 0; i < BENCH_REPETITIONS; i++) {
+        times[i] = (double)_run(bench, &state, iterations) / iterations;
+    }
+    qsort(times, BENCH_REPETITIONS, sizeof(double), _compare_double);
+
+    result->nsPerIter = times[BENCH_REPETITIONS / 2];
+    result->iterations = iterations;
+    result->counterName = state.counterName;
+    result->counter = state.counterName ? state.counter / iterations : 0;
+}
+
+static void _write_json(FILE *f, const Bench *run[], const BenchResult results[], const int num) {
+    time_t now = time(NULL);
+    char date[32];
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    fprintf(f, "{\n  \"context\": {\n");
+    fprintf(f, "    \"date\": \"%s\",\n", date);
+    fprintf(f, "    \"compiler\": \"%s\",\n", __VERSION__);
+    fprintf(f, "    \"repetitions\": %d\n  },\n", BENCH_REPETITIONS);
+    fprintf(f, "  \"benchmarks\": [\n");
+
+    for(int i = 0; i < num; i++) {
+        fprintf(f, "    { \"name\": \"%s\", \"ns_per_iter\": %.3f, \"iterations\": %lld",
+            run[i]->name, results[i].nsPerIter, (long long)results[i].iterations);
+        if(results[i].counterName)
+            fprintf(f, ", \"%s\": %.1f", results[i].counterName, results[i].counter);
+        fprintf(f, " }%s\n", (i < num - 1) ? "," : "");
+    }
+
+    fprintf(f, "  ]\n}\n");
+}
+
+static void _usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [--filter <substring>] [--min-time <ms>] [--json <file>] [--list]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    const char *filter = NULL;
+    const char *jsonPath = NULL;
+    int minTimeMs = BENCH_MIN_TIME_MS;
+    int isList = 0;
+
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if(strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            minTimeMs = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else if(strcmp(argv[i], "--list") == 0) {
+            isList = 1;
+        } else {
+            _usage(argv[0]);
+        }
+    }
+
+    const Bench *run[BENCH_MAX];
+    BenchResult results[BENCH_MAX];
+    int num = 0;
+
+    for(int i = 0; i < numBenches; i++) {
+        if(filter == NULL || strstr(benches[i].name, filter) != NULL)
+            run[num++] = &benches[i];
+    }
+
+    if(isList) {
+        for(int i = 0; i < num; i++)
+            printf("%s\n", run[i]->name);
+        return 0;
+    }
+
+    printf("%-36s %12s %14s\n", "Benchmark", "ns/iter", "iterations");
+    for(int i = 0; i < num; i++) {
+        _measure(run[i], minTimeMs, &results[i]);
+
+        printf("%-36s %12.2f %14lld", run[i]->name, results[i].nsPerIter, (long long)results[i].iterations);
+        if(results[i].counterName)
+            printf("   %s=%.1f", results[i].counterName, results[i].counter);
+        printf("\n");
+        fflush(stdout);
+    }
+
+    if(jsonPath != NULL) {
+        FILE *f = fopen(jsonPath, "w");
+        if(f == NULL) {
+            fprintf(stderr, "Error: can't write %s.\n", jsonPath);
+            return 1;
+        }
+        _write_json(f, run, results, num);
+        fclose(f);
+    }
+
+    return 0;
+}
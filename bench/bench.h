@@ -0,0 +1,71 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+// A small Google Benchmark style harness for timing game code on the host.
+//
+//     BENCH(is_valid_move_empty) {
+//         for(int64_t i = 0; i < state->iterations; i++)
+//             bench_keep(is_valid_move(...));
+//     }
+//
+// Each benchmark runs its loop with more iterations until it takes at least
+// the minimum time, then is run BENCH_REPETITIONS times more and reports the
+// median time per iteration. Anything a benchmark has to do between
+// iterations that should not be counted goes between pause_timing and
+// resume_timing, each of which costs a clock read.
+
+#define BENCH_MAX 64
+#define BENCH_REPETITIONS 5
+#define BENCH_MIN_TIME_MS 200
+
+typedef struct _BenchState {
+    int64_t iterations;     // Times to run the body
+    int64_t pausedNs;       // Time spent paused this run
+    int64_t pauseStart;
+    const char *counterName;
+    double counter;         // Reported per iteration, e.g. primitive bytes
+} BenchState;
+
+typedef void (*BenchFunc)(BenchState *state);
+
+void register_bench(const char *name, BenchFunc func);
+
+#define BENCH(name) \
+    static void name(BenchState *state); \
+    __attribute__((constructor)) static void _register_##name(void) { register_bench(#name, name); } \
+    static void name(BenchState *state)
+
+void pause_timing(BenchState *state);
+void resume_timing(BenchState *state);
+
+// Reports value, a total over all the iterations, per iteration next to
+// the time
+void set_bench_counter(BenchState *state, const char *name, const double value);
+
+// Stops the compiler dropping a result nothing reads, or assuming memory
+// didn't change between iterations
+#define bench_keep(value) do { __typeof__(value) _v = (value); __asm__ volatile("" : : "g"(_v) : "memory"); } while(0)
+#define bench_clobber() __asm__ volatile("" : : : "memory")
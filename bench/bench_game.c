@@ -0,0 +1,453 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+// Benchmarks of the rules and draw code in src/main.c. The game is compiled
+// in whole so its static state and helpers can be reached, with the engine
+// behind it either built for the host (graphics2d.c, text.c, input.c,
+// arena.c, vram.c) or stubbed out in engine_stubs.c. Primitives are built
+// into the real RenderContext, only the GPU calls behind it are mocks.
+
+#define main tetrade_main
+#include "../src/main.c"
+#undef main
+
+#include "bench.h"
+
+// Room left in the primitive buffer before it is flipped, more than a
+// frame of the busiest board draws
+#define PRIM_MARGIN 8192
+
+// Rows of the stacked board, ~ the middle of a marathon
+#define STACK_HEIGHT 12
+
+static int isSetUp = 0;
+
+static RECT atlasPixels = { 640, 0, 64, 256 };
+static RECT atlasCluts = { 0, 480, 16, 16 };
+static TIM_IMAGE atlas = { 0x8, &atlasCluts, NULL, &atlasPixels, NULL };
+
+static int stackBoard[MATRIX_HEIGHT][MATRIX_WIDTH];
+static int fullBoard[MATRIX_HEIGHT][MATRIX_WIDTH];
+static int linesBoards[5][MATRIX_HEIGHT][MATRIX_WIDTH];
+
+// Bottom rows of matrix filled, each with one hole unless isFull
+static void _fill_rows(int matrix[MATRIX_HEIGHT][MATRIX_WIDTH], const int from, const int to, const int isFull) {
+    for(int row = from; row < to; row++) {
+        for(int col = 0; col < MATRIX_WIDTH; col++) {
+            matrix[MATRIX_HEIGHT-1-row][col] = 1 + (row + col) % NUM_TETRIMINO_TYPES;
+        }
+        if(!isFull)
+            matrix[MATRIX_HEIGHT-1-row][(row * 7) % MATRIX_WIDTH] = 0;
+    }
+}
+
+// The sprites and text init_game would load from the archive, cut from a
+// made up atlas
+static void _setup_sprites(void) {
+    int charNum = 95;
+    gameCtx.scoreText.spritesList = alloc_arena(&sceneArena, sizeof(Sprite)*charNum);
+    char charList[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz1234567890!\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~";
+    load_text(&(gameCtx.scoreText), charList, &SPRITES_TEXT, &atlas, charNum);
+
+    charNum = 39;
+    gameCtx.bigText.spritesList = alloc_arena(&sceneArena, sizeof(Sprite)*charNum);
+    char charList2[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890!?";
+    load_text(&(gameCtx.bigText), charList2, &SPRITES_BIG_FONT, &atlas, charNum);
+
+    int numMinos = NUM_TETRIMINO_TYPES + NUM_TETRIMINO_EXTRAS;
+    Sprite minos[numMinos*2];
+    Sprite minosSmall[numMinos];
+
+    load_atlas_sheet(minos, numMinos*2, &SPRITES_BLOCKS, &atlas);
+    load_atlas_sheet(minosSmall, numMinos, &SPRITES_BLOCKS_SMALL, &atlas);
+
+    for(int i = 0; i < numMinos; i++) {
+        gameCtx.tetriminoSprites[i] = minos[i];
+        gameCtx.tetriminoGhostSprites[i] = minos[numMinos + i];
+        gameCtx.tetriminoSmallSprites[i] = minosSmall[i];
+        gameCtx.tetriminoSmallGhostSprites[i] = minosSmall[i];
+    }
+}
+
+static void _setup(void) {
+    if(isSetUp)
+        return;
+
+    init_arenas();
+    init_gfx();
+    _setup_sprites();
+
+    gameCtx.settings.isRandomBag = 1;
+    gameCtx.settings.das = DEFAULT_DAS;
+    gameCtx.settings.arr = DEFAULT_ARR;
+    gameCtx.settings.sdf = DEFAULT_SDF;
+
+    _fill_rows(stackBoard, 0, STACK_HEIGHT, 0);
+    _fill_rows(fullBoard, 0, MATRIX_HEIGHT-2, 0);
+
+    // n full rows under the same stack
+    for(int n = 0; n <= 4; n++) {
+        _fill_rows(linesBoards[n], 0, STACK_HEIGHT, 0);
+        _fill_rows(linesBoards[n], 0, n, 1);
+    }
+
+    isSetUp = 1;
+}
+
+// A board as init_tetris_game leaves it, with a fixed seed
+static TetradeGame *_new_board(const int slot, const int numBoards) {
+    _setup();
+
+    TetradeGame *game = &boards[slot];
+    layout_board(game, slot, numBoards);
+    game->opponent = NULL;
+    game->controller = slot;
+    game->settings = &(gameCtx.settings);
+    start_tetris_game(game, 12345);
+
+    game->pauseTimer.time = 0;
+    set_input_frame(slot, 0, 0);
+    return game;
+}
+
+static void _set_piece(TetradeGame *game, const int type, const int x, const int y) {
+    pick_tetrimino(&(game->tetrimino), type);
+    game->tetrimino.x = x;
+    game->tetrimino.y = y;
+}
+
+// Flips the primitive buffer before it runs out, outside the timing
+static void _make_prim_room(BenchState *state) {
+    if(get_prim_bytes() > PRIM_BUFFER_LEN - PRIM_MARGIN) {
+        pause_timing(state);
+        display();
+        resume_timing(state);
+    }
+}
+
+
+// Rules
+
+BENCH(is_valid_move_open) {
+    TetradeGame *game = _new_board(0, 2);
+    _set_piece(game, 7, CENTER, 2);
+
+    for(int64_t i = 0; i < state->iterations; i++) {
+        bench_keep(is_valid_move(game->tetrimino.x, game->tetrimino.y, &(game->tetrimino), game->matrix));
+        bench_clobber();
+    }
+}
+
+BENCH(is_valid_move_blocked) {
+    TetradeGame *game = _new_board(0, 2);
+    memcpy(game->matrix, stackBoard, sizeof(stackBoard));
+    _set_piece(game, 7, CENTER, MATRIX_HEIGHT - STACK_HEIGHT - 1);
+
+    for(int64_t i = 0; i < state->iterations; i++) {
+        bench_keep(is_valid_move(game->tetrimino.x, game->tetrimino.y, &(game->tetrimino), game->matrix));
+        bench_clobber();
+    }
+}
+
+// Every position of a piece over the stack, as a placement search would
+BENCH(is_valid_move_sweep) {
+    TetradeGame *game = _new_board(0, 2);
+    memcpy(game->matrix, stackBoard, sizeof(stackBoard));
+    _set_piece(game, 3, 0, 0);
+
+    for(int64_t i = 0; i < state->iterations; i++) {
+        int valid = 0;
+        for(int y = -1; y < MATRIX_HEIGHT; y++) {
+            for(int x = -1; x < MATRIX_WIDTH; x++) {
+                valid += is_valid_move(x, y, &(game->tetrimino), game->matrix);
+            }
+        }
+        bench_keep(valid);
+        bench_clobber();
+    }
+}
+
+BENCH(rotate_tetrimino_free) {
+    TetradeGame *game = _new_board(0, 2);
+    _set_piece(game, 7, CENTER, 4);
+    Tetrimino start = game->tetrimino;
+
+    for(int64_t i = 0; i < state->iterations; i++) {
+        game->tetrimino = start;
+        rotate_tetrimino(1, game);
+        bench_clobber();
+    }
+}
+
+// T on the floor, the third kick test lifts it out
+BENCH(rotate_tetrimino_floor_kick) {
+    TetradeGame *game = _new_board(0, 2);
+    _set_piece(game, 7, CENTER, MATRIX_HEIGHT-2);
+    Tetrimino start = game->tetrimino;
+
+    for(int64_t i = 0; i < state->iterations; i++) {
+        game->tetrimino = start;
+        rotate_tetrimino(1, game);
+        bench_clobber();
+    }
+}
+
+// I against the left wall, kicked right
+BENCH(rotate_tetrimino_wall_kick_i) {
+    TetradeGame *game = _new_board(0, 2);
+    _set_piece(game, 1, CENTER, 4);
+    rotate_tetrimino(1, game);
+    game->tetrimino.x = -2;
+    Tetrimino start = game->tetrimino;
+
+    for(int64_t i = 0; i < state->iterations; i++) {
+        game->tetrimino = start;
+        rotate_tetrimino(1, game);
+        bench_clobber();
+    }
+}
+
+// Boxed in, every kick test fails
+BENCH(rotate_tetrimino_all_kicks_fail) {
+    TetradeGame *game = _new_board(0, 2);
+    _set_piece(game, 7, CENTER, 8);
+    for(int row = 0; row < MATRIX_HEIGHT; row++) {
+        for(int col = 0; col < MATRIX_WIDTH; col++) {
+            game->matrix[row][col] = 8;
+        }
+    }
+    for(int i = 0; i < 4; i++) {
+        for(int j = 0; j < 4; j++) {
+            if(game->tetrimino.shape[i][j] > 0)
+                game->matrix[game->tetrimino.y+i][game->tetrimino.x+j] = 0;
+        }
+    }
+    Tetrimino start = game->tetrimino;
+
+    for(int64_t i = 0; i < state->iterations; i++) {
+        game->tetrimino = start;
+        rotate_tetrimino(1, game);
+        bench_clobber();
+    }
+}
+
+BENCH(last_valid_y_empty) {
+    TetradeGame *game = _new_board(0, 2);
+    _set_piece(game, 7, CENTER, 0);
+
+    for(int64_t i = 0; i < state->iterations; i++) {
+        bench_keep(last_valid_y(game));
+        bench_clobber();
+    }
+}
+
+BENCH(last_valid_y_stack) {
+    TetradeGame *game = _new_board(0, 2);
+    memcpy(game->matrix, stackBoard, sizeof(stackBoard));
+    _set_piece(game, 7, CENTER, 0);
+
+    for(int64_t i = 0; i < state->iterations; i++) {
+        bench_keep(last_valid_y(game));
+        bench_clobber();
+    }
+}
+
+// What the check_lines benchmarks spend putting the board back
+BENCH(board_copy) {
+    TetradeGame *game = _new_board(0, 2);
+
+    for(int64_t i = 0; i < state->iterations; i++) {
+        memcpy(game->matrix, linesBoards[0], sizeof(game->matrix));
+        bench_clobber();
+    }
+}
+
+static void _bench_check_lines(BenchState *state, const int lines) {
+    TetradeGame *game = _new_board(0, 2);
+
+    for(int64_t i = 0; i < state->iterations; i++) {
+        memcpy(game->matrix, linesBoards[lines], sizeof(game->matrix));
+        game->singleLine = game->doubleLine = game->tripleLine = game->tetrade = 0;
+        check_lines(game);
+        bench_clobber();
+    }
+}
+
+BENCH(check_lines_0) { _bench_check_lines(state, 0); }
+BENCH(check_lines_1) { _bench_check_lines(state, 1); }
+BENCH(check_lines_2) { _bench_check_lines(state, 2); }
+BENCH(check_lines_3) { _bench_check_lines(state, 3); }
+BENCH(check_lines_4) { _bench_check_lines(state, 4); }
+
+// A tetris in versus, four rows of garbage for the opponent too
+BENCH(check_lines_4_versus) {
+    TetradeGame *game = _new_board(0, 2);
+    TetradeGame *opponent = _new_board(1, 2);
+    game->opponent = opponent;
+    opponent->opponent = game;
+
+    for(int64_t i = 0; i < state->iterations; i++) {
+        memcpy(game->matrix, linesBoards[4], sizeof(game->matrix));
+        game->singleLine = game->doubleLine = game->tripleLine = game->tetrade = 0;
+        check_lines(game);
+        bench_clobber();
+    }
+}
+
+BENCH(add_garbage_stack) {
+    TetradeGame *game = _new_board(0, 2);
+    memcpy(game->matrix, stackBoard, sizeof(stackBoard));
+
+    for(int64_t i = 0; i < state->iterations; i++) {
+        add_garbage(game->matrix, &(game->rng));
+        bench_clobber();
+    }
+}
+
+// step_game spawning the next piece, with and without refilling the bag
+static void _bench_spawn(BenchState *state, const int isRefill) {
+    TetradeGame *game = _new_board(0, 2);
+    memcpy(game->matrix, stackBoard, sizeof(stackBoard));
+    int count = isRefill ? NUM_TETRIMINO_TYPES+1 : NUM_NEXT_TETRIMINOS;
+
+    for(int64_t i = 0; i < state->iterations; i++) {
+        game->tetrimino.type = -1;
+        game->nextTCount = count;
+        step_game(game);
+        bench_clobber();
+    }
+}
+
+BENCH(step_game_spawn) { _bench_spawn(state, 0); }
+BENCH(step_game_spawn_refill) { _bench_spawn(state, 1); }
+
+// A whole board frame, rules and draw, with a piece falling over the stack
+BENCH(play_game_frame) {
+    TetradeGame *game = _new_board(0, 2);
+    memcpy(game->matrix, stackBoard, sizeof(stackBoard));
+    _set_piece(game, 7, CENTER, 2);
+    game->holdTerimino = game->nextTetriminos[3];
+    Tetrimino start = game->tetrimino;
+    double bytes = 0;
+
+    for(int64_t i = 0; i < state->iterations; i++) {
+        _make_prim_room(state);
+        int before = get_prim_bytes();
+
+        game->tetrimino = start;
+        play_game(game);
+
+        bytes += get_prim_bytes() - before;
+    }
+
+    set_bench_counter(state, "prim_bytes", bytes);
+}
+
+
+// Primitive building
+
+static void _bench_draw_matrix(BenchState *state, const int board[MATRIX_HEIGHT][MATRIX_WIDTH], const int numBoards) {
+    TetradeGame *game = _new_board(0, numBoards);
+    memcpy(game->matrix, board, sizeof(game->matrix));
+    _set_piece(game, 7, CENTER, 0);
+    game->ghostY = last_valid_y(game);
+    game->holdTerimino = game->nextTetriminos[3];
+    double bytes = 0;
+
+    for(int64_t i = 0; i < state->iterations; i++) {
+        _make_prim_room(state);
+        int before = get_prim_bytes();
+
+        draw_matrix(game->matrixX, game->matrixY, game);
+
+        bytes += get_prim_bytes() - before;
+    }
+
+    set_bench_counter(state, "prim_bytes", bytes);
+}
+
+// The most a board can add in a frame, what BOARD_PRIM_BUDGET in
+// src/main.c has to cover: every cell filled as when it tops out, the piece
+// and its ghost, a held piece and the continue message
+static void _bench_draw_game_worst(BenchState *state, const int numBoards) {
+    TetradeGame *game = _new_board(0, numBoards);
+    _fill_rows(game->matrix, 0, MATRIX_HEIGHT, 1);
+    _set_piece(game, 1, CENTER, 0);
+    game->ghostY = MATRIX_HEIGHT-1;
+    game->holdTerimino = game->nextTetriminos[3];
+    game->isGameOver = 1;
+    game->gameTimer.time = 121;
+    double bytes = 0;
+
+    for(int64_t i = 0; i < state->iterations; i++) {
+        _make_prim_room(state);
+        int before = get_prim_bytes();
+
+        draw_game(game);
+
+        bytes += get_prim_bytes() - before;
+    }
+
+    set_bench_counter(state, "prim_bytes", bytes);
+}
+
+BENCH(draw_game_worst) { _bench_draw_game_worst(state, 2); }
+BENCH(draw_game_worst_compact) { _bench_draw_game_worst(state, 4); }
+
+static const int emptyBoard[MATRIX_HEIGHT][MATRIX_WIDTH];
+
+BENCH(draw_matrix_empty) { _bench_draw_matrix(state, emptyBoard, 2); }
+BENCH(draw_matrix_stack) { _bench_draw_matrix(state, stackBoard, 2); }
+BENCH(draw_matrix_full) { _bench_draw_matrix(state, fullBoard, 2); }
+BENCH(draw_matrix_full_compact) { _bench_draw_matrix(state, fullBoard, 4); }
+
+BENCH(print_text_score) {
+    _setup();
+    double bytes = 0;
+
+    for(int64_t i = 0; i < state->iterations; i++) {
+        _make_prim_room(state);
+        int before = get_prim_bytes();
+
+        print_text(&(gameCtx.scoreText), 108, 69, "%6d", 123456 + (int)(i & 0xff));
+
+        bytes += get_prim_bytes() - before;
+    }
+
+    set_bench_counter(state, "prim_bytes", bytes);
+}
+
+BENCH(print_text_message) {
+    _setup();
+    double bytes = 0;
+
+    for(int64_t i = 0; i < state->iterations; i++) {
+        _make_prim_room(state);
+        int before = get_prim_bytes();
+
+        print_text(&(gameCtx.bigText), 6, 42, "CONTINUE?");
+
+        bytes += get_prim_bytes() - before;
+    }
+
+    set_bench_counter(state, "prim_bytes", bytes);
+}
@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+"""
+Compares two runs of the host benchmarks (bench/build/bench --json), e.g.
+the results saved by make run before and after a change.
+
+Every benchmark in either run is listed with its time per iteration in each
+and the change. Changes past the threshold are marked, + slower, - faster;
+anything smaller is likely noise.
+
+Usage: compare.py <old.json> <new.json> [--threshold <percent>]
+       compare.py --latest <results dir> [--threshold <percent>]
+"""
+
+import json
+import os
+import sys
+
+DEFAULT_THRESHOLD = 5.0
+
+
+def read_results(path):
+    with open(path, "r") as f:
+        data = json.load(f)
+    return {b["name"]: b for b in data["benchmarks"]}
+
+
+def latest_two(directory):
+    paths = [os.path.join(directory, p) for p in os.listdir(directory) if p.endswith(".json")]
+    if len(paths) < 2:
+        sys.exit(f"{directory}: need two results to compare, make run saves one")
+    paths.sort(key=os.path.getmtime)
+    return paths[-2], paths[-1]
+
+
+def main(argv):
+    args = argv[1:]
+    threshold = DEFAULT_THRESHOLD
+
+    if "--threshold" in args:
+        i = args.index("--threshold")
+        threshold = float(args[i + 1])
+        del args[i:i + 2]
+
+    if len(args) == 2 and args[0] == "--latest":
+        old_path, new_path = latest_two(args[1])
+    elif len(args) == 2:
+        old_path, new_path = args
+    else:
+        sys.exit(__doc__)
+
+    old, new = read_results(old_path), read_results(new_path)
+    names = list(old) + [n for n in new if n not in old]
+
+    print(f"{os.path.basename(old_path)} -> {os.path.basename(new_path)}")
+    print(f"{'Benchmark':36} {'old ns':>12} {'new ns':>12} {'change':>9}")
+
+    slower = faster = 0
+    for name in names:
+        if name not in old or name not in new:
+            have = old.get(name) or new.get(name)
+            side = "new" if name in new else "old"
+            print(f"{name:36} {have['ns_per_iter']:12.2f} {'only in ' + side:>22}")
+            continue
+
+        a, b = old[name]["ns_per_iter"], new[name]["ns_per_iter"]
+        change = (b - a) * 100 / a if a else 0
+        mark = ""
+        if change > threshold:
+            mark = " +"
+            slower += 1
+        elif change < -threshold:
+            mark = " -"
+            faster += 1
+
+        print(f"{name:36} {a:12.2f} {b:12.2f} {change:8.1f}%{mark}")
+
+    print(f"{faster} faster, {slower} slower by more than {threshold:g}%")
+
+
+if __name__ == "__main__":
+    main(sys.argv)
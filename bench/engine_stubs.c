@@ -0,0 +1,97 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+// The parts of the engine bench_game.c doesn't measure and that need the
+// console: the system timer, sound, the CD, the memory card and the link
+// cable. They do nothing, except the timer which runs off the host clock.
+
+#include <string.h>
+#include <time.h>
+#include "timer.h"
+#include "audio.h"
+#include "voice.h"
+#include "spuram.h"
+#include "music.h"
+#include "cdload.h"
+#include "pak.h"
+#include "memcard.h"
+#include "netplay.h"
+
+static uint64_t _host_time_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Timer
+
+void create_timer(Timer *timer) { timer->time = 0; }
+void init_system_timer(void) {}
+uint32_t get_system_time(void) { return (uint32_t)(_host_time_us() / 1000); }
+uint32_t get_system_time_us(void) { return (uint32_t)_host_time_us(); }
+
+// Audio
+
+void init_audio(void) {}
+int play_sample(AudioSample *sample) { return -1; }
+void flush_audio(void) {}
+void update_spu_ram_clear(void) {}
+void init_sample_bank(SampleBank *bank) { memset(bank, 0, sizeof(*bank)); }
+void get_voice_stats(VoiceStats *stats) { memset(stats, 0, sizeof(*stats)); }
+void print_spu_ram_usage(void) {}
+
+int open_music(const char *name) { return 0; }
+void play_music(const int volume) {}
+void stop_music(void) {}
+void set_music_volume(const int volume) {}
+void set_music_speed(const int speed) {}
+void update_music(void) {}
+void get_music_stats(MusicStats *stats) { memset(stats, 0, sizeof(*stats)); }
+
+// CD and archive
+
+void init_cd_loader(void) {}
+void init_cd_request(CdLoadRequest *req, const char *filename) { memset(req, 0, sizeof(*req)); }
+int queue_cd_load(CdLoadRequest *req) { return 0; }
+int get_cd_reseeks(void) { return 0; }
+void update_cd_loader(void) {}
+void wait_cd_load(CdLoadRequest *req) {}
+
+int open_pak(const char *filename) { return 0; }
+void queue_pak_scene(PakScene *scene, PakLoad *loads, const int numLoads, CdLoadCallback onComplete) { scene->req.status = CD_LOAD_DONE; }
+void load_pak_scene(PakLoad *loads, const int numLoads) {}
+void add_pak_samples_to_bank(SampleBank *bank, const PakLoad *loads, const int numLoads) {}
+
+// Memory card
+
+void init_memcard(void) {}
+void init_card_job(CardJob *job, const int port, const char *filename) { memset(job, 0, sizeof(*job)); }
+int queue_card_job(CardJob *job) { return 0; }
+void update_memcard(void) {}
+
+// Link cable
+
+int serial_dropped(void) { return 0; }
+void start_netplay(const NetplayCallbacks *callbacks, const uint8_t hello[NETPLAY_HELLO_LEN]) {}
+void stop_netplay(void) {}
+NetplayState update_netplay(const uint16_t held) { return NETPLAY_OFF; }
+void get_netplay_stats(NetplayStats *stats) { memset(stats, 0, sizeof(*stats)); }
@@ -0,0 +1,73 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+#include <stdint.h>
+#define F_CPU 33868800UL
+#define _MMIO8(a) (*(volatile uint8_t *)(a))
+#define _MMIO16(a) (*(volatile uint16_t *)(a))
+#define _MMIO32(a) (*(volatile uint32_t *)(a))
+#define IOBASE 0xbf800000
+#define DMA_MADR(N) _MMIO32(IOBASE|0x1080|((N)<<4))
+#define DMA_BCR(N) _MMIO32(IOBASE|0x1084|((N)<<4))
+#define DMA_CHCR(N) _MMIO32(IOBASE|0x1088|((N)<<4))
+#define DMA_DPCR _MMIO32(IOBASE|0x10f0)
+#define IRQ_STAT _MMIO16(IOBASE|0x1070)
+#define IRQ_MASK _MMIO16(IOBASE|0x1074)
+#define TIMER_VALUE(N) _MMIO32(IOBASE|0x1100|((N)<<4))
+#define TIMER_CTRL(N) _MMIO32(IOBASE|0x1104|((N)<<4))
+#define TIMER_RELOAD(N) _MMIO32(IOBASE|0x1108|((N)<<4))
+#define SIO_DATA(N) _MMIO8((IOBASE|0x1040)+(16*(N)))
+#define SIO_STAT(N) _MMIO16((IOBASE|0x1044)+(16*(N)))
+#define SIO_MODE(N) _MMIO16((IOBASE|0x1048)+(16*(N)))
+#define SIO_CTRL(N) _MMIO16((IOBASE|0x104a)+(16*(N)))
+#define SIO_BAUD(N) _MMIO16((IOBASE|0x104e)+(16*(N)))
+#define SPU_CH_VOL_L(N) _MMIO16(IOBASE|0x1c00|((N)<<4))
+#define SPU_CH_VOL_R(N) _MMIO16(IOBASE|0x1c02|((N)<<4))
+#define SPU_CH_FREQ(N) _MMIO16(IOBASE|0x1c04|((N)<<4))
+#define SPU_CH_ADDR(N) _MMIO16(IOBASE|0x1c06|((N)<<4))
+#define SPU_CH_ADSR1(N) _MMIO16(IOBASE|0x1c08|((N)<<4))
+#define SPU_CH_ADSR2(N) _MMIO16(IOBASE|0x1c0a|((N)<<4))
+#define SPU_CH_ADSR_VOL(N) _MMIO16(IOBASE|0x1c0c|((N)<<4))
+#define SPU_CH_LOOP_ADDR(N) _MMIO16(IOBASE|0x1c0e|((N)<<4))
+#define SPU_MASTER_VOL_L _MMIO16(IOBASE|0x1d80)
+#define SPU_MASTER_VOL_R _MMIO16(IOBASE|0x1d82)
+#define SPU_KEY_ON1 _MMIO16(IOBASE|0x1d88)
+#define SPU_KEY_ON2 _MMIO16(IOBASE|0x1d8a)
+#define SPU_KEY_OFF1 _MMIO16(IOBASE|0x1d8c)
+#define SPU_KEY_OFF2 _MMIO16(IOBASE|0x1d8e)
+#define SPU_FM_MODE1 _MMIO16(IOBASE|0x1d90)
+#define SPU_FM_MODE2 _MMIO16(IOBASE|0x1d92)
+#define SPU_NOISE_MODE1 _MMIO16(IOBASE|0x1d94)
+#define SPU_NOISE_MODE2 _MMIO16(IOBASE|0x1d96)
+#define SPU_REVERB_ON1 _MMIO16(IOBASE|0x1d98)
+#define SPU_REVERB_ON2 _MMIO16(IOBASE|0x1d9a)
+#define SPU_CHAN_STATUS1 _MMIO16(IOBASE|0x1d9c)
+#define SPU_CHAN_STATUS2 _MMIO16(IOBASE|0x1d9e)
+#define SPU_IRQ_ADDR _MMIO16(IOBASE|0x1da4)
+#define SPU_ADDR _MMIO16(IOBASE|0x1da6)
+#define SPU_DATA _MMIO16(IOBASE|0x1da8)
+#define SPU_CTRL _MMIO16(IOBASE|0x1daa)
+#define SPU_DMA_CTRL _MMIO16(IOBASE|0x1dac)
+#define SPU_STAT _MMIO16(IOBASE|0x1dae)
+#define SPU_CD_VOL_L _MMIO16(IOBASE|0x1db0)
+#define SPU_CD_VOL_R _MMIO16(IOBASE|0x1db2)
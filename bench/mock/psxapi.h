@@ -0,0 +1,62 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <hwregs_c.h>
+int EnterCriticalSection(void);
+void ExitCriticalSection(void);
+void InitPAD(uint8_t *buff1, int len1, uint8_t *buff2, int len2);
+void StartPAD(void);
+void StopPAD(void);
+void ChangeClearPAD(int mode);
+#define RCntCNT0 0xf2000000
+#define RCntCNT1 0xf2000001
+#define RCntCNT2 0xf2000002
+#define RCntMdINTR 0x1000
+int SetRCnt(int spec, uint16_t target, int mode);
+int StartRCnt(int spec);
+int StopRCnt(int spec);
+int GetRCnt(int spec);
+void ChangeClearRCnt(int t, int m);
+#define DescHW 0xf0000000
+#define DescSW 0xf4000000
+#define HwCARD (DescHW|0x11)
+#define SwCARD (DescSW|0x01)
+#define EvSpIOE 0x0004
+#define EvSpTIMOUT 0x0100
+#define EvSpNEW 0x2000
+#define EvSpERROR 0x8000
+#define EvMdINTR 0x1000
+#define EvMdNOINTR 0x2000
+int OpenEvent(uint32_t cl, uint32_t spec, int mode, void (*func)(void));
+int CloseEvent(int event);
+int EnableEvent(int event);
+int DisableEvent(int event);
+int TestEvent(int event);
+void InitCARD(int pad_enable);
+void StartCARD(void);
+void StopCARD(void);
+void _bu_init(void);
+int _card_read(int chan, int sector, uint8_t *buf);
+int _card_write(int chan, int sector, uint8_t *buf);
@@ -0,0 +1,72 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+#include <stdint.h>
+typedef struct { uint8_t minute, second, sector, track; } CdlLOC;
+typedef struct { CdlLOC pos; int size; char name[16]; } CdlFILE;
+typedef enum { CdlNoIntr = 0, CdlDataReady = 1, CdlComplete = 2, CdlAcknowledge = 3, CdlDataEnd = 4, CdlDiskError = 5 } CdlIntrResult;
+typedef void (*CdlCB)(CdlIntrResult, uint8_t *);
+typedef struct { uint8_t file, chan; uint16_t pad; } CdlFILTER;
+#define CdlNop 0x01
+#define CdlSetloc 0x02
+#define CdlPlay 0x03
+#define CdlReadN 0x06
+#define CdlStop 0x08
+#define CdlPause 0x09
+#define CdlInit 0x0a
+#define CdlDemute 0x0c
+#define CdlSetfilter 0x0d
+#define CdlSetmode 0x0e
+#define CdlGetlocL 0x10
+#define CdlGetlocP 0x11
+#define CdlGetTN 0x13
+#define CdlGetTD 0x14
+#define CdlSeekL 0x15
+#define CdlSeekP 0x16
+#define CdlReadS 0x1b
+#define CdlModeDA 0x01
+#define CdlModeAP 0x02
+#define CdlModeRept 0x04
+#define CdlModeSF 0x08
+#define CdlModeSize 0x20
+#define CdlModeRT 0x40
+#define CdlModeSpeed 0x80
+int CdInit(void);
+CdlFILE *CdSearchFile(CdlFILE *loc, const char *filename);
+int CdControl(uint8_t com, const void *param, uint8_t *result);
+int CdControlB(uint8_t com, const void *param, uint8_t *result);
+int CdControlF(uint8_t com, const void *param);
+int CdSync(int mode, uint8_t *result);
+int CdRead(int sectors, uint32_t *buf, int mode);
+int CdReadSync(int mode, uint8_t *result);
+CdlCB CdReadyCallback(CdlCB func);
+CdlCB CdSyncCallback(CdlCB func);
+int CdGetSector(void *madr, int size);
+CdlLOC *CdIntToPos(int i, CdlLOC *p);
+int CdPosToInt(const CdlLOC *p);
+int CdGetToc(CdlLOC *toc);
+int CdMix(const void *vol);
+typedef struct { uint8_t val0, val1, val2, val3; } CdlATV;
+#define CdlStatPlay 0x80
+#define CdlStatSeek 0x40
+#define CdlStatRead 0x20
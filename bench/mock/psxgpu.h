@@ -0,0 +1,75 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+typedef struct { short x, y, w, h; } RECT;
+typedef struct { uint8_t r, g, b, cd; } CVECTOR;
+typedef struct { RECT disp, screen; uint8_t isinter, isrgb24, reverse, _reserved; } DISPENV;
+typedef struct { RECT clip; short ofs[2]; RECT tw; uint16_t tpage; uint8_t dtd, dfe, isbg, r0, g0, b0; uint32_t dr_env[16]; } DRAWENV;
+typedef struct { uint32_t mode; RECT *crect; uint32_t *caddr; RECT *prect; uint32_t *paddr; } TIM_IMAGE;
+typedef struct { uint32_t tag; uint8_t r0,g0,b0,code; short x0,y0; uint8_t u0,v0; uint16_t clut; short x1,y1; uint8_t u1,v1; uint16_t tpage; short x2,y2; uint8_t u2,v2; uint16_t pad1; short x3,y3; uint8_t u3,v3; uint16_t pad2; } POLY_FT4;
+typedef struct { uint32_t tag; uint8_t r0,g0,b0,code; short x0,y0; uint8_t u0,v0; uint16_t clut; short w,h; } SPRT;
+typedef struct { uint32_t tag; uint32_t code[1]; } DR_TPAGE;
+typedef struct { uint32_t tag; uint8_t r0,g0,b0,code; short x0,y0; short w,h; } TILE;
+typedef struct { uint32_t tag; uint8_t r0,g0,b0,code; short x0,y0; short x1,y1; } LINE_F2;
+#define setlen(p,_len) (((uint8_t*)(p))[3] = (uint8_t)(_len))
+#define setaddr(p,_addr) (((uint32_t*)(p))[0] = (((uint32_t*)(p))[0] & 0xff000000) | ((uint32_t)(uintptr_t)(_addr) & 0xffffff))
+#define getaddr(p) (((uint32_t*)(p))[0] & 0xffffff)
+#define addPrim(ot,p) setaddr(p, getaddr(ot)), setaddr(ot, p)
+#define setcode(p,c) (((uint8_t*)(p))[7] = (c))
+#define setPolyFT4(p) setlen(p,9), setcode(p,0x2c)
+#define setSprt(p) setlen(p,4), setcode(p,0x64)
+#define setTile(p) setlen(p,3), setcode(p,0x60)
+#define setLineF2(p) setlen(p,3), setcode(p,0x40)
+#define setRGB0(p,r,g,b) ((p)->r0=(r),(p)->g0=(g),(p)->b0=(b))
+#define setXY0(p,_x0,_y0) ((p)->x0=(_x0),(p)->y0=(_y0))
+#define setXY2(p,_x0,_y0,_x1,_y1) ((p)->x0=(_x0),(p)->y0=(_y0),(p)->x1=(_x1),(p)->y1=(_y1))
+#define setXY4(p,_x0,_y0,_x1,_y1,_x2,_y2,_x3,_y3) ((p)->x0=(_x0),(p)->y0=(_y0),(p)->x1=(_x1),(p)->y1=(_y1),(p)->x2=(_x2),(p)->y2=(_y2),(p)->x3=(_x3),(p)->y3=(_y3))
+#define setUV0(p,_u0,_v0) ((p)->u0=(_u0),(p)->v0=(_v0))
+#define setUVWH(p,_u0,_v0,_w,_h) ((p)->u0=(_u0),(p)->v0=(_v0),(p)->u1=(_u0)+(_w),(p)->v1=(_v0),(p)->u2=(_u0),(p)->v2=(_v0)+(_h),(p)->u3=(_u0)+(_w),(p)->v3=(_v0)+(_h))
+#define setWH(p,_w,_h) ((p)->w=(_w),(p)->h=(_h))
+#define getTPage(tp,abr,x,y) ((((x)&0x3ff)>>6)|(((y)>>8)<<4)|(((abr)&3)<<5)|(((tp)&3)<<7))
+#define getClut(x,y) (((y)<<6)|(((x)>>4)&0x3f))
+#define setDrawTPage(p,dfe,dtd,tpage) setlen(p,1), ((p)->code[0]=0xe1000000|(tpage)|((dtd)<<9)|((dfe)<<10))
+void ResetGraph(int mode);
+DISPENV *SetDefDispEnv(DISPENV *env, int x, int y, int w, int h);
+DRAWENV *SetDefDrawEnv(DRAWENV *env, int x, int y, int w, int h);
+void PutDispEnv(const DISPENV *env);
+void PutDrawEnv(DRAWENV *env);
+void SetDispMask(int mask);
+void DrawOTag(const uint32_t *ot);
+uint32_t *ClearOTagR(uint32_t *ot, size_t length);
+int DrawSync(int mode);
+void *DrawSyncCallback(void (*func)(void));
+int VSync(int mode);
+void *VSyncCallback(void (*func)(void));
+void LoadImage(const RECT *rect, const uint32_t *data);
+void StoreImage(const RECT *rect, uint32_t *data);
+void MoveImage(const RECT *rect, int x, int y);
+int GetTimInfo(const uint32_t *tim, TIM_IMAGE *timimg);
+void FntLoad(int x, int y);
+int FntOpen(int x, int y, int w, int h, int isbg, int n);
+int FntPrint(int id, const char *fmt, ...);
+char *FntFlush(int id);
+int GetVideoMode(void);
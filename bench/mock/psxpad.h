@@ -0,0 +1,26 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+#include <stdint.h>
+typedef enum { PAD_SELECT = 1<<0, PAD_L3 = 1<<1, PAD_R3 = 1<<2, PAD_START = 1<<3, PAD_UP = 1<<4, PAD_RIGHT = 1<<5, PAD_DOWN = 1<<6, PAD_LEFT = 1<<7, PAD_L2 = 1<<8, PAD_R2 = 1<<9, PAD_L1 = 1<<10, PAD_R1 = 1<<11, PAD_TRIANGLE = 1<<12, PAD_CIRCLE = 1<<13, PAD_CROSS = 1<<14, PAD_SQUARE = 1<<15 } PadButton;
+typedef struct { uint8_t stat; uint8_t len:4; uint8_t type:4; uint16_t btn; uint8_t rs_x, rs_y, ls_x, ls_y; } PADTYPE;
@@ -0,0 +1,46 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#define SPU_TRANSFER_BY_DMA 0
+#define SPU_TRANSFER_BY_IO 1
+#define SPU_TRANSFER_PEEK 0
+#define SPU_TRANSFER_WAIT 1
+#define SPU_OFF 0
+#define SPU_ON 1
+#define getSPUSampleRate(x) ((((x) << 12) / 44100) & 0xffff)
+#define getSPUAddr(x) ((x) >> 3)
+void SpuInit(void);
+size_t SpuRead(uint32_t *data, size_t size);
+size_t SpuWrite(const uint32_t *data, size_t size);
+size_t SpuWritePartly(const uint32_t *data, size_t size);
+int SpuSetTransferMode(int mode);
+uint32_t SpuSetTransferStartAddr(uint32_t addr);
+int SpuIsTransferCompleted(int flag);
+void SpuSetKey(int on_off, uint32_t voice_bit);
+int SpuGetKeyStatus(uint32_t voice_bit);
+typedef void (*SpuIRQHandler)(void);
+int SpuSetIRQ(int on_off);
+uint32_t SpuSetIRQAddr(uint32_t addr);
+SpuIRQHandler SpuSetIRQCallback(SpuIRQHandler func);
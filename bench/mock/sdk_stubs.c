@@ -0,0 +1,46 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+// Just enough of PSn00bSDK for the engine to link on the host. Nothing is
+// drawn, played or read, calls return as if they worked.
+
+#include <psxgpu.h>
+#include <psxgte.h>
+#include <psxcd.h>
+#include <psxspu.h>
+#include <psxapi.h>
+#include <psxetc.h>
+#define W __attribute__((weak))
+W void ResetGraph(int m){} W DISPENV *SetDefDispEnv(DISPENV*e,int x,int y,int w,int h){return e;} W DRAWENV *SetDefDrawEnv(DRAWENV*e,int x,int y,int w,int h){return e;}
+W void PutDispEnv(const DISPENV*e){} W void PutDrawEnv(DRAWENV*e){} W void SetDispMask(int m){} W void DrawOTag(const uint32_t*o){}
+W uint32_t *ClearOTagR(uint32_t*o,size_t l){return o;} W int DrawSync(int m){return 0;} W int VSync(int m){return 0;}
+W void LoadImage(const RECT*r,const uint32_t*d){} W void StoreImage(const RECT*r,uint32_t*d){} W void MoveImage(const RECT*r,int x,int y){} W int GetTimInfo(const uint32_t*t,TIM_IMAGE*i){return 0;}
+W void FntLoad(int x,int y){} W int FntOpen(int x,int y,int w,int h,int b,int n){return 0;} W int FntPrint(int id,const char*f,...){return 0;} W char*FntFlush(int id){return 0;}
+W int csin(int a){return 0;} W int ccos(int a){return 4096;}
+W int CdInit(void){return 1;} W CdlFILE*CdSearchFile(CdlFILE*l,const char*f){return 0;} W int CdControl(uint8_t c,const void*p,uint8_t*r){return 1;} W int CdControlB(uint8_t c,const void*p,uint8_t*r){return 1;} W int CdControlF(uint8_t c,const void*p){return 1;}
+W int CdSync(int m,uint8_t*r){return 2;} W int CdRead(int s,uint32_t*b,int m){return 1;} W int CdReadSync(int m,uint8_t*r){return 0;} W CdlCB CdReadyCallback(CdlCB f){return 0;} W CdlCB CdSyncCallback(CdlCB f){return 0;}
+W int CdGetSector(void*m,int s){return 1;} W CdlLOC*CdIntToPos(int i,CdlLOC*p){return p;} W int CdPosToInt(const CdlLOC*p){return 0;} W int CdGetToc(CdlLOC*t){return 0;} W int CdMix(const void*v){return 0;}
+W void SpuInit(void){} W size_t SpuRead(uint32_t*d,size_t s){return s;} W size_t SpuWrite(const uint32_t*d,size_t s){return s;} W size_t SpuWritePartly(const uint32_t*d,size_t s){return s;} W int SpuSetTransferMode(int m){return m;} W uint32_t SpuSetTransferStartAddr(uint32_t a){return a;}
+W int SpuIsTransferCompleted(int f){return 1;} W void SpuSetKey(int o,uint32_t v){} W int SpuGetKeyStatus(uint32_t v){return 0;} W int SpuSetIRQ(int o){return 0;} W uint32_t SpuSetIRQAddr(uint32_t a){return a;} W SpuIRQHandler SpuSetIRQCallback(SpuIRQHandler f){return 0;}
+W int EnterCriticalSection(void){return 1;} W void ExitCriticalSection(void){} W void InitPAD(uint8_t*a,int b,uint8_t*c,int d){} W void StartPAD(void){} W void StopPAD(void){} W void ChangeClearPAD(int m){}
+W int SetRCnt(int s,uint16_t t,int m){return 1;} W int StartRCnt(int s){return 1;} W int StopRCnt(int s){return 1;} W int GetRCnt(int s){return 0;} W void ChangeClearRCnt(int t,int m){}
+W void *InterruptCallback(IRQ_Channel i,void(*f)(void)){return 0;} W void *DMACallback(int d,void(*f)(void)){return 0;} W void *VSyncCallback(void(*f)(void)){return 0;} W void *DrawSyncCallback(void(*f)(void)){return 0;} W int GetVideoMode(void){return 0;}
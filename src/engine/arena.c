@@ -0,0 +1,80 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "arena.h"
+#include <stdio.h>
+
+static uint8_t sceneBuffer[SCENE_ARENA_SIZE] __attribute__((aligned(ARENA_ALIGN)));
+
+Arena sceneArena = { "Scene", sceneBuffer, SCENE_ARENA_SIZE, 0, 0, 0 };
+
+void *alloc_arena(Arena *arena, const int size) {
+    int start = (arena->used + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+    if(size < 0 || start + size > arena->size) {
+        printf("Error: %s arena out of memory, %d bytes asked for, %d of %d used.\n", 
+            arena->name, size, arena->used, arena->size);
+        arena->numFailed++;
+        return NULL;
+    }
+
+    arena->used = start + size;
+    if(arena->used > arena->peak)
+        arena->peak = arena->used;
+
+    return arena->base + start;
+}
+
+void free_arena_to(Arena *arena, void *ptr) {
+    uint8_t *p = (uint8_t*)ptr;
+
+    if(p == NULL)
+        return;
+
+    if(p < arena->base || p > arena->base + arena->used) {
+        printf("Error: %p is not in the %s arena.\n", ptr, arena->name);
+        return;
+    }
+
+    arena->used = p - arena->base;
+}
+
+void reset_arena(Arena *arena) {
+    arena->used = 0;
+}
+
+void init_arenas(void) {
+    reset_arena(&sceneArena);
+}
+
+static void _print_arena(const Arena *arena) {
+    printf("Memory: %-5s %p-%p %3d KB, %d KB used (peak %d KB)%s\n", arena->name, 
+        (void*)arena->base, (void*)(arena->base + arena->size), arena->size >> 10, 
+        arena->used >> 10, arena->peak >> 10, arena->numFailed ? ", OUT OF MEMORY" : "");
+}
+
+void print_memory_map(void) {
+    int stack;
+
+    _print_arena(&sceneArena);
+    printf("Memory: stack near %p\n", (void*)&stack);
+}
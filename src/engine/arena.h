@@ -0,0 +1,63 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+// Bump allocators over fixed static buffers, used instead of malloc so the
+// heap can't fragment or run dry in the middle of a game. Everything the
+// engine and game allocate comes from sceneArena: what a scene keeps, e.g.
+// fonts and the song, and the buffers assets are loaded through. It lives
+// until reset_arena. Add a second arena when something needs per-frame
+// scratch, until then it would only be unused RAM.
+//
+// Allocations are given back in the reverse order they were made with
+// free_arena_to, or all at once with reset_arena. Running past a budget is
+// reported and returns NULL, raise the budget rather than work around it.
+
+#define SCENE_ARENA_SIZE (128 * 1024)
+#define ARENA_ALIGN 8
+
+typedef struct _Arena {
+    const char *name;
+    uint8_t *base;
+    int size;
+    int used;
+    int peak;       // Most bytes ever in use at once
+    int numFailed;  // Allocations that didn't fit
+} Arena;
+
+extern Arena sceneArena;
+
+// Returns size bytes aligned to ARENA_ALIGN, or NULL if they don't fit
+void *alloc_arena(Arena *arena, const int size);
+
+// Gives back ptr and everything allocated from arena after it
+void free_arena_to(Arena *arena, void *ptr);
+
+void reset_arena(Arena *arena);
+
+void init_arenas(void);
+
+// Prints where the arenas are in RAM and how full they have been
+void print_memory_map(void);
@@ -21,28 +21,48 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "audio.h"
 
-#define DUMMY_BLOCK_ADDR  0x1000
-#define BUFFER_START_ADDR 0x1010
-#define DUMMY_DATA_SIZE 32
-#define ZERO_DATA_SIZE  256
+#define ADPCM_BLOCK_SIZE 16
+#define ADPCM_LOOP_END   0x01
+#define CLEAR_CHUNK_SIZE 2048
 #define STATUS_TIMEOUT  0x100000
 #define DMA4_MASK       1 << 24
 
-static int next_channel     = 1;
-static int next_sample_addr = BUFFER_START_ADDR;
-
 // Dummy SPU-ADPCM data
 // For some reason on real hardware (test on SCPH-7501) when samples
-// are played they tend to also play the next sample located in memory
-// this dummy data prevents this, when uploaded immediately after a
-// real sample.
-static const uint8_t dummy_data[] = {
+// are played they tend to also play the next sample located in memory.
+// Every sample now ends in a loop end block, and voices are pointed at
+// this silent loop, uploaded once to SPU_SILENT_BLOCK_ADDR, to repeat
+// from once they get there.
+static const uint8_t dummy_data[SPU_RAM_ALIGN] = {
 	0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  //1st block loop start
 	0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  //2nd block loop end+repeat
 };
 
+// The last DMA block of a sample is built here
+static uint32_t tail_block[SPU_RAM_ALIGN/4];
+
+// Sounds triggered this frame, keyed on together by flush_audio. At most
+// one per voice, a voice taken twice keeps the later sound.
+typedef struct _SoundCommand {
+	const AudioSample *sample;
+	int channel;
+	int volume;
+	int freq;
+} SoundCommand;
+
+static SoundCommand soundQueue[SPU_NUM_VOICES];
+static int numSoundCommands = 0;
+static uint32_t keyOffMask = 0;
+
+// Background clear of SPU RAM, see start_spu_ram_clear
+static const uint32_t zero_chunk[CLEAR_CHUNK_SIZE/4];
+static int clear_addr = SPU_RAM_SIZE;
+static int is_clearing = 0;
+
 // Copy of _wait_status in psxspu, but waits for DMA4 instead of SPU_STAT
 static void _wait_status(uint32_t mask, uint16_t value) {
 	for (int i = STATUS_TIMEOUT; i; i--) {
@@ -67,87 +87,179 @@ int SpuIsTransferCompleted_DMA4(int mode) {
 	return 1;
 }
 
-int upload_sample(const void *data, int size) {
-	// Round the size up to the nearest multiple of 64, as SPU DMA transfers
-	// are done in 64-byte blocks.
-	int _addr = next_sample_addr;
-	int _size = (size + 63) & 0xffffffc0;
+void write_spu_ram(int addr, const void *data, int size) {
+	// The clear would zero what is written behind it, and holds DMA4
+	wait_spu_ram_clear();
+
+	TRACE_BEGIN(TRACE_SPU_UPLOAD, TRACE_TID_MAIN);
 
 	SpuSetTransferMode(SPU_TRANSFER_BY_DMA);
-	SpuSetTransferStartAddr(_addr);
+	SpuSetTransferStartAddr(addr);
 
-	SpuWrite((const uint32_t *) data, _size);
+	SpuWrite((const uint32_t *) data, size);
 	SpuIsTransferCompleted_DMA4(SPU_TRANSFER_WAIT);
 
-	next_sample_addr = _addr + _size;
+	TRACE_END(TRACE_SPU_UPLOAD, TRACE_TID_MAIN);
+}
+
+int upload_sample(const void *data, int size) {
+	// SPU DMA transfers are done in 64-byte blocks, alloc_spu_ram rounds
+	// the size up to match
+	if(size <= 0)
+		return 0;
+
+	int _addr = alloc_spu_ram(size);
+	int _body = (size - 1) & ~(SPU_RAM_ALIGN - 1);
+
+	if(!_addr)
+		return 0;
+
+	if(_body > 0)
+		write_spu_ram(_addr, data, _body);
+
+	// The sample must end on a loop end flag or the voice plays on into
+	// whatever follows it
+	uint8_t *tail = (uint8_t*)tail_block;
+	int _last = (size & ~(ADPCM_BLOCK_SIZE - 1)) - ADPCM_BLOCK_SIZE - _body;
+
+	memset(tail_block, 0, SPU_RAM_ALIGN);
+	memcpy(tail, (const uint8_t*)data + _body, size - _body);
+
+	if(_last >= 0)
+		tail[_last + 1] |= ADPCM_LOOP_END;
+
+	write_spu_ram(_addr + _body, tail_block, SPU_RAM_ALIGN);
 	
 	return _addr;
 }
 
 // Zeros SPU RAM
-// When samples get uploaded to spu ram the size of that data is rounded
-// up the nearest multiple of 64 (see "upload_sample"), the data between
-// the actual size and the uploaded size, will be garbage. This garbage
-// can be heard as an annoying tick at the end of every sample, this 
-// would only affect real hardware as the spu memory in emulators is
-// usually zeroed.
-//
-// This is a naive solution to clear spu ram and there may be a better
-// way of doing it.
-void clear_spu_ram(void){
-
-    uint8_t zero_data[ZERO_DATA_SIZE] = {0};
-
-	// Samples are loaded in after this address so no reason to start earlier
-	int addr = BUFFER_START_ADDR;
+// Uploads zero the tail of their last 64 byte DMA block themselves (see
+// "upload_sample"), which used to be garbage heard as a tick at the end of
+// samples on real hardware. The rest is cleared once at boot in case
+// anything reads past what was uploaded, a chunk at a time by DMA while
+// the rest of the console is set up instead of holding up boot. Chunks are
+// started by update_spu_ram_clear from the main loop, not from the DMA IRQ,
+// as SpuWrite isn't safe to enter from an interrupt.
+static void _clear_next_chunk(void) {
+	int addr = clear_addr;
 
 	// Till the end of the reverb work area.
 	// https://psx-spx.consoledev.net/soundprocessingunitspu/#spu-memory-layout-512kbyte-ram
-	while(addr <= 0x7ffff){
+	if(addr >= SPU_RAM_SIZE) {
+		is_clearing = 0;
+		return;
+	}
 
-		// Manual write are signifacantly faster the DMA writes
-		SpuSetTransferMode(SPU_TRANSFER_BY_IO);
-		SpuSetTransferStartAddr(addr);
+	int size = SPU_RAM_SIZE - addr;
+	if(size > CLEAR_CHUNK_SIZE) size = CLEAR_CHUNK_SIZE;
 
-		SpuWrite((const uint32_t *) zero_data, ZERO_DATA_SIZE);
-		
-		// We use the original SpuIsTransferCompleted(int mode) function here
-		// because we need to wait for a SPU_STAT bit flag when doing manual
-		// writes, if psn00bSDK updates in the future it will break (as of 03/2024)
-		SpuIsTransferCompleted(SPU_TRANSFER_WAIT);
+	clear_addr = addr + size;
 
-		addr += ZERO_DATA_SIZE;
-	}
-};
+	SpuSetTransferStartAddr(addr);
+	SpuWrite(zero_chunk, size);
+}
+
+void start_spu_ram_clear(void) {
+	is_clearing = 1;
+
+	// The silent loop goes first, the zeros after it
+	clear_addr = SPU_HEAP_START;
+
+	SpuSetTransferMode(SPU_TRANSFER_BY_DMA);
+	SpuSetTransferStartAddr(SPU_SILENT_BLOCK_ADDR);
+	SpuWrite((const uint32_t *) dummy_data, SPU_RAM_ALIGN);
+}
+
+void update_spu_ram_clear(void) {
+	if(is_clearing && SpuIsTransferCompleted_DMA4(SPU_TRANSFER_PEEK))
+		_clear_next_chunk();
+}
+
+void wait_spu_ram_clear(void) {
+	while(is_clearing)
+		update_spu_ram_clear();
+}
 
 int play_sample(AudioSample *as) {
-	int ch = 0;
+	if(!is_sample_resident(as))
+		return -1;
 
-	//Find the next silent channel
-	for(int i = 0; SPU_CH_ADSR_VOL(i) && i < 24; ++i) {
-		ch = i+1;
+	// Triggered twice in a frame, it would only restart on the same voice
+	for(int i = 0; i < numSoundCommands; i++) {
+		if(soundQueue[i].sample == as)
+			return soundQueue[i].channel;
 	}
-	
-	// Make sure the channel is stopped.
-	SpuSetKey(0, 1 << ch);
 
-	SPU_CH_FREQ(ch) = getSPUSampleRate(as->sr);
-	SPU_CH_ADDR(ch) = getSPUAddr(as->addr);
+	int ch = alloc_voice(as);
+	if(ch < 0)
+		return -1;
 
-	SPU_CH_VOL_L(ch) = as->volume;
-	SPU_CH_VOL_R(ch) = as->volume;
-	SPU_CH_ADSR1(ch) = 0x00ff;
-	SPU_CH_ADSR2(ch) = 0x0000;
+	// The voice may have been stolen from a sound queued earlier this frame
+	for(int i = 0; i < numSoundCommands; i++) {
+		if(soundQueue[i].channel == ch) {
+			soundQueue[i] = soundQueue[--numSoundCommands];
+			break;
+		}
+	}
 
-	// Start the channel.
-	SpuSetKey(1, 1 << ch);
+	SoundCommand *cmd = &soundQueue[numSoundCommands++];
+	cmd->sample = as;
+	cmd->channel = ch;
+	cmd->volume = as->volume;
+	cmd->freq = getSPUSampleRate(as->sr);
 
 	as->channel = ch;
 	return ch;
 }
 
+void flush_audio(void) {
+	uint32_t keyOn = 0;
+
+	if(keyOffMask)
+		SpuSetKey(0, keyOffMask);
+
+	for(int i = 0; i < numSoundCommands; i++) {
+		const SoundCommand *cmd = &soundQueue[i];
+		int ch = cmd->channel;
+
+		SPU_CH_FREQ(ch) = cmd->freq;
+		SPU_CH_ADDR(ch) = getSPUAddr(cmd->sample->addr);
+
+		SPU_CH_VOL_L(ch) = cmd->volume;
+		SPU_CH_VOL_R(ch) = cmd->volume;
+		SPU_CH_ADSR1(ch) = 0x00ff;
+		SPU_CH_ADSR2(ch) = 0x0000;
+
+		keyOn |= 1 << ch;
+	}
+
+	if(keyOn) {
+		// Keying on a playing voice restarts it, stolen voices need no
+		// key off first
+		SpuSetKey(1, keyOn);
+
+		// Set after key on to override the repeat address it latches
+		for(int i = 0; i < numSoundCommands; i++)
+			SPU_CH_LOOP_ADDR(soundQueue[i].channel) = getSPUAddr(SPU_SILENT_BLOCK_ADDR);
+	}
+
+	numSoundCommands = 0;
+	keyOffMask = 0;
+
+	update_voices();
+}
+
 void stop_channel(int channel){
-	SpuSetKey(0, 1 << channel);
+	for(int i = 0; i < numSoundCommands; i++) {
+		if(soundQueue[i].channel == channel) {
+			soundQueue[i] = soundQueue[--numSoundCommands];
+			break;
+		}
+	}
+
+	keyOffMask |= 1 << channel;
+	free_voice(channel);
 }
 
 void change_ch_sample_rate(int channel, int sample_rate){
@@ -155,23 +267,83 @@ void change_ch_sample_rate(int channel, int sample_rate){
 }
 
 void init_sample_byte(AudioSample *sample, const uint8_t *data) {
-	sample->header = (VAG_Header *) data;
-    sample->addr = upload_sample(&(sample->header[1]), SWAP_ENDIAN_32(sample->header->size));
-
-	// Upload silent looping dummy data immediatly after sample
-	upload_sample(dummy_data, DUMMY_DATA_SIZE);
-	
-    sample->sr = SWAP_ENDIAN_32(sample->header->sample_rate);
+	init_sample_vag(sample, (VAG_Header *) data);
 }
 
 void init_sample_vag(AudioSample *sample, VAG_Header *data) {
 	sample->header = data;
-    sample->addr = upload_sample(&(sample->header[1]), SWAP_ENDIAN_32(sample->header->size));
+	sample->priority = VOICE_PRIORITY_NORMAL;
+	sample->maxVoices = 0;
+	sample->size = SWAP_ENDIAN_32(sample->header->size);
+    sample->addr = upload_sample(&(sample->header[1]), sample->size);
     sample->sr = SWAP_ENDIAN_32(sample->header->sample_rate);
 
+	if(!sample->addr)
+		sample->size = 0;
+}
+
+int is_sample_resident(const AudioSample *sample) {
+	return sample->addr != 0;
+}
+
+void free_sample(AudioSample *sample) {
+	if(!is_sample_resident(sample))
+		return;
+
+	// Silence any voice still reading it before the space is reused, right
+	// away rather than at the next flush
+	for(int i = 0; i < numSoundCommands; i++) {
+		if(soundQueue[i].sample == sample) {
+			soundQueue[i] = soundQueue[--numSoundCommands];
+			break;
+		}
+	}
+
+	stop_sample_voices(sample);
+
+	free_spu_ram(sample->addr);
+	sample->addr = 0;
+	sample->size = 0;
+}
+
+void init_sample_bank(SampleBank *bank) {
+	bank->numSamples = 0;
+}
+
+int add_to_sample_bank(SampleBank *bank, AudioSample *sample) {
+	if(bank->numSamples >= SAMPLE_BANK_MAX) {
+		printf("Error: sample bank full.\n");
+		return 0;
+	}
+
+	bank->samples[bank->numSamples++] = sample;
+	return 1;
+}
+
+int get_sample_bank_size(const SampleBank *bank) {
+	int size = 0;
+
+	for(int i = 0; i < bank->numSamples; i++) {
+		if(is_sample_resident(bank->samples[i]))
+			size += (bank->samples[i]->size + SPU_RAM_ALIGN - 1) & ~(SPU_RAM_ALIGN - 1);
+	}
+
+	return size;
+}
+
+void free_sample_bank(SampleBank *bank) {
+	for(int i = 0; i < bank->numSamples; i++) {
+		free_sample(bank->samples[i]);
+	}
+
+	bank->numSamples = 0;
 }
 
 void init_audio(void) {
-	clear_spu_ram();
 	SpuInit();
+	init_spu_ram();
+	init_voices();
+
+	// Also uploads the silent loop
+	start_spu_ram_clear();
 }
\ No newline at end of file
@@ -25,9 +25,14 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <psxetc.h>
+#include <psxapi.h>
 #include <psxspu.h>
 #include <hwregs_c.h>
 #include "audiotypes.h"
+#include "spuram.h"
+#include "voice.h"
+#include "trace.h"
+#include "cdload.h"
 
 #define SWAP_ENDIAN_32(x) ( \
 	(((uint32_t) (x) & 0x000000ff) << 24) | \
@@ -36,13 +41,65 @@
 	(((uint32_t) (x) & 0xff000000) >> 24) \
 )
 
+// Reserved by the SPU music stream
+#define MUSIC_CHANNEL 0
+
+#define SAMPLE_BANK_MAX 16
+
+// Samples that are loaded for a scene and freed together when it ends
+typedef struct _SampleBank {
+	AudioSample *samples[SAMPLE_BANK_MAX];
+	int numSamples;
+} SampleBank;
+
 void reset_spu_channels(void);
+
+// DMAs size bytes to addr, size must be a multiple of 64
+void write_spu_ram(int addr, const void *data, int size);
+
+// Allocates SPU RAM for ADPCM data and uploads it, making sure its last
+// block has the loop end flag. Returns the address, 0 if SPU RAM is full.
 int upload_sample(const void *data, int size);
+// Queues the sample to be keyed on by the next flush_audio, on the voice
+// the voice manager gives it, and returns the voice. -1 if it isn't
+// resident or lost out to higher priority sounds. Triggering a sample
+// again before the flush does nothing. The volume and sample rate are
+// taken now.
 int play_sample(AudioSample *sample);
 
+// Writes the frame's queued sounds to the SPU with one key off and one key
+// on for all of them, then updates the voice manager. Called once a frame
+// right after vblank, so sounds start at the same point of the frame
+// wherever the game triggered them.
+void flush_audio(void);
+
 void init_sample_byte(AudioSample *sample, const uint8_t *data);
 void init_sample_vag(AudioSample *sample, VAG_Header *data);
 
+int is_sample_resident(const AudioSample *sample);
+
+// Stops any voice playing the sample and gives its SPU RAM back
+void free_sample(AudioSample *sample);
+
+void init_sample_bank(SampleBank *bank);
+int add_to_sample_bank(SampleBank *bank, AudioSample *sample);
+
+// SPU RAM taken by the bank's resident samples
+int get_sample_bank_size(const SampleBank *bank);
+
+// Frees every sample in the bank and empties it
+void free_sample_bank(SampleBank *bank);
+
+// Zeros SPU RAM in the background by DMA, uploads wait for it to finish.
+// Started by init_audio, update_spu_ram_clear starts each next chunk once
+// the last is done, call it while waiting on other things at boot and once
+// a frame.
+void start_spu_ram_clear(void);
+void update_spu_ram_clear(void);
+void wait_spu_ram_clear(void);
+
+// Keys the voice off at the next flush and hands it back to the voice
+// manager now
 void stop_channel(int channel);
 void change_ch_sample_rate(int channel, int sample_rate);
 void init_audio(void);
\ No newline at end of file
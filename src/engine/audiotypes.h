@@ -39,8 +39,11 @@ typedef struct {
 
 typedef struct _AudioSample {
     VAG_Header *header;
-    int addr;
+    int addr; // In SPU RAM, 0 when not resident
+    int size; // Bytes of ADPCM data
     int sr;   //sample rate
 	int volume;
-	int channel;
+	int channel;  // Last voice it was played on
+	int priority; // VOICE_PRIORITY_*, see voice.h
+	int maxVoices; // Voices it may play on at once, 0 for no limit
 } AudioSample;
\ No newline at end of file
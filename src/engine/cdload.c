@@ -0,0 +1,230 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "cdload.h"
+#include <stdio.h>
+#include <string.h>
+#include "trace.h"
+
+static CdLoadRequest *loadQueue[CD_LOAD_QUEUE_LEN];
+static int queueHead  = 0;
+static int queueCount = 0;
+
+static CdLoadRequest *activeReq = NULL;
+
+// Ring of sectors read by the CD IRQ and drained by update_cd_loader
+static uint32_t sectorBuffers[CD_SECTOR_BUFFERS][CD_SECTOR_SIZE/4];
+
+// Set by the IRQ when the drive had to be paused, either because the sector
+// buffers were full or the drive reported an error. The read is restarted
+// from the next missing sector.
+static volatile int isStalled = 0;
+static volatile int isDiskError = 0;
+static int numRetries = 0;
+static int numReseeks = 0;
+
+static void _start_reading(const int lba) {
+    CdlLOC pos;
+
+    CdIntToPos(lba, &pos);
+    CdControl(CdlSetloc, (unsigned char*)&pos, 0);
+    CdControlF(CdlReadN, 0);
+}
+
+static void _cd_ready_callback(CdlIntrResult event, unsigned char *result) {
+    CdLoadRequest *req = activeReq;
+
+    if(req == NULL || req->status != CD_LOAD_READING)
+        return;
+
+    if(event == CdlDiskError) {
+        CdControlF(CdlPause, 0);
+        isDiskError = 1;
+        isStalled = 1;
+        return;
+    }
+
+    if(event != CdlDataReady || isStalled)
+        return;
+
+    int received = req->sectorsReceived;
+
+    // The drive can deliver one more sector before the pause takes effect
+    if(received >= req->numSectors)
+        return;
+
+    if(req->buffer) {
+        // Read straight into the destination, no copy needed
+        CdGetSector(req->buffer + (received * CD_SECTOR_SIZE), CD_SECTOR_SIZE/4);
+    } else {
+        // The whole ring is still waiting to be drained, stop the drive
+        if(received - req->sectorsConsumed >= CD_SECTOR_BUFFERS) {
+            CdControlF(CdlPause, 0);
+            isStalled = 1;
+            return;
+        }
+
+        CdGetSector(sectorBuffers[received % CD_SECTOR_BUFFERS], CD_SECTOR_SIZE/4);
+    }
+
+    req->sectorsReceived = ++received;
+
+    if(received >= req->numSectors)
+        CdControlF(CdlPause, 0);
+}
+
+static void _finish_request(CdLoadRequest *req, const CdLoadStatus status) {
+    req->status = status;
+    activeReq = NULL;
+
+    if(req->onComplete)
+        req->onComplete(req);
+}
+
+static void _start_request(CdLoadRequest *req) {
+    CdlFILE filePos;
+
+    if(req->filename) {
+        if(CdSearchFile(&filePos, req->filename) == NULL) {
+            printf("file: %s not found.\n", req->filename);
+            _finish_request(req, CD_LOAD_ERROR);
+            return;
+        }
+
+        req->lba  = CdPosToInt(&filePos.pos);
+        req->size = filePos.size;
+    }
+
+    req->numSectors = (req->size + CD_SECTOR_SIZE - 1) / CD_SECTOR_SIZE;
+    req->sectorsReceived = 0;
+    req->sectorsConsumed = 0;
+
+    if(req->buffer == NULL && req->onSector == NULL) {
+        printf("CD load has nowhere to put its sectors.\n");
+        _finish_request(req, CD_LOAD_ERROR);
+        return;
+    }
+
+    activeReq = req;
+    isStalled = 0;
+    isDiskError = 0;
+    numRetries = 0;
+    req->status = CD_LOAD_READING;
+
+    if(req->numSectors > 0)
+        _start_reading(req->lba);
+}
+
+void init_cd_request(CdLoadRequest *req, const char *filename) {
+    memset(req, 0, sizeof(CdLoadRequest));
+    req->filename = filename;
+}
+
+int queue_cd_load(CdLoadRequest *req) {
+    if(queueCount >= CD_LOAD_QUEUE_LEN) {
+        printf("CD load queue full.\n");
+        return 0;
+    }
+
+    req->status = CD_LOAD_QUEUED;
+    loadQueue[(queueHead + queueCount) % CD_LOAD_QUEUE_LEN] = req;
+    queueCount++;
+
+    return 1;
+}
+
+void update_cd_loader(void) {
+    CdLoadRequest *req = activeReq;
+
+    // Start the next request when the drive is free. Requests that fail
+    // immediately finish here, so keep going until one is reading.
+    while(req == NULL && queueCount > 0) {
+        req = loadQueue[queueHead];
+        queueHead = (queueHead + 1) % CD_LOAD_QUEUE_LEN;
+        queueCount--;
+
+        _start_request(req);
+        req = activeReq;
+    }
+
+    if(req == NULL)
+        return;
+
+    int received = req->sectorsReceived;
+
+    if(req->buffer) {
+        req->sectorsConsumed = received;
+    } else {
+        while(req->sectorsConsumed < received) {
+            int index = req->sectorsConsumed;
+            req->onSector(req, sectorBuffers[index % CD_SECTOR_BUFFERS], index);
+            req->sectorsConsumed = index + 1;
+        }
+    }
+
+    if(req->sectorsConsumed >= req->numSectors) {
+        _finish_request(req, CD_LOAD_DONE);
+        return;
+    }
+
+    // Buffers have been drained or the read failed, pick up where the
+    // drive stopped
+    if(isStalled) {
+        if(isDiskError) {
+            isDiskError = 0;
+
+            if(++numRetries > CD_LOAD_MAX_RETRIES) {
+                printf("CD read error at sector %d.\n", req->lba + req->sectorsReceived);
+                _finish_request(req, CD_LOAD_ERROR);
+                return;
+            }
+        }
+
+        isStalled = 0;
+        numReseeks++;
+        TRACE_INSTANT(TRACE_CD_RESEEK, TRACE_TID_MAIN);
+        _start_reading(req->lba + req->sectorsReceived);
+    }
+}
+
+void wait_cd_load(CdLoadRequest *req) {
+    while(req->status == CD_LOAD_QUEUED || req->status == CD_LOAD_READING) {
+        update_cd_loader();
+    }
+}
+
+int is_cd_loader_busy(void) {
+    return (activeReq != NULL || queueCount > 0);
+}
+
+int get_cd_reseeks(void) {
+    return numReseeks;
+}
+
+void init_cd_loader(void) {
+    unsigned char mode = CdlModeSpeed;
+
+    CdInit();
+    CdControl(CdlSetmode, &mode, 0);
+
+    CdReadyCallback(&_cd_ready_callback);
+}
@@ -0,0 +1,95 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <psxcd.h>
+
+#define CD_SECTOR_SIZE 2048
+
+// Sectors read for an onSector request wait in a ring until update_cd_loader
+// hands them over. At 2x speed the drive delivers 150 sectors a second, ~2.5
+// a frame, so 16 keeps it reading through ~6 frames before it has to pause
+// and seek back.
+#define CD_SECTOR_BUFFERS 16
+#define CD_LOAD_QUEUE_LEN 8
+#define CD_LOAD_MAX_RETRIES 4
+
+typedef enum _CdLoadStatus {
+    CD_LOAD_IDLE    = 0,
+    CD_LOAD_QUEUED  = 1,
+    CD_LOAD_READING = 2,
+    CD_LOAD_DONE    = 3,
+    CD_LOAD_ERROR   = 4
+} CdLoadStatus;
+
+typedef struct _CdLoadRequest CdLoadRequest;
+
+// Called for each sector in order, from update_cd_loader. The sector data
+// is only valid until the handler returns.
+typedef void (*CdSectorHandler)(CdLoadRequest *req, const uint32_t *sector, const int index);
+
+// Called from update_cd_loader once the request is done or failed.
+typedef void (*CdLoadCallback)(CdLoadRequest *req);
+
+struct _CdLoadRequest {
+    const char *filename;   // Looked up on start, NULL to read from lba
+    int lba;                // First sector
+    int size;               // Size in bytes, filled in by the file lookup
+
+    // Where the sectors go. With a buffer the drive reads straight into it,
+    // otherwise sectors pass through the sector buffers to onSector.
+    char *buffer;
+    CdSectorHandler onSector;
+
+    CdLoadCallback onComplete;
+    void *userData;
+
+    volatile CdLoadStatus status;
+    int numSectors;
+    volatile int sectorsReceived;
+    int sectorsConsumed;
+};
+
+// Sets up a request for a file on the disc, e.g. "\\GFX\\TITLE.TIM;1"
+void init_cd_request(CdLoadRequest *req, const char *filename);
+
+// Adds the request to the queue, returns 0 if the queue is full
+int queue_cd_load(CdLoadRequest *req);
+
+// Drains the sector buffers, fires callbacks and starts queued reads.
+// Call at least once a frame.
+void update_cd_loader(void);
+
+// Pumps the loader until the request completes
+void wait_cd_load(CdLoadRequest *req);
+
+int is_cd_loader_busy(void);
+
+// Times the drive was paused mid-read, by a full sector ring or a read
+// error, and had to seek back to carry on. A streamed read that keeps up
+// adds none.
+int get_cd_reseeks(void);
+
+void init_cd_loader(void);
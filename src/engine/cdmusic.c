@@ -0,0 +1,233 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#include "music.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <psxcd.h>
+#include "timer.h"
+#include "music_variants.h"
+
+#define CDDA_SECTORS_PER_SECOND 75
+#define XA_SECTORS_PER_SECOND   150 // Read at double speed
+
+// How many frames between asking the drive whether a track has ended
+#define CDDA_POLL_FRAMES 15
+
+#define TO_BCD(x) ((uint8_t)((((x) / 10) << 4) | ((x) % 10)))
+#define FROM_BCD(x) ((((x) >> 4) * 10) + ((x) & 0x0f))
+
+static int isOpen = 0;
+static int isPlaying = 0;
+static int variant = 0;
+
+// Where playback was last started, the position in the variant is
+// worked out from the time since
+static uint32_t startTime;
+static int startOffset;     // ms into the variant
+
+#if MUSIC_MODE == MUSIC_MODE_CDDA
+static int trackLba[MUSIC_NUM_VARIANTS];
+static int pollFrames = 0;
+#else
+static int fileLba;
+#endif
+
+static int _position(void) {
+    return startOffset + (int)(get_system_time() - startTime);
+}
+
+static void _play_from(const int offset) {
+    unsigned char mode;
+    CdlLOC pos;
+
+#if MUSIC_MODE == MUSIC_MODE_CDDA
+    // CD-DA plays at single speed. Autopause stops the drive at the end of
+    // the track instead of running on into the next variant.
+    mode = CdlModeDA | CdlModeAP;
+    CdControl(CdlSetmode, &mode, 0);
+
+    // Given a track the drive starts exactly at its first sector. Track
+    // starts are only known to the second, so seeks within one are not
+    // as accurate.
+    unsigned char track = 0;
+
+    if(offset == 0) {
+        track = TO_BCD(MUSIC_FIRST_TRACK + variant);
+    } else {
+        CdIntToPos(trackLba[variant] + offset * CDDA_SECTORS_PER_SECOND / 1000, &pos);
+        CdControl(CdlSetloc, (unsigned char*)&pos, 0);
+    }
+
+    CdControl(CdlPlay, &track, 0);
+    pollFrames = 0;
+#else
+    CdlFILTER filter;
+    filter.file = 1;
+    filter.chan = variant;
+
+    mode = CdlModeSpeed | CdlModeRT | CdlModeSF;
+    CdControl(CdlSetmode, &mode, 0);
+    CdControl(CdlSetfilter, (unsigned char*)&filter, 0);
+
+    // Every variant runs through the file at the same rate, start on the
+    // first sector of the interleave block holding offset
+    int sector = offset * XA_SECTORS_PER_SECOND / 1000;
+    sector -= sector % MUSIC_XA_INTERLEAVE;
+
+    CdIntToPos(fileLba + sector, &pos);
+    CdControl(CdlSetloc, (unsigned char*)&pos, 0);
+    CdControl(CdlReadS, 0, 0);
+#endif
+
+    startOffset = offset;
+    startTime = get_system_time();
+}
+
+int open_music(const char *name) {
+#if MUSIC_MODE == MUSIC_MODE_CDDA
+    unsigned char result[8];
+
+    if(!CdControlB(CdlGetTN, 0, result)) {
+        printf("Error: could not read the track list.\n");
+        return 0;
+    }
+
+    int lastTrack = FROM_BCD(result[2]);
+    if(lastTrack < MUSIC_FIRST_TRACK + MUSIC_NUM_VARIANTS - 1) {
+        printf("Error: %d music tracks expected, the disc has %d tracks.\n", 
+            MUSIC_NUM_VARIANTS, lastTrack);
+        return 0;
+    }
+
+    for(int i = 0; i < MUSIC_NUM_VARIANTS; i++) {
+        unsigned char track = TO_BCD(MUSIC_FIRST_TRACK + i);
+        CdlLOC pos;
+
+        CdControlB(CdlGetTD, &track, result);
+        pos.minute = result[1];
+        pos.second = result[2];
+        pos.sector = 0;
+        pos.track = 0;
+
+        trackLba[i] = CdPosToInt(&pos);
+    }
+#else
+    CdlFILE file;
+
+    if(CdSearchFile(&file, name) == NULL) {
+        printf("file: %s not found.\n", name);
+        return 0;
+    }
+
+    fileLba = CdPosToInt(&file.pos);
+#endif
+
+    // CD audio goes through the SPU's CD input
+    SPU_CTRL |= 0x0001;
+    CdControl(CdlDemute, 0, 0);
+
+    isOpen = 1;
+    return 1;
+}
+
+void play_music(const int volume) {
+    if(!isOpen)
+        return;
+
+    // The drive can only do one thing at a time
+    while(is_cd_loader_busy()) {
+        update_cd_loader();
+    }
+
+    set_music_volume(volume);
+
+    isPlaying = 1;
+    variant = 0;
+    _play_from(0);
+}
+
+void stop_music(void) {
+    unsigned char mode = CdlModeSpeed;
+
+    if(!isPlaying)
+        return;
+
+    CdControl(CdlPause, 0, 0);
+
+    // Back to what the loader expects
+    CdControl(CdlSetmode, &mode, 0);
+    isPlaying = 0;
+}
+
+void set_music_volume(const int volume) {
+    SPU_CD_VOL_L = volume;
+    SPU_CD_VOL_R = volume;
+}
+
+void set_music_speed(const int speed) {
+    int sampleRate = MulFixed(MUSIC_VARIANT_RATES[0], speed);
+    int closest = 0;
+
+    for(int i = 1; i < MUSIC_NUM_VARIANTS; i++) {
+        if(abs(MUSIC_VARIANT_RATES[i] - sampleRate) < abs(MUSIC_VARIANT_RATES[closest] - sampleRate))
+            closest = i;
+    }
+
+    if(closest == variant)
+        return;
+
+    if(!isPlaying) {
+        variant = closest;
+        return;
+    }
+
+    // The same point in the song is further in on slower variants
+    int offset = _position() * MUSIC_VARIANT_RATES[variant] / MUSIC_VARIANT_RATES[closest];
+
+    variant = closest;
+    _play_from(offset < MUSIC_VARIANT_MS[variant] ? offset : 0);
+}
+
+void update_music(void) {
+    if(!isPlaying)
+        return;
+
+#if MUSIC_MODE == MUSIC_MODE_CDDA
+    unsigned char result[8];
+
+    if(++pollFrames < CDDA_POLL_FRAMES)
+        return;
+    pollFrames = 0;
+
+    // Once autopause has stopped the drive neither bit is set
+    CdControl(CdlNop, 0, result);
+    if(!(result[0] & (CdlStatPlay | CdlStatSeek)))
+        _play_from(0);
+#else
+    // The drive reads on into the other variants' padding and beyond, so
+    // loop on time
+    if(_position() >= MUSIC_VARIANT_MS[variant])
+        _play_from(0);
+#endif
+}
@@ -21,74 +21,235 @@
 */
 
 #include "graphics2d.h"
+#include <string.h>
 
 static RenderContext ctx;
 
+// Primitives left out because the buffer was full, since boot
+static int numDroppedPrims = 0;
+
 // Controls animation timing currently
 Timer mainTimer;
 int fnt;
 
+// A primitive that doesn't fit is dropped and counted rather than written
+// past the end of the buffer
+static int _has_prim_room(const int size) {
+    if(ctx.nextpri + size <= ctx.primbuff[ctx.db_active] + PRIM_BUFFER_LEN)
+        return 1;
+
+    numDroppedPrims++;
+    return 0;
+}
+
+// Picks a place in VRam for a TIM block, returns 0 if there is no room
+static int _alloc_tim_rect(RECT *rect, const int mode) {
+    return alloc_vram(rect, rect->w, rect->h, mode);
+}
+
 void load_texture(uint32_t *tim, TIM_IMAGE *tparam) {
     // Read TIM information (PSn00bSDK)
     GetTimInfo(tim, tparam);
 
     // Upload pixel data to framebuffer
+    if(!_alloc_tim_rect(tparam->prect, tparam->mode & 0x3))
+        return;
+
     LoadImage(tparam->prect, (uint32_t*)tparam->paddr);
     DrawSync(0);
 
     // Upload CLUT to framebuffer if present
     if(tparam->mode & 0x8) {
-        LoadImage(tparam->crect, (uint32_t*)tparam->caddr);
-        DrawSync(0);
+        RECT *crect = tparam->crect;
+        alloc_vram_clut(crect, (const uint16_t*)tparam->caddr, crect->w, crect->h);
     }
 }
 
-char *load_file(const char *filename) {
-    CdlFILE filePos;
-    int numsecs;
-    char *buff;
+// Uploads rows of the current block from data, which must be word aligned
+static void _upload_tim_rows(TimStream *stream, const uint8_t *data, const int rows) {
+    RECT rect = *(stream->block);
 
-    buff = NULL;
+    rect.y += stream->row;
+    rect.h = rows;
+    LoadImage(&rect, (const uint32_t*)data);
 
-    /* locate the file on the CD */
-    if(CdSearchFile(&filePos, filename) == NULL) {
-        /* print error message if file not found */
-        printf("file: %s not found.\n", filename);
-    } else {
-        /* calculate number of sectors to read for the file */
-        numsecs = (filePos.size+2047)/2048;
+    stream->row += rows;
+}
 
-        /* allocate buffer for the file */
-        buff = (char*)malloc(2048*numsecs);
+// Consumes block data, returns the number of bytes used
+static int _stream_tim_block(TimStream *stream, const uint8_t *data, const int len) {
+    const int rowBytes = stream->block->w * 2;
+    int used = 0;
 
-        /* set read target to the file */
-        CdControl(CdlSetloc, (unsigned char*)&filePos.pos, 0);
+    // Finish off a row that started in the previous sector
+    if(stream->carryLen > 0) {
+        int n = rowBytes - stream->carryLen;
+        if(n > len) n = len;
 
-        /* start read operation */
-        CdRead(numsecs, (uint32_t*)buff, CdlModeSpeed);
+        memcpy(stream->carry + stream->carryLen, data, n);
+        stream->carryLen += n;
+        used += n;
 
-        /* wait until the read operation is complete */
-        CdReadSync(0,0);
+        if(stream->carryLen < rowBytes)
+            return used;
+
+        _upload_tim_rows(stream, stream->carry, 1);
+        DrawSync(0);
+        stream->carryLen = 0;
     }
 
-    return buff;
+    // Whole rows go straight from the sector buffer to VRam, DMA needs them
+    // word aligned though
+    if(!(((uintptr_t)(data + used) | rowBytes) & 3)) {
+        int rows = (len - used) / rowBytes;
+        if(rows > stream->block->h - stream->row)
+            rows = stream->block->h - stream->row;
+
+        if(rows > 0) {
+            _upload_tim_rows(stream, data + used, rows);
+            used += rows * rowBytes;
+        }
+    }
+
+    // Unaligned rows and the start of a split row go through carry
+    while(used < len && stream->row < stream->block->h) {
+        int n = len - used;
+        if(n > rowBytes) n = rowBytes;
+
+        memcpy(stream->carry, data + used, n);
+        stream->carryLen = n;
+        used += n;
+
+        if(n < rowBytes)
+            break;
+
+        _upload_tim_rows(stream, stream->carry, 1);
+        DrawSync(0);
+        stream->carryLen = 0;
+    }
+
+    return used;
 }
 
-void load_cd_texture(uint32_t *tim, TIM_IMAGE *tparam, const char *filename) {
-    uint32_t *filebuff;
+// CLUT blocks that fit in carry are collected whole before being placed, so
+// they can be matched against the ones already in VRam
+static int _clut_fits_carry(const RECT *block) {
+    return block->w * block->h * 2 <= TIM_MAX_ROW_BYTES;
+}
 
-    if(filebuff = (uint32_t*)load_file(filename)) {
-        load_texture(tim, tparam);
+// Collects a CLUT block in carry, returns the number of bytes used
+static int _stream_tim_clut(TimStream *stream, const uint8_t *data, const int len) {
+    const int blockBytes = stream->block->w * stream->block->h * 2;
+    int n = blockBytes - stream->carryLen;
+    if(n > len) n = len;
 
-        // Free the file buffer
-        free(filebuff);
+    memcpy(stream->carry + stream->carryLen, data, n);
+    stream->carryLen += n;
 
-    } else {
-        // Output error text that the image failed to load
-        printf("Error: %s file not found.\n", filename);
+    if(stream->carryLen == blockBytes) {
+        int placed = alloc_vram_clut(stream->block, (const uint16_t*)stream->carry, 
+            stream->block->w, stream->block->h);
+
+        stream->carryLen = 0;
+        stream->state = placed ? TIM_STREAM_PIXEL_HEADER : TIM_STREAM_INVALID;
+    }
+
+    return n;
+}
+
+void stream_tim_bytes(TimStream *stream, const uint8_t *data, int len) {
+    while(len > 0) {
+        int n;
+
+        switch(stream->state) {
+            case TIM_STREAM_HEADER:
+            case TIM_STREAM_CLUT_HEADER:
+            case TIM_STREAM_PIXEL_HEADER: {
+                // 8 bytes for the file header, 12 for block headers
+                int need = (stream->state == TIM_STREAM_HEADER) ? 8 : 12;
+
+                n = need - stream->headerLen;
+                if(n > len) n = len;
+
+                memcpy((uint8_t*)stream->header + stream->headerLen, data, n);
+                stream->headerLen += n;
+
+                if(stream->headerLen < need)
+                    break;
+
+                stream->headerLen = 0;
+
+                if(stream->state == TIM_STREAM_HEADER) {
+                    if((stream->header[0] & 0xff) != 0x10) {
+                        stream->state = TIM_STREAM_INVALID;
+                        return;
+                    }
+
+                    stream->tim.mode = stream->header[1];
+                    stream->state = (stream->tim.mode & 0x8) ? TIM_STREAM_CLUT_HEADER : TIM_STREAM_PIXEL_HEADER;
+                    break;
+                }
+
+                // Block header: length, x/y, w/h
+                stream->block = (stream->state == TIM_STREAM_CLUT_HEADER) ? &(stream->crect) : &(stream->prect);
+                stream->block->x = stream->header[1] & 0xffff;
+                stream->block->y = stream->header[1] >> 16;
+                stream->block->w = stream->header[2] & 0xffff;
+                stream->block->h = stream->header[2] >> 16;
+                stream->row = 0;
+
+                if(stream->block->w * 2 > TIM_MAX_ROW_BYTES) {
+                    stream->state = TIM_STREAM_INVALID;
+                    return;
+                }
+
+                int placed = (stream->state == TIM_STREAM_CLUT_HEADER) ? 
+                    (_clut_fits_carry(stream->block) || _alloc_tim_rect(stream->block, 2)) :
+                    _alloc_tim_rect(stream->block, stream->tim.mode & 0x3);
+
+                if(!placed) {
+                    stream->state = TIM_STREAM_INVALID;
+                    return;
+                }
+
+                stream->state++;
+                break;
+            }
+            case TIM_STREAM_CLUT:
+                if(_clut_fits_carry(stream->block)) {
+                    n = _stream_tim_clut(stream, data, len);
+                    break;
+                }
+                // Fall through
+            case TIM_STREAM_PIXELS:
+                n = _stream_tim_block(stream, data, len);
+
+                if(stream->row >= stream->block->h) {
+                    stream->state = (stream->state == TIM_STREAM_CLUT) ? TIM_STREAM_PIXEL_HEADER : TIM_STREAM_DONE;
+                }
+                break;
+            default:
+                // Anything past the image is sector padding
+                return;
+        }
+
+        data += n;
+        len -= n;
     }
 }
 
+void init_tim_stream(TimStream *stream) {
+    stream->tim.mode = 0;
+    stream->tim.crect = &(stream->crect);
+    stream->tim.caddr = NULL;
+    stream->tim.prect = &(stream->prect);
+    stream->tim.paddr = NULL;
+
+    stream->state = TIM_STREAM_HEADER;
+    stream->headerLen = 0;
+    stream->carryLen = 0;
+}
+
 void load_sprite(Sprite *sprite, TIM_IMAGE *tim) {
     // Get tpage value
     sprite->tpage = getTPage(tim->mode&0x3, 0, 
@@ -100,11 +261,11 @@ void load_sprite(Sprite *sprite, TIM_IMAGE *tim) {
     }
 
     // Set sprite size
-    sprite->w = tim->prect->w<<(2-tim->mode&0x3);
+    sprite->w = tim->prect->w<<((2-tim->mode)&0x3);
     sprite->h = tim->prect->h;
 
     // Set UV offset
-    sprite->u = (tim->prect->x&0x3f)<<(2-tim->mode&0x3);
+    sprite->u = (tim->prect->x&0x3f)<<((2-tim->mode)&0x3);
     sprite->v = tim->prect->y&0xff;
 
     // Set neutral color
@@ -134,7 +295,7 @@ void load_sprite(Sprite *sprite, TIM_IMAGE *tim) {
 void load_sprite_sheet(Sprite *spriteList, const int sH, const int sW, const int sNum, const int numCol, TIM_IMAGE *tim) {
     int curCol = 0;
     int curRow = 0;
-    const int u = (tim->prect->x&0x3f)<<(2-tim->mode&0x3);
+    const int u = (tim->prect->x&0x3f)<<((2-tim->mode)&0x3);
     const int v = tim->prect->y&0xff;
     for(int i = 0; i < sNum; i++) {        
         Sprite sprite;
@@ -154,6 +315,23 @@ void load_sprite_sheet(Sprite *spriteList, const int sH, const int sW, const int
     }
 }
 
+void load_atlas_sheet(Sprite *spriteList, const int sNum, const AtlasSheet *sheet, TIM_IMAGE *atlas) {
+    for(int i = 0; i < sNum && i < sheet->numCells; i++) {
+        Sprite sprite;
+        load_sprite(&sprite, atlas);
+
+        sprite.u += sheet->u + (i % sheet->cols) * sheet->cellW;
+        sprite.v += sheet->v + (i / sheet->cols) * sheet->cellH;
+        sprite.w = sheet->cellW;
+        sprite.h = sheet->cellH;
+
+        // Every CLUT in the atlas is a row of its CLUT block
+        sprite.clut = getClut(atlas->crect->x, atlas->crect->y + sheet->cluts[i]);
+
+        spriteList[i] = sprite;
+    }
+}
+
 void rotate_sprite(Sprite *sprite, const int angle) {
     sprite->angle = angle;
 }
@@ -182,6 +360,9 @@ static void _draw_rotated_sprite(Sprite *sprite) {
     angle = sprite->angle;
     int i,cx,cy;
 
+    if(!_has_prim_room(sizeof(POLY_FT4)))
+        return;
+
     // calculate the pivot point (center) of the sprite
     cx = pw>>1;
     cy = ph>>1;
@@ -236,12 +417,16 @@ static void _draw_rotated_sprite(Sprite *sprite) {
     // add it to the ordering table
     addPrim( ctx.ot[ctx.db_active], quad );
     ctx.nextpri += sizeof(POLY_FT4); 
+    ctx.tpage = NULL;
 }
 
 // Draw sprite as basic SPRT primitive
 static void _draw_sprite(Sprite *sprite) {
     uint32_t *ot = ctx.ot[ctx.db_active];
 
+    if(!_has_prim_room(sizeof(SPRT) + sizeof(DR_TPAGE)))
+        return;
+
     SPRT *sprt;
     DR_TPAGE *tpage;
 
@@ -257,10 +442,18 @@ static void _draw_sprite(Sprite *sprite) {
     setWH(sprt, sprite->w, sprite->h);
    
     sprt->clut = sprite->clut;
+    ctx.nextpri += sizeof(SPRT); 
+
+    // Primitives added later are drawn first, so a sprite using the same
+    // tpage as the last one can go right after its tpage change instead of
+    // needing one of its own
+    if(ctx.tpage && ctx.tpageValue == sprite->tpage) {
+        addPrim(ctx.tpage, sprt);
+        return;
+    }
 
     // Add it to the ordering table
     addPrim( ot, sprt );
-    ctx.nextpri += sizeof(SPRT); 
 
     // Add tpage
     tpage = (DR_TPAGE*)(ctx.nextpri);            
@@ -268,7 +461,8 @@ static void _draw_sprite(Sprite *sprite) {
     addPrim(ot, tpage);
 
     ctx.nextpri += sizeof(DR_TPAGE);   
-                                  
+    ctx.tpage = tpage;
+    ctx.tpageValue = sprite->tpage;
 }
 
 void draw_sprite(Sprite *sprite) {
@@ -283,6 +477,9 @@ void draw_sprite(Sprite *sprite) {
 }
 
 void draw_tile(const CVECTOR color, const int x, const int y, const int w, const int h) {
+    if(!_has_prim_room(sizeof(TILE)))
+        return;
+
     TILE *tile = (TILE*)ctx.nextpri; // Cast next primitive
 
     setTile(tile);               // Initialize the primitive
@@ -295,9 +492,13 @@ void draw_tile(const CVECTOR color, const int x, const int y, const int w, const
     addPrim(ctx.ot[ctx.db_active], tile);       // Add primitive to the ordering table
     
     ctx.nextpri += sizeof(TILE); 
+    ctx.tpage = NULL;
 }
 
 void draw_line(const CVECTOR color, const int x0, const int y0, const int x1, const int y1) {
+    if(!_has_prim_room(sizeof(LINE_F2)))
+        return;
+
     LINE_F2 *line = (LINE_F2*)ctx.nextpri;
     setLineF2(line);
     setXY2(line, x0, y0, x1, y1);
@@ -307,6 +508,7 @@ void draw_line(const CVECTOR color, const int x0, const int y0, const int x1, co
         color.b);
     addPrim(ctx.ot[ctx.db_active], line);       // Add primitive to the ordering table
     ctx.nextpri += sizeof(LINE_F2); 
+    ctx.tpage = NULL;
 }
 
 void animate(AnimatedSprite *animSprite) {
@@ -330,9 +532,24 @@ void change_bkg_color(const CVECTOR color) {
     setRGB0(&(db->draw[1]), color.r, color.g, color.b);
 }
 
+int get_prim_bytes(void) {
+    return ctx.nextpri - ctx.primbuff[ctx.db_active];
+}
+
+int get_dropped_prims(void) {
+    return numDroppedPrims;
+}
+
 void display(void) {
+    TRACE_BEGIN(TRACE_DISPLAY, TRACE_TID_MAIN);
+
+    TRACE_BEGIN(TRACE_DRAW_SYNC, TRACE_TID_MAIN);
     DrawSync(0);
+    TRACE_END(TRACE_DRAW_SYNC, TRACE_TID_MAIN);
+
+    TRACE_BEGIN(TRACE_VSYNC, TRACE_TID_MAIN);
     VSync(0);
+    TRACE_END(TRACE_VSYNC, TRACE_TID_MAIN);
 
     FrameBuffer *db = &(ctx.db);
 
@@ -341,14 +558,19 @@ void display(void) {
 
     SetDispMask(1);
 
+    TRACE_BEGIN(TRACE_DMA_KICK, TRACE_TID_MAIN);
     DrawOTag(ctx.ot[ctx.db_active]+OTLEN-1);
+    TRACE_END(TRACE_DMA_KICK, TRACE_TID_MAIN);
 
     ctx.db_active = !(ctx.db_active);
     ctx.nextpri = ctx.primbuff[ctx.db_active];
+    ctx.tpage = NULL;
 
     ClearOTagR(ctx.ot[ctx.db_active], OTLEN); 
 
     mainTimer.time++;
+
+    TRACE_END(TRACE_DISPLAY, TRACE_TID_MAIN);
 }
 
 void init_gfx(void) {
@@ -368,6 +590,9 @@ void init_gfx(void) {
     db->draw[1].isbg = 1;
 
     ctx.db_active = 0;
+    ctx.tpage = NULL;
+
+    init_vram();
 
     PutDispEnv(&(db->disp[0]));
     PutDrawEnv(&(db->draw[0]));
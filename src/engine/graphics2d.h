@@ -30,6 +30,9 @@
 #include <psxcd.h>
 #include "fpmath.h"
 #include "timer.h"
+#include "trace.h"
+#include "cdload.h"
+#include "vram.h"
 
 #define DEBUG_MODE 1
 #define PAL_MODE 0
@@ -53,6 +56,15 @@ typedef struct _Sprite {
     CVECTOR color;
 } Sprite;
 
+// Where a sprite sheet ended up in an atlas built by tools/timpack.py
+typedef struct _AtlasSheet {
+    unsigned char u, v;             // Top left of the sheet in the atlas
+    unsigned char cellW, cellH;     // Size of each sprite
+    unsigned char cols;             // Sprites per row
+    unsigned short numCells;
+    const uint8_t *cluts;           // CLUT row in the atlas of each sprite
+} AtlasSheet;
+
 typedef struct _AnimatedSprite {
     Sprite *spriteList; //List of sprites in animation
     int numFrames;      //total number of frames (size of spriteList)
@@ -64,6 +76,7 @@ typedef struct _AnimatedSprite {
 
 
 #define OTLEN 8
+#define PRIM_BUFFER_LEN 32768
 
 typedef struct _FrameBuffer {
     DISPENV disp[2];
@@ -74,21 +87,56 @@ typedef struct _RenderContext{
     FrameBuffer db;
     int db_active;
     uint32_t ot[2][OTLEN];
-    char primbuff[2][32768];
+    char primbuff[2][PRIM_BUFFER_LEN];
     char *nextpri;
+    DR_TPAGE *tpage;            // Last tpage change added, NULL once another
+    unsigned short tpageValue;  // primitive has been added after it
 } RenderContext;
 
 #if DEBUG_MODE 
 extern int fnt;
 #endif
 
+// Widest possible TIM row, 1024 16-bit pixels
+#define TIM_MAX_ROW_BYTES 2048
+
+typedef enum _TimStreamState {
+    TIM_STREAM_HEADER       = 0,
+    TIM_STREAM_CLUT_HEADER  = 1,
+    TIM_STREAM_CLUT         = 2,
+    TIM_STREAM_PIXEL_HEADER = 3,
+    TIM_STREAM_PIXELS       = 4,
+    TIM_STREAM_DONE         = 5,
+    TIM_STREAM_INVALID      = 6
+} TimStreamState;
+
+// State for uploading a TIM to VRam as its sectors come off the disc.
+// tim is filled in as the headers are parsed, caddr and paddr stay NULL
+// since the data never sits in RAM.
+typedef struct _TimStream {
+    TIM_IMAGE tim;
+    RECT crect, prect;
+
+    TimStreamState state;
+    uint32_t header[3];             // Block header being collected
+    int headerLen;                  // Bytes of header collected so far
+    RECT *block;                    // Rect of the block being uploaded
+    int row;                        // Next row of block to upload
+    uint8_t carry[TIM_MAX_ROW_BYTES];  // Row split across two sectors
+    int carryLen;
+} TimStream;
+
 // Places external tim image into VRam and loads params into tparam.
+// The image and CLUT are placed by the VRam allocator, not the TIM header.
 void load_texture(uint32_t *tim, TIM_IMAGE *tparam);
 
-char *load_file(const char *filename);
+// Resets a TimStream to expect the start of a TIM file
+void init_tim_stream(TimStream *stream);
 
-// Loads file from the CD into VRam and loads params into tparam.
-void load_cd_texture(uint32_t *tim, TIM_IMAGE *tparam, const char *filename);
+// Feeds the next len bytes of a TIM file, uploading them to VRam as soon as
+// whole rows are available. Call DrawSync before reusing data. Like
+// load_texture, where the image goes is up to the VRam allocator.
+void stream_tim_bytes(TimStream *stream, const uint8_t *data, int len);
 
 // Loads tim into Sprite struct.
 void load_sprite(Sprite *sprite, TIM_IMAGE *tim);
@@ -101,6 +149,9 @@ void load_sprite(Sprite *sprite, TIM_IMAGE *tim);
 // numCol Number of columns of the sprite sheet
 void load_sprite_sheet(Sprite* spriteList, const int sH, const int sW, const int sNum, const int numCol, TIM_IMAGE *tim);
 
+// Loads the first sNum sprites of a sheet in an atlas in to a list.
+void load_atlas_sheet(Sprite *spriteList, const int sNum, const AtlasSheet *sheet, TIM_IMAGE *atlas);
+
 void rotate_sprite(Sprite *sprite, const int angle);
 
 void move_sprite(Sprite *sprite, const int x, const int y);
@@ -121,6 +172,12 @@ void animate(AnimatedSprite *animSprite);
 
 void change_bkg_color(const CVECTOR color);
 
+// Bytes of the PRIM_BUFFER_LEN primitive buffer used so far this frame
+int get_prim_bytes(void);
+
+// Primitives dropped since boot because the buffer was full
+int get_dropped_prims(void);
+
 // Draws ordering table, flips buffer
 void display(void);
 
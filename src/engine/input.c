@@ -21,65 +21,271 @@
 */
 
 #include "input.h"
+#include <hwregs_c.h>
+#include "timer.h"
 
-static unsigned char padbuff[2][34];
+#if INPUT_SUBFRAME
+#define SIO_STAT_TX_READY   0x0001
+#define SIO_STAT_RX_READY   0x0002
+#define SIO_STAT_IRQ        0x0200
 
-//store button state of last poll
-static uint16_t padStates[2];
+#define SIO_CTRL_TX_ENABLE  0x0001
+#define SIO_CTRL_DTR        0x0002
+#define SIO_CTRL_RX_ENABLE  0x0004
+#define SIO_CTRL_ACK_IRQ    0x0010
+#define SIO_CTRL_RESET      0x0040
+#define SIO_CTRL_DSR_IRQ    0x1000
+#define SIO_CTRL_PORT_2     0x2000
 
-static int _get_raw_input(const int port, const int button) {
-    // Parse controller input
-    PADTYPE* pad = (PADTYPE*)padbuff[port];
+#define SIO_MODE_8BIT       0x000d  // 8 data bits, no parity, baud x1
+#define SIO_BAUD_250K       (F_CPU / 250000)
 
-    // Only parse inputs when a controller is connected
-    if(pad->stat != 0) {
-        return 0;
-    }
+#define IRQ_SIO0_BIT        (1 << 7)
+
+// Loops to wait for a pad to acknowledge a byte, ~100us
+#define PAD_ACK_TIMEOUT     1000
+#define PAD_SELECT_DELAY    400
+
+#define PAD_CMD_ADDRESS     0x01
+#define PAD_CMD_READ        0x42
+#else
+// With a Multitap the BIOS fills in all four of its slots after the
+// port's two byte header, each laid out like a PADTYPE
+#define MULTITAP_SLOT_LEN 8
+#define PAD_BUFFER_LEN (2 + MULTITAP_SLOTS * MULTITAP_SLOT_LEN)
+
+static unsigned char padbuff[INPUT_PORTS][PAD_BUFFER_LEN];
+#endif
+
+InputFrame inputFrames[INPUT_MAX_PADS];
+
+static InputEvent frameEvents[INPUT_MAX_PADS][INPUT_MAX_EVENTS];
+static int numFrameEvents[INPUT_MAX_PADS];
+static int numPads = 0;
+
+static int _is_digital(const int type) {
+    // Digital pad, dual-analog and dual-shock
+    return (type == 0x4) || (type == 0x5) || (type == 0x7);
+}
+
+static void _set_frame(const int pad, const uint16_t held, const int isConnected, const int type) {
+    InputFrame *frame = &inputFrames[pad];
+    uint16_t last = frame->held;
+
+    frame->held = held;
+    frame->pressed = held & ~last;
+    frame->released = last & ~held;
+    frame->isConnected = isConnected;
+    frame->type = type;
+}
+
+static void _add_frame_event(const int pad, const uint32_t time, const uint16_t buttons, const int isDown) {
+    if(buttons == 0 || numFrameEvents[pad] >= INPUT_MAX_EVENTS)
+        return;
+
+    InputEvent *ev = &frameEvents[pad][numFrameEvents[pad]++];
+    ev->time = time;
+    ev->buttons = buttons;
+    ev->isDown = isDown;
+}
+
+#if INPUT_SUBFRAME
+// Written by the timer IRQ, taken by poll_input
+typedef struct _PadSamples {
+    uint16_t held;
+    uint16_t pressed;   // Every button that went down since the last poll
+    uint16_t released;
+    uint8_t isConnected;
+    uint8_t type;
+    int numEvents;
+    InputEvent events[INPUT_MAX_EVENTS];
+} PadSamples;
+
+static volatile PadSamples samples[INPUT_PORTS];
+static int sampleTicks = 0;
+static volatile int isSamplingHeld = 0;
 
-    // Only parse when a digital pad, 
-    // dual-analog and dual-shock is connected
-    if((pad->type == 0x4) ||
-        (pad->type == 0x5) ||
-        (pad->type == 0x7)) {
-        return !(pad->btn&button);
+// Sends a byte and returns the one received, -1 if the pad didn't
+// acknowledge it. The last byte of a transfer is never acknowledged.
+static int _exchange(const uint8_t out, const int isLast) {
+    IRQ_STAT = ~IRQ_SIO0_BIT;
+    SIO_CTRL(0) |= SIO_CTRL_ACK_IRQ;
+
+    while(!(SIO_STAT(0) & SIO_STAT_TX_READY));
+    SIO_DATA(0) = out;
+
+    while(!(SIO_STAT(0) & SIO_STAT_RX_READY));
+    int in = SIO_DATA(0);
+
+    if(isLast)
+        return in;
+
+    for(int i = PAD_ACK_TIMEOUT; i; i--) {
+        if(SIO_STAT(0) & SIO_STAT_IRQ)
+            return in;
     }
 
-    return 0;
+    return -1;
+}
+
+// Reads the buttons of a pad, returns its type or -1 if there is none
+static int _read_pad(const int port, uint16_t *buttons) {
+    int id, lo, hi;
+
+    SIO_CTRL(0) = SIO_CTRL_TX_ENABLE | SIO_CTRL_DTR | SIO_CTRL_RX_ENABLE | SIO_CTRL_DSR_IRQ |
+        (port ? SIO_CTRL_PORT_2 : 0);
+    for(volatile int i = PAD_SELECT_DELAY; i; i--);
+
+    // Address, read command, then the id, 0x5a and two bytes of buttons
+    int ok = (_exchange(PAD_CMD_ADDRESS, 0) >= 0) &&
+        ((id = _exchange(PAD_CMD_READ, 0)) >= 0) &&
+        (_exchange(0, 0) == 0x5a) &&
+        ((lo = _exchange(0, 0)) >= 0) &&
+        ((hi = _exchange(0, 1)) >= 0);
+
+    SIO_CTRL(0) = 0;
+    IRQ_STAT = ~IRQ_SIO0_BIT;
+
+    if(!ok)
+        return -1;
+
+    // Buttons read 0 while down
+    *buttons = ~(lo | (hi << 8));
+    return id >> 4;
+}
+
+static void _sample_port(const int port, const uint32_t time) {
+    volatile PadSamples *pad = &samples[port];
+    uint16_t held = 0;
+    int type = _read_pad(port, &held);
+
+    if(type < 0 || !_is_digital(type))
+        held = 0;
+
+    uint16_t down = held & ~pad->held;
+    uint16_t up = pad->held & ~held;
+
+    pad->held = held;
+    pad->pressed |= down;
+    pad->released |= up;
+    pad->isConnected = (type >= 0);
+    pad->type = (type >= 0) ? type : 0;
+
+    for(int d = 0; d < 2; d++) {
+        uint16_t buttons = d ? down : up;
+
+        if(buttons && pad->numEvents < INPUT_MAX_EVENTS) {
+            volatile InputEvent *ev = &pad->events[pad->numEvents++];
+            ev->time = time;
+            ev->buttons = buttons;
+            ev->isDown = d;
+        }
+    }
 }
 
+static void _sample_pads(void) {
+    if(isSamplingHeld || ++sampleTicks < INPUT_SAMPLE_MS)
+        return;
+    sampleTicks = 0;
 
-int button_up(const int port, const int button) {
-    return (!_get_raw_input(port, button) && !(padStates[port]&button));
+    uint32_t time = get_system_time_us();
+
+    for(int port = 0; port < INPUT_PORTS; port++)
+        _sample_port(port, time);
 }
 
-int button_down(const int port, const int button) {
-    return (_get_raw_input(port, button) && padStates[port]&button);
+void poll_input(void) {
+    EnterCriticalSection();
+
+    for(int port = 0; port < INPUT_PORTS; port++) {
+        volatile PadSamples *pad = &samples[port];
+        InputFrame *frame = &inputFrames[port];
+
+        frame->held = pad->held;
+        frame->pressed = pad->pressed;
+        frame->released = pad->released;
+        frame->isConnected = pad->isConnected;
+        frame->type = pad->type;
+
+        numFrameEvents[port] = pad->numEvents;
+        for(int i = 0; i < pad->numEvents; i++)
+            frameEvents[port][i] = pad->events[i];
+
+        pad->pressed = 0;
+        pad->released = 0;
+        pad->numEvents = 0;
+    }
+
+    ExitCriticalSection();
+
+    // Multitaps are left to the BIOS driver, one pad per port here
+    numPads = 0;
+    for(int pad = 0; pad < INPUT_MAX_PADS; pad++) {
+        if(pad >= INPUT_PORTS) {
+            _set_frame(pad, 0, 0, 0);
+            numFrameEvents[pad] = 0;
+        }
+        numPads += inputFrames[pad].isConnected;
+    }
 }
 
-int button_pressed(const int port, const int button) {
-    return  (_get_raw_input(port, button) && !(padStates[port]&button));
+void init_input(void) {
+    SIO_CTRL(0) = SIO_CTRL_RESET;
+    SIO_MODE(0) = SIO_MODE_8BIT;
+    SIO_BAUD(0) = SIO_BAUD_250K;
+    SIO_CTRL(0) = 0;
+
+    set_system_tick_callback(&_sample_pads);
 }
 
-void poll_input(const int port) {
-    // Parse controller input
-    PADTYPE* pad = (PADTYPE*)padbuff[port];
+void hold_input_sampling(const int isHeld) {
+    isSamplingHeld = isHeld;
+}
+#else
+static void _read_pad_buffer(const int pad, const PADTYPE *buffer, const uint32_t time) {
+    InputFrame *frame = &inputFrames[pad];
 
     // Only parse inputs when a controller is connected
-    if(pad->stat != 0) {
-        return;
+    if(buffer == NULL || buffer->stat != 0) {
+        _set_frame(pad, 0, 0, 0);
+    } else if(_is_digital(buffer->type)) {
+        // Buttons read 0 while down
+        _set_frame(pad, ~buffer->btn, 1, buffer->type);
+    } else {
+        _set_frame(pad, 0, 1, buffer->type);
     }
 
-    // Only parse when a digital pad, 
-    // dual-analog and dual-shock is connected
-    if((pad->type == 0x4) ||
-        (pad->type == 0x5) ||
-        (pad->type == 0x7)) {
-        padStates[port] = pad->btn;
+    numFrameEvents[pad] = 0;
+    _add_frame_event(pad, time, frame->released, 0);
+    _add_frame_event(pad, time, frame->pressed, 1);
+
+    numPads += frame->isConnected;
+}
+
+void poll_input(void) {
+    uint32_t time = get_system_time_us();
+    int pad = 0;
+
+    numPads = 0;
+
+    for(int port = 0; port < INPUT_PORTS && pad < INPUT_MAX_PADS; port++) {
+        const PADTYPE *buffer = (const PADTYPE*)padbuff[port];
+
+        if(buffer->stat == 0 && buffer->type == PAD_TYPE_MULTITAP) {
+            for(int slot = 0; slot < MULTITAP_SLOTS && pad < INPUT_MAX_PADS; slot++)
+                _read_pad_buffer(pad++, (const PADTYPE*)&padbuff[port][2 + slot*MULTITAP_SLOT_LEN], time);
+        } else {
+            _read_pad_buffer(pad++, buffer, time);
+        }
     }
+
+    // Pads that went away with a Multitap
+    for(; pad < INPUT_MAX_PADS; pad++)
+        _read_pad_buffer(pad, NULL, time);
 }
 
 void init_input(void) {
-    InitPAD(padbuff[0], 34, padbuff[1], 34);
+    InitPAD(padbuff[0], PAD_BUFFER_LEN, padbuff[1], PAD_BUFFER_LEN);
 
     //So controller polling does not return faulty data.
     padbuff[0][0] = padbuff[0][1] = 0xff;
@@ -87,4 +293,30 @@ void init_input(void) {
 
     StartPAD();
     ChangeClearPAD(1); //Avoid "VSync: Timeout" tty message caused bt StartPAD()
-}
\ No newline at end of file
+}
+
+void hold_input_sampling(const int isHeld) {
+}
+#endif
+
+int get_num_pads(void) {
+    return numPads;
+}
+
+int get_input_events(const int pad, const InputEvent **events) {
+    *events = frameEvents[pad];
+    return numFrameEvents[pad];
+}
+
+void set_input_frame(const int pad, const uint16_t held, const uint16_t lastHeld) {
+    InputFrame *frame = &inputFrames[pad];
+
+    frame->held = lastHeld;
+    _set_frame(pad, held, 1, 0x4);
+
+    uint32_t time = get_system_time_us();
+
+    numFrameEvents[pad] = 0;
+    _add_frame_event(pad, time, frame->released, 0);
+    _add_frame_event(pad, time, frame->pressed, 1);
+}
@@ -22,18 +22,89 @@
 
 #pragma once
 
+#include <stdint.h>
 #include <psxapi.h>
 #include <psxpad.h>
 
-// Returns true when button is released
-int button_up(const int port, const int button);
+#define INPUT_PORTS 2
 
-// Returns true when button is pressed down when it previously was not
-int button_down(const int port, const int button);
+// Port 1's pads come first, all four slots if a Multitap is plugged in,
+// then port 2's, up to INPUT_MAX_PADS. Without a Multitap pad 0 is port 1
+// and pad 1 is port 2.
+#define INPUT_MAX_PADS 4
+#define MULTITAP_SLOTS 4
+#define PAD_TYPE_MULTITAP 0x8
 
-// Returns true while button is currently held down
-int button_pressed(const int port, const int button);
+// Set to 1 to read the pads from the system timer IRQ every
+// INPUT_SAMPLE_MS instead of once a frame by the BIOS at vblank. Taps
+// shorter than a frame still show up as pressed and released, and every
+// change is timestamped. Each read busy-waits on SIO0 for ~0.2ms per pad.
+// Replays and link play only carry each frame's held buttons, so the game
+// doesn't record marathons or offer Link Versus with it set.
+#define INPUT_SUBFRAME 0
+#define INPUT_SAMPLE_MS 4
 
-void poll_input(const int port);
+// Button changes kept per port per frame, later ones are dropped
+#define INPUT_MAX_EVENTS 16
+
+// What a pad did this frame, one PAD_* bit per button. Read the pad once
+// by poll_input, or supplied by set_input_frame in its place.
+typedef struct _InputFrame {
+    uint16_t held;      // Down this frame
+    uint16_t pressed;   // Down this frame, up the last
+    uint16_t released;  // Up this frame, down the last
+    uint8_t isConnected;
+    uint8_t type;       // PADTYPE type, 0 when disconnected
+} InputFrame;
+
+// A change of one or more buttons, in the order they happened
+typedef struct _InputEvent {
+    uint32_t time;      // get_system_time_us when it was seen
+    uint16_t buttons;   // PAD_* bits that changed
+    uint16_t isDown;
+} InputEvent;
+
+extern InputFrame inputFrames[INPUT_MAX_PADS];
+
+// Returns true the frame button goes down
+static inline int button_pressed(const int pad, const int button) {
+    return (inputFrames[pad].pressed & button) != 0;
+}
+
+// Returns true while button is down
+static inline int button_held(const int pad, const int button) {
+    return (inputFrames[pad].held & button) != 0;
+}
+
+// Returns true the frame button comes back up
+static inline int button_released(const int pad, const int button) {
+    return (inputFrames[pad].released & button) != 0;
+}
+
+static inline const InputFrame *get_input_frame(const int pad) {
+    return &inputFrames[pad];
+}
+
+// Takes this frame's snapshot of every pad, call once a frame before
+// anything reads input. INPUT_SUBFRAME reads one pad per port, Multitaps
+// need the BIOS driver.
+void poll_input(void);
+
+// Pads connected as of the last poll_input
+int get_num_pads(void);
+
+// The button changes that make up this frame's snapshot, oldest first.
+// Without INPUT_SUBFRAME they all have the time of the poll.
+int get_input_events(const int pad, const InputEvent **events);
+
+// Makes held the pad's buttons this frame instead of the real ones, for
+// replays, AI and remote players. lastHeld is what it held the frame
+// before, frames can be set out of order. Call after poll_input.
+void set_input_frame(const int pad, const uint16_t held, const uint16_t lastHeld);
+
+// While held, INPUT_SUBFRAME leaves SIO0 alone for the memory card and the
+// pads keep the state they had. Does nothing without INPUT_SUBFRAME, the
+// BIOS takes turns itself.
+void hold_input_sampling(const int isHeld);
 
 void init_input(void);
@@ -0,0 +1,85 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#include "lz.h"
+
+static inline int _read_length(const uint8_t **src, const uint8_t *srcEnd, int len) {
+    if(len != 15)
+        return len;
+
+    const uint8_t *p = *src;
+    uint8_t b;
+
+    do {
+        if(p >= srcEnd) return -1;
+        b = *p++;
+        len += b;
+    } while(b == 255);
+
+    *src = p;
+    return len;
+}
+
+int decompress_lz(uint8_t *dest, const int rawSize, const uint8_t *src, const int size) {
+    const uint8_t *srcEnd = src + size;
+    uint8_t *out = dest;
+    uint8_t *outEnd = dest + rawSize;
+
+    while(src < srcEnd) {
+        const uint8_t token = *src++;
+
+        int len = _read_length(&src, srcEnd, token >> 4);
+        if(len < 0 || len > srcEnd - src || len > outEnd - out)
+            return -1;
+
+        // Forward byte copies, so literals are safe to move down when
+        // decoding in place
+        while(len--)
+            *out++ = *src++;
+
+        // The last sequence has no match
+        if(src >= srcEnd)
+            break;
+
+        if(srcEnd - src < 2)
+            return -1;
+
+        const int offset = src[0] | (src[1] << 8);
+        src += 2;
+
+        len = _read_length(&src, srcEnd, token & 15);
+        if(len < 0)
+            return -1;
+
+        len += LZ_MIN_MATCH;
+        if(offset == 0 || offset > out - dest || len > outEnd - out)
+            return -1;
+
+        // Byte at a time on purpose, overlapping matches repeat a pattern
+        const uint8_t *match = out - offset;
+        while(len--)
+            *out++ = *match++;
+    }
+
+    return out - dest;
+}
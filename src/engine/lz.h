@@ -0,0 +1,43 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <stdint.h>
+
+// Decoder for the LZ4-style blocks written by tools/lz.py.
+//
+// A block can be decoded in place: load it at the end of a buffer of
+// rawSize + LZ_INPLACE_MARGIN(size) bytes and decode it to the start of the
+// same buffer, which then becomes the upload staging buffer.
+
+#define LZ_MIN_MATCH 4
+#define LZ_INPLACE_MARGIN(size) (((size) >> 8) + 32)
+
+// Size of a buffer that a block of the given sizes can be decoded in place in
+#define LZ_INPLACE_SIZE(rawSize, size) ((rawSize) + LZ_INPLACE_MARGIN(size))
+
+// Decodes size bytes of src into dest, which holds rawSize bytes. src may
+// point into dest as described above. Returns the number of bytes written,
+// or -1 if the block is corrupt.
+int decompress_lz(uint8_t *dest, const int rawSize, const uint8_t *src, const int size);
@@ -0,0 +1,388 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "memcard.h"
+#include <stdio.h>
+#include <string.h>
+#include <psxapi.h>
+#include "input.h"
+#include "timer.h"
+
+// Directory frame layout, see the card's block 0
+#define FRAME_STATE     0x00
+#define FRAME_SIZE      0x04
+#define FRAME_NEXT      0x08
+#define FRAME_NAME      0x0a
+#define FRAME_CHECKSUM  0x7f
+
+#define FRAME_FREE      0xa0    // 0xa1-0xa3 are deleted files, free too
+#define FRAME_FIRST     0x51
+#define FRAME_MIDDLE    0x52
+#define FRAME_LAST      0x53
+#define FRAME_NO_NEXT   0xffff
+
+typedef enum _CardPhase {
+    PHASE_DIRECTORY = 0,    // Reading the directory frames
+    PHASE_DATA      = 1,    // Moving the file's sectors
+    PHASE_COMMIT    = 2     // Writing the frames of a newly made file
+} CardPhase;
+
+static CardJob *jobQueue[CARD_JOB_QUEUE_LEN];
+static int queueHead  = 0;
+static int queueCount = 0;
+
+static CardJob *activeJob = NULL;
+static CardPhase phase;
+
+// Each card's directory, kept once read until the card is swapped or fails
+static uint8_t directory[CARD_PORTS][CARD_NUM_FRAMES][CARD_SECTOR_SIZE];
+static int isDirectoryRead[CARD_PORTS];
+static int framesRead;
+
+// The frames of the active job's file in order, and the ones a new file
+// still has to write. Its data goes first, so the file only shows up once
+// it is all there.
+static int chain[CARD_NUM_FRAMES];
+static int chainLen;
+static uint16_t dirtyFrames;
+
+// The sector in flight. The BIOS reads and writes it from its IRQ.
+static uint8_t sectorBuffer[CARD_SECTOR_SIZE];
+static int isTransferring = 0;
+static uint32_t transferStart;
+static int numRetries;
+
+static int eventDone, eventError, eventTimeout, eventNewCard;
+
+static int _get16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static void _put16(uint8_t *p, const int v) {
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void _put32(uint8_t *p, const uint32_t v) {
+    _put16(p, v);
+    _put16(p + 2, v >> 16);
+}
+
+static void _write_frame(uint8_t *frame, const int state, const uint32_t size, const int next, const char *name) {
+    uint8_t sum = 0;
+
+    memset(frame, 0, CARD_SECTOR_SIZE);
+    _put32(frame + FRAME_STATE, state);
+    _put32(frame + FRAME_SIZE, size);
+    _put16(frame + FRAME_NEXT, next);
+    if(name)
+        strncpy((char*)frame + FRAME_NAME, name, CARD_NAME_LEN);
+
+    for(int i = 0; i < FRAME_CHECKSUM; i++)
+        sum ^= frame[i];
+    frame[FRAME_CHECKSUM] = sum;
+}
+
+static void _finish_job(CardJob *job, const CardJobStatus status, const CardError error) {
+    job->status = status;
+    job->error = error;
+    activeJob = NULL;
+
+    if(status == CARD_JOB_ERROR)
+        printf("Memory card %d: %s failed, error %d.\n", job->port + 1, job->filename, error);
+
+    if(job->onComplete)
+        job->onComplete(job);
+}
+
+// Moves on once the data is done, to the new file's frames if there are any
+static void _end_data(CardJob *job) {
+    if(dirtyFrames)
+        phase = PHASE_COMMIT;
+    else
+        _finish_job(job, CARD_JOB_DONE, CARD_OK);
+}
+
+// Finds the job's file in the directory, or makes room for it when writing
+static void _resolve_file(CardJob *job) {
+    uint8_t (*frames)[CARD_SECTOR_SIZE] = directory[job->port];
+    int first = -1;
+
+    for(int i = 0; i < CARD_NUM_FRAMES; i++) {
+        if(frames[i][FRAME_STATE] == FRAME_FIRST &&
+            strncmp((const char*)frames[i] + FRAME_NAME, job->filename, CARD_NAME_LEN) == 0) {
+            first = i;
+            break;
+        }
+    }
+
+    chainLen = 0;
+    dirtyFrames = 0;
+
+    if(first >= 0) {
+        // The next links are the card's, don't trust them to end
+        for(int i = first; i != FRAME_NO_NEXT && i < CARD_NUM_FRAMES && chainLen < CARD_NUM_FRAMES;
+            i = _get16(frames[i] + FRAME_NEXT)) {
+            chain[chainLen++] = i;
+        }
+    } else if(!job->isWrite) {
+        _finish_job(job, CARD_JOB_ERROR, CARD_ERROR_NOT_FOUND);
+        return;
+    } else {
+        for(int i = 0; i < CARD_NUM_FRAMES && chainLen < job->blocks; i++) {
+            if((frames[i][FRAME_STATE] & 0xf0) == FRAME_FREE)
+                chain[chainLen++] = i;
+        }
+
+        if(chainLen < job->blocks) {
+            _finish_job(job, CARD_JOB_ERROR, CARD_ERROR_FULL);
+            return;
+        }
+    }
+
+    // Check the file is big enough before the directory is touched, a job
+    // that fails here mustn't leave the new file's frames in the cache
+    job->numSectors = (job->size + CARD_SECTOR_SIZE - 1) / CARD_SECTOR_SIZE;
+    if(job->numSectors > chainLen * CARD_BLOCK_SECTORS) {
+        _finish_job(job, CARD_JOB_ERROR, CARD_ERROR_FULL);
+        return;
+    }
+
+    if(first < 0) {
+        for(int i = 0; i < chainLen; i++) {
+            int isLast = (i == chainLen - 1);
+            int state = (i == 0) ? FRAME_FIRST : isLast ? FRAME_LAST : FRAME_MIDDLE;
+
+            _write_frame(frames[chain[i]], state, (i == 0) ? chainLen * CARD_BLOCK_SIZE : 0,
+                isLast ? FRAME_NO_NEXT : chain[i + 1], (i == 0) ? job->filename : NULL);
+            dirtyFrames |= 1 << chain[i];
+        }
+    }
+
+    phase = PHASE_DATA;
+    if(job->numSectors == 0)
+        _end_data(job);
+}
+
+static void _start_job(CardJob *job) {
+    activeJob = job;
+    job->status = CARD_JOB_BUSY;
+    job->error = CARD_OK;
+    job->sectorsDone = 0;
+    job->numSectors = 0;
+    numRetries = 0;
+
+    if(isDirectoryRead[job->port]) {
+        _resolve_file(job);
+    } else {
+        phase = PHASE_DIRECTORY;
+        framesRead = 0;
+    }
+}
+
+static void _start_sector(CardJob *job) {
+    int channel = job->port << 4;
+    int sector, isWrite, started;
+
+    if(phase == PHASE_DIRECTORY) {
+        sector = 1 + framesRead;
+        isWrite = 0;
+    } else if(phase == PHASE_DATA) {
+        int i = job->sectorsDone;
+
+        sector = (chain[i / CARD_BLOCK_SECTORS] + 1) * CARD_BLOCK_SECTORS + (i % CARD_BLOCK_SECTORS);
+        isWrite = job->isWrite;
+
+        // The last sector of the file is padded out
+        if(isWrite) {
+            int offset = i * CARD_SECTOR_SIZE;
+            int len = job->size - offset;
+
+            if(len > CARD_SECTOR_SIZE)
+                len = CARD_SECTOR_SIZE;
+            memset(sectorBuffer, 0, CARD_SECTOR_SIZE);
+            memcpy(sectorBuffer, job->buffer + offset, len);
+        }
+    } else {
+        int frame = 0;
+
+        while(!(dirtyFrames & (1 << frame)))
+            frame++;
+
+        sector = 1 + frame;
+        isWrite = 1;
+        memcpy(sectorBuffer, directory[job->port][frame], CARD_SECTOR_SIZE);
+    }
+
+    // Clear whatever an earlier transfer left behind
+    TestEvent(eventDone);
+    TestEvent(eventError);
+    TestEvent(eventTimeout);
+    TestEvent(eventNewCard);
+
+    // The pads must not be read over SIO0 while the card is
+    hold_input_sampling(1);
+
+    if(isWrite)
+        started = _card_write(channel, sector, sectorBuffer);
+    else
+        started = _card_read(channel, sector, sectorBuffer);
+
+    // The BIOS is still busy, try again next frame
+    if(!started) {
+        hold_input_sampling(0);
+        return;
+    }
+
+    isTransferring = 1;
+    transferStart = get_system_time();
+}
+
+static void _end_sector(CardJob *job) {
+    numRetries = 0;
+
+    if(phase == PHASE_DIRECTORY) {
+        memcpy(directory[job->port][framesRead], sectorBuffer, CARD_SECTOR_SIZE);
+
+        if(++framesRead >= CARD_NUM_FRAMES) {
+            isDirectoryRead[job->port] = 1;
+            _resolve_file(job);
+        }
+    } else if(phase == PHASE_DATA) {
+        if(!job->isWrite) {
+            int offset = job->sectorsDone * CARD_SECTOR_SIZE;
+            int len = job->size - offset;
+
+            memcpy(job->buffer + offset, sectorBuffer, (len < CARD_SECTOR_SIZE) ? len : CARD_SECTOR_SIZE);
+        }
+
+        if(++job->sectorsDone >= job->numSectors)
+            _end_data(job);
+    } else {
+        int frame = 0;
+
+        while(!(dirtyFrames & (1 << frame)))
+            frame++;
+
+        dirtyFrames &= ~(1 << frame);
+        if(!dirtyFrames)
+            _finish_job(job, CARD_JOB_DONE, CARD_OK);
+    }
+}
+
+// Retries the sector, or gives up on the job. The directory may not be the
+// card's any more either way.
+static void _fail_sector(CardJob *job, const int isNewCard) {
+    isDirectoryRead[job->port] = 0;
+
+    if(++numRetries > CARD_MAX_RETRIES) {
+        _finish_job(job, CARD_JOB_ERROR, CARD_ERROR_NO_CARD);
+        return;
+    }
+
+    // A different card, start over from its directory
+    if(isNewCard) {
+        job->sectorsDone = 0;
+        phase = PHASE_DIRECTORY;
+        framesRead = 0;
+    }
+}
+
+void init_card_job(CardJob *job, const int port, const char *filename) {
+    memset(job, 0, sizeof(CardJob));
+    job->port = port;
+    job->filename = filename;
+    job->blocks = 1;
+}
+
+int queue_card_job(CardJob *job) {
+    if(queueCount >= CARD_JOB_QUEUE_LEN) {
+        printf("Memory card queue full.\n");
+        return 0;
+    }
+
+    job->status = CARD_JOB_QUEUED;
+    jobQueue[(queueHead + queueCount) % CARD_JOB_QUEUE_LEN] = job;
+    queueCount++;
+
+    return 1;
+}
+
+void update_memcard(void) {
+    CardJob *job = activeJob;
+
+    if(isTransferring) {
+        int isDone = TestEvent(eventDone);
+        int isNewCard = !isDone && TestEvent(eventNewCard);
+        int isError = !isDone && (TestEvent(eventError) || TestEvent(eventTimeout) ||
+            (get_system_time() - transferStart) > CARD_TIMEOUT_MS);
+
+        if(!isDone && !isNewCard && !isError)
+            return;
+
+        isTransferring = 0;
+        hold_input_sampling(0);
+
+        if(isDone)
+            _end_sector(job);
+        else
+            _fail_sector(job, isNewCard);
+    }
+
+    // Jobs that fail or finish without touching the card end here, keep
+    // going until one has a sector to move
+    while(activeJob == NULL && queueCount > 0) {
+        job = jobQueue[queueHead];
+        queueHead = (queueHead + 1) % CARD_JOB_QUEUE_LEN;
+        queueCount--;
+
+        _start_job(job);
+    }
+
+    if(activeJob != NULL)
+        _start_sector(activeJob);
+}
+
+int is_memcard_busy(void) {
+    return (activeJob != NULL) || (queueCount > 0);
+}
+
+void init_memcard(void) {
+    EnterCriticalSection();
+    eventDone    = OpenEvent(SwCARD, EvSpIOE, EvMdNOINTR, NULL);
+    eventError   = OpenEvent(SwCARD, EvSpERROR, EvMdNOINTR, NULL);
+    eventTimeout = OpenEvent(SwCARD, EvSpTIMOUT, EvMdNOINTR, NULL);
+    eventNewCard = OpenEvent(SwCARD, EvSpNEW, EvMdNOINTR, NULL);
+    ExitCriticalSection();
+
+    EnableEvent(eventDone);
+    EnableEvent(eventError);
+    EnableEvent(eventTimeout);
+    EnableEvent(eventNewCard);
+
+    // With INPUT_SUBFRAME the pads are read without the BIOS
+    InitCARD(!INPUT_SUBFRAME);
+    StartCARD();
+    _bu_init();
+
+    memset(isDirectoryRead, 0, sizeof(isDirectoryRead));
+}
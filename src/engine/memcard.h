@@ -0,0 +1,102 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+// Memory card files read and written a sector at a time in the background.
+// A transfer takes the card several ms and the BIOS runs it from its own
+// IRQ, update_memcard only starts the next sector once the last is done,
+// so a job never holds up a frame.
+//
+// Files are found and created through the card's directory, block 0, which
+// is read once per card and kept. A file the BIOS or other games made is
+// left alone except for the job's own file.
+
+#define CARD_PORTS 2
+#define CARD_SECTOR_SIZE 128
+#define CARD_BLOCK_SIZE 8192
+#define CARD_BLOCK_SECTORS (CARD_BLOCK_SIZE / CARD_SECTOR_SIZE)
+#define CARD_NUM_FRAMES 15  // Directory entries, one per block after block 0
+#define CARD_NAME_LEN 20
+
+#define CARD_JOB_QUEUE_LEN 4
+#define CARD_MAX_RETRIES 4
+#define CARD_TIMEOUT_MS 500 // A sector the BIOS never reports back on
+
+typedef enum _CardJobStatus {
+    CARD_JOB_IDLE   = 0,
+    CARD_JOB_QUEUED = 1,
+    CARD_JOB_BUSY   = 2,
+    CARD_JOB_DONE   = 3,
+    CARD_JOB_ERROR  = 4
+} CardJobStatus;
+
+typedef enum _CardError {
+    CARD_OK             = 0,
+    CARD_ERROR_NO_CARD  = 1,    // Nothing answered, or it kept failing
+    CARD_ERROR_NOT_FOUND = 2,   // Reading a file that isn't there
+    CARD_ERROR_FULL     = 3     // Not enough free blocks, or the file is too small
+} CardError;
+
+typedef struct _CardJob CardJob;
+
+// Called from update_memcard once the job is done or failed
+typedef void (*CardJobCallback)(CardJob *job);
+
+struct _CardJob {
+    int port;               // 0 for slot 1, 1 for slot 2
+    const char *filename;   // e.g. "BASLUS-00000GAME", at most CARD_NAME_LEN
+    int isWrite;
+
+    // Bytes read into or written from buffer, from the start of the file.
+    // buffer must stay untouched until the job completes.
+    uint8_t *buffer;
+    int size;
+
+    // Blocks a write creates the file with when it isn't on the card yet
+    int blocks;
+
+    CardJobCallback onComplete;
+    void *userData;
+
+    volatile CardJobStatus status;
+    CardError error;
+    int sectorsDone;
+    int numSectors;
+};
+
+// Sets up a job on the given port and file, reading by default
+void init_card_job(CardJob *job, const int port, const char *filename);
+
+// Adds the job to the queue, returns 0 if the queue is full
+int queue_card_job(CardJob *job);
+
+// Collects the finished sector, fires callbacks and starts the next
+// sector. Call once a frame.
+void update_memcard(void);
+
+int is_memcard_busy(void);
+
+// Starts the BIOS card driver, after init_input
+void init_memcard(void);
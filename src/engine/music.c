@@ -0,0 +1,320 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#include "music.h"
+#include <stdio.h>
+#include <string.h>
+#include <psxapi.h>
+#include "timer.h"
+
+#define VAG_HEADER_SIZE  ((int)sizeof(VAG_Header))
+#define ADPCM_BLOCK_SIZE 16
+
+// Flags in the second byte of every ADPCM block
+#define ADPCM_LOOP_END    0x01
+#define ADPCM_LOOP_REPEAT 0x02
+#define ADPCM_LOOP_START  0x04
+
+#define SPU_CTRL_IRQ_ENABLE (1 << 6)
+#define SPU_MAX_PITCH       0x3fff
+
+#define SAMPLES_PER_HALF (MUSIC_HALF_SIZE / ADPCM_BLOCK_SIZE * 28)
+
+static const PakEntry *musicEntry = NULL;
+static int ringAddr = 0;
+static int dataSize;    // ADPCM bytes following the VAG header
+static int sampleRate;
+static int playRate;    // sampleRate at the current speed
+static int isPlaying = 0;
+
+// Set by the IRQ when the voice leaves a half, cleared once it is refilled
+static volatile int isHalfFree[2];
+
+// The half the IRQ is waiting for the voice to enter
+static volatile int irqHalf;
+
+// When each half was freed, and how far behind the voice the refills got
+static volatile uint32_t freeTime[2];
+static volatile int numUnderruns = 0;
+static int maxRefillUs = 0;
+
+// stop_music can't rewind while a read is in flight, update_music does it
+static int isRewindPending = 0;
+
+// The half being refilled, how much of it is staged and where in the song
+// the next read starts. readPos wraps at dataSize.
+static int fillHalf = -1;
+static int staged;
+static int readPos;
+
+static uint32_t staging[MUSIC_HALF_SIZE/4];
+
+// Byte range of the entry wanted from the read in flight
+static CdLoadRequest musicReq;
+static int reqStart, reqEnd;
+static int reqFirstSector;
+
+static void _music_irq(void) {
+    // The voice has just entered irqHalf. If that was never refilled it is
+    // replaying what was left there a lap ago.
+    if(isHalfFree[irqHalf])
+        numUnderruns++;
+
+    // The other half is done playing
+    isHalfFree[irqHalf ^ 1] = 1;
+    freeTime[irqHalf ^ 1] = get_system_time_us();
+    irqHalf ^= 1;
+
+    // Clearing the enable bit acknowledges the IRQ
+    SPU_CTRL &= ~SPU_CTRL_IRQ_ENABLE;
+    SPU_IRQ_ADDR = getSPUAddr(ringAddr + irqHalf * MUSIC_HALF_SIZE);
+    SPU_CTRL |= SPU_CTRL_IRQ_ENABLE;
+}
+
+static void _music_sector(CdLoadRequest *req, const uint32_t *sector, const int index) {
+    int sectorStart = (reqFirstSector + index) * CD_SECTOR_SIZE;
+    int from = (reqStart > sectorStart) ? reqStart : sectorStart;
+    int to = (reqEnd < sectorStart + CD_SECTOR_SIZE) ? reqEnd : sectorStart + CD_SECTOR_SIZE;
+
+    if(to <= from)
+        return;
+
+    memcpy((uint8_t*)staging + staged, (const uint8_t*)sector + (from - sectorStart), to - from);
+    staged += to - from;
+    readPos += to - from;
+}
+
+// Reads as much of the half as is left before the end of the song
+static void _queue_read(void) {
+    if(readPos >= dataSize)
+        readPos = 0;
+
+    int len = MUSIC_HALF_SIZE - staged;
+    if(len > dataSize - readPos) len = dataSize - readPos;
+
+    reqStart = VAG_HEADER_SIZE + readPos;
+    reqEnd = reqStart + len;
+    reqFirstSector = reqStart / CD_SECTOR_SIZE;
+
+    init_cd_request(&musicReq, NULL);
+    musicReq.lba = get_pak_entry_lba(musicEntry) + reqFirstSector;
+    musicReq.size = reqEnd - reqFirstSector * CD_SECTOR_SIZE;
+    musicReq.onSector = &_music_sector;
+
+    // If the queue is full the request stays idle and is retried next frame
+    queue_cd_load(&musicReq);
+}
+
+static void _upload_half(const int half) {
+    uint8_t *blocks = (uint8_t*)staging;
+
+    // The song's own loop flags would stop the voice or jump it elsewhere,
+    // the ring loops on its own first and last blocks instead
+    for(int i = 1; i < MUSIC_HALF_SIZE; i += ADPCM_BLOCK_SIZE)
+        blocks[i] = 0;
+
+    if(half == 0)
+        blocks[1] = ADPCM_LOOP_START;
+    else
+        blocks[MUSIC_HALF_SIZE - ADPCM_BLOCK_SIZE + 1] = ADPCM_LOOP_END | ADPCM_LOOP_REPEAT;
+
+    // Transfers over the IRQ address trigger the IRQ too, and the next one
+    // is at the start of this half
+    SPU_CTRL &= ~SPU_CTRL_IRQ_ENABLE;
+    write_spu_ram(ringAddr + half * MUSIC_HALF_SIZE, staging, MUSIC_HALF_SIZE);
+
+    if(isPlaying)
+        SPU_CTRL |= SPU_CTRL_IRQ_ENABLE;
+}
+
+static int _is_primed(void) {
+    return !isRewindPending && !isHalfFree[0] && !isHalfFree[1];
+}
+
+int open_music(const char *name) {
+    const PakEntry *entry = find_pak_entry(name);
+    CdLoadRequest req;
+
+    if(entry == NULL)
+        return 0;
+
+    if(entry->flags & PAK_FLAG_LZ) {
+        printf("Error: %s must be stored uncompressed to be streamed.\n", name);
+        return 0;
+    }
+
+    // The header has the size and sample rate
+    init_cd_request(&req, NULL);
+    req.lba = get_pak_entry_lba(entry);
+    req.size = CD_SECTOR_SIZE;
+    req.buffer = (char*)staging;
+
+    queue_cd_load(&req);
+    wait_cd_load(&req);
+
+    if(req.status != CD_LOAD_DONE)
+        return 0;
+
+    VAG_Header *header = (VAG_Header*)staging;
+    dataSize = SWAP_ENDIAN_32(header->size);
+    sampleRate = SWAP_ENDIAN_32(header->sample_rate);
+    playRate = sampleRate;
+
+    if(dataSize > (int)entry->size - VAG_HEADER_SIZE)
+        dataSize = entry->size - VAG_HEADER_SIZE;
+    dataSize &= ~(ADPCM_BLOCK_SIZE - 1);
+
+    if(dataSize <= 0) {
+        printf("Error: %s is not a valid VAG.\n", name);
+        return 0;
+    }
+
+    if(ringAddr == 0) {
+        ringAddr = alloc_spu_ram(MUSIC_RING_SIZE);
+        if(ringAddr == 0)
+            return 0;
+
+        // play_sample would otherwise hand the voice out to sound effects
+        reserve_voice(MUSIC_CHANNEL);
+
+        EnterCriticalSection();
+        InterruptCallback(IRQ_SPU, &_music_irq);
+        ExitCriticalSection();
+    }
+
+    musicEntry = entry;
+    isPlaying = 0;
+    isRewindPending = 1;
+
+    return 1;
+}
+
+void play_music(const int volume) {
+    if(musicEntry == NULL)
+        return;
+
+    if(isPlaying)
+        stop_music();
+
+    // Normally primed long ago, while the menus were up
+    while(!_is_primed()) {
+        update_cd_loader();
+        update_music();
+    }
+
+    SpuSetKey(0, 1 << MUSIC_CHANNEL);
+
+    playRate = sampleRate;
+    SPU_CH_FREQ(MUSIC_CHANNEL) = getSPUSampleRate(sampleRate);
+    SPU_CH_ADDR(MUSIC_CHANNEL) = getSPUAddr(ringAddr);
+    SPU_CH_LOOP_ADDR(MUSIC_CHANNEL) = getSPUAddr(ringAddr);
+
+    SPU_CH_VOL_L(MUSIC_CHANNEL) = volume;
+    SPU_CH_VOL_R(MUSIC_CHANNEL) = volume;
+    SPU_CH_ADSR1(MUSIC_CHANNEL) = 0x00ff;
+    SPU_CH_ADSR2(MUSIC_CHANNEL) = 0x0000;
+
+    // The voice starts in the first half, wait for it to reach the second
+    irqHalf = 1;
+    SPU_IRQ_ADDR = getSPUAddr(ringAddr + MUSIC_HALF_SIZE);
+    SPU_CTRL |= SPU_CTRL_IRQ_ENABLE;
+
+    isPlaying = 1;
+    SpuSetKey(1, 1 << MUSIC_CHANNEL);
+}
+
+void stop_music(void) {
+    SpuSetKey(0, 1 << MUSIC_CHANNEL);
+    SPU_CTRL &= ~SPU_CTRL_IRQ_ENABLE;
+
+    isPlaying = 0;
+    isRewindPending = 1;
+}
+
+void set_music_volume(const int volume) {
+    SPU_CH_VOL_L(MUSIC_CHANNEL) = volume;
+    SPU_CH_VOL_R(MUSIC_CHANNEL) = volume;
+}
+
+void set_music_speed(const int speed) {
+    int freq = getSPUSampleRate(MulFixed(sampleRate, speed));
+
+    if(freq > SPU_MAX_PITCH)
+        freq = SPU_MAX_PITCH;
+
+    playRate = MulFixed(sampleRate, speed);
+    SPU_CH_FREQ(MUSIC_CHANNEL) = freq;
+}
+
+void get_music_stats(MusicStats *stats) {
+    stats->underruns = numUnderruns;
+    stats->maxRefillUs = maxRefillUs;
+    stats->halfUs = (playRate > 0) ? (SAMPLES_PER_HALF * 1000 / playRate) * 1000 : 0;
+}
+
+void update_music(void) {
+    if(musicEntry == NULL)
+        return;
+
+    if(musicReq.status == CD_LOAD_QUEUED || musicReq.status == CD_LOAD_READING)
+        return;
+
+    // Refill the whole ring from the start of the song
+    if(isRewindPending) {
+        isRewindPending = 0;
+        isHalfFree[0] = 1;
+        isHalfFree[1] = 1;
+        fillHalf = -1;
+        readPos = 0;
+    }
+
+    if(fillHalf < 0) {
+        if(isHalfFree[0])
+            fillHalf = 0;
+        else if(isHalfFree[1])
+            fillHalf = 1;
+        else
+            return;
+
+        staged = 0;
+    }
+
+    // A half can take a couple of reads when the song wraps in it, or
+    // when a read fails part way
+    if(staged < MUSIC_HALF_SIZE) {
+        _queue_read();
+        return;
+    }
+
+    _upload_half(fillHalf);
+    isHalfFree[fillHalf] = 0;
+
+    // Only halves the voice freed count, not the ring priming
+    if(isPlaying) {
+        int refill = get_system_time_us() - freeTime[fillHalf];
+        if(refill > maxRefillUs)
+            maxRefillUs = refill;
+    }
+
+    fillHalf = -1;
+}
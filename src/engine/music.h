@@ -0,0 +1,116 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <stdint.h>
+#include "audio.h"
+#include "pak.h"
+#include "fpmath.h"
+
+// Background music. How it is played is picked at build time by the
+// TETRADE_MUSIC CMake option, which sets MUSIC_MODE:
+//
+//  MUSIC_MODE_SPU   music.c streams a VAG from the archive through a small
+//                   ring in SPU RAM, so a song only costs MUSIC_RING_SIZE
+//                   bytes of SPU RAM however long it is.
+//  MUSIC_MODE_CDDA  cdmusic.c plays Red Book audio tracks.
+//  MUSIC_MODE_XA    cdmusic.c plays an interleaved XA-ADPCM file.
+//  MUSIC_MODE_SEQ   seqmusic.c plays a score from the archive on a few
+//                   voices with tiny looped instruments, a few KB of SPU
+//                   RAM in all.
+//
+// The CD modes play through the drive's own audio path, with no SPU RAM and
+// next to no CPU time, but the drive can't read data while music plays.
+// Speeding the music up switches between tempo variants pre-rendered by
+// tools/mkmusic.py instead of changing a voice's sample rate.
+//
+// Sequenced music changes tempo without changing pitch, at any speed.
+
+#define MUSIC_MODE_SPU  0
+#define MUSIC_MODE_CDDA 1
+#define MUSIC_MODE_XA   2
+#define MUSIC_MODE_SEQ  3
+
+#ifndef MUSIC_MODE
+#define MUSIC_MODE MUSIC_MODE_SPU
+#endif
+
+// SPU mode: the ring is split in two halves that MUSIC_CHANNEL plays in a
+// loop. An SPU IRQ fires when the voice crosses into a half, marking the
+// other one free, and update_music refills it from the disc. The song wraps
+// back to its start seamlessly when the end of the file is reached.
+
+// A half is refilled while the voice plays the other one, so it has to
+// last through the slowest refill: up to a frame before update_music sees
+// the IRQ, a full seek back to the song (~400 ms worst case), and reading
+// the half at 2x speed (~110 ms for 16 sectors). 16 sectors are 57344
+// samples, 650 ms at MUSIC_MAX_SPEED's 88 kHz and 2.6 s at the song's own
+// 22 kHz. get_music_stats reports how close it came.
+#define MUSIC_HALF_SIZE (CD_SECTOR_SIZE*16)
+#define MUSIC_RING_SIZE (MUSIC_HALF_SIZE*2)
+
+// SPU mode: underruns replay a half left over from the last lap, so they
+// are counted rather than heard as silence
+typedef struct _MusicStats {
+    int underruns;      // Times the voice entered a half not yet refilled
+    int maxRefillUs;    // Longest a half took to refill once freed
+    int halfUs;         // How long a half plays at the current speed
+} MusicStats;
+
+// CD-DA mode: variants are the audio tracks from this one on
+#define MUSIC_FIRST_TRACK 2
+
+// SEQ mode: a song's channels play on the voices from MUSIC_CHANNEL on
+#define SEQ_MAX_CHANNELS    8
+#define SEQ_MAX_INSTRUMENTS 8
+
+// Gets the song ready to play, returns 0 on failure. name is an archive
+// entry stored uncompressed in SPU mode, e.g. "THEME.VAG", an entry built
+// by tools/mkseq.py in SEQ mode, e.g. "THEME.SEQ", and a file on the disc
+// in XA mode, e.g. "\\THEME.XA;1". CD-DA mode reads the track list and
+// ignores it.
+int open_music(const char *name);
+
+// Starts the song from the beginning at its own speed. In SPU mode this
+// blocks if the ring is still priming, in the CD modes until the loader is
+// done with the drive.
+void play_music(const int volume);
+
+// Stops the song, in SPU mode also starts priming the ring again
+void stop_music(void);
+
+void set_music_volume(const int volume);
+
+// Plays the song speed times as fast, FIXED_ONE being its own speed. The
+// SPU stream raises the voice's sample rate, up to the SPU's limit of 4x.
+// The CD modes switch to the variant rendered closest and carry on from
+// the same point in the song. SEQ mode scales the tempo.
+void set_music_speed(const int speed);
+
+// SPU mode only
+void get_music_stats(MusicStats *stats);
+
+// Refills the ring in SPU mode, loops the song in the CD modes, plays the
+// rows that are due in SEQ mode. Call once a frame with update_cd_loader.
+void update_music(void);
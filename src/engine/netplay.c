@@ -0,0 +1,369 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "netplay.h"
+#include <string.h>
+#include <stdio.h>
+#include "timer.h"
+
+#define PACKET_MAGIC    0xa5
+#define PACKET_HELLO    1
+#define PACKET_INPUT    2
+
+#define PACKET_MAX_PAYLOAD 64
+#define PACKET_OVERHEAD    4   // Magic, type, length, checksum
+
+// Inputs kept per player, a power of 2 well past what can be unconfirmed
+#define INPUT_RING 64
+#define INPUT_MAX_SEND 16
+
+#define HELLO_INTERVAL 8    // Frames between hellos while connecting
+
+typedef struct _Packet {
+    uint8_t type;
+    uint8_t length;
+    uint8_t payload[PACKET_MAX_PAYLOAD];
+} Packet;
+
+static NetplayState state = NETPLAY_OFF;
+static const NetplayCallbacks *cb;
+
+static uint8_t localHello[NETPLAY_HELLO_LEN];
+static uint8_t peerHello[NETPLAY_HELLO_LEN];
+static uint32_t localNonce, peerNonce;
+static int hasPeerHello, peerHasHello;
+
+static int player;
+static uint16_t inputs[NETPLAY_PLAYERS][INPUT_RING];
+
+static int frame;           // Next frame to step
+static int localLast;       // Last frame with this console's input
+static int remoteLast;      // Last frame with the other console's real input
+static int peerAck;         // Last of our frames the other console has
+static int rollbackTo;      // Earliest frame stepped on a wrong guess
+
+static uint32_t lastPacketTime;
+static int connectFrames;
+
+// Packet being received
+static Packet rxPacket;
+static int rxPos;
+
+static NetplayStats stats;
+
+static uint32_t _read_u32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void _write_u32(uint8_t *p, const uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static uint8_t _checksum(const Packet *packet) {
+    uint8_t sum = packet->type + packet->length;
+
+    for(int i = 0; i < packet->length; i++)
+        sum = (sum << 1 | sum >> 7) + packet->payload[i];
+
+    return sum;
+}
+
+static void _send(Packet *packet) {
+    uint8_t header[3] = { PACKET_MAGIC, packet->type, packet->length };
+    uint8_t sum = _checksum(packet);
+
+    serial_write(header, sizeof(header));
+    serial_write(packet->payload, packet->length);
+    serial_write(&sum, 1);
+}
+
+static void _send_hello(void) {
+    Packet packet;
+
+    packet.type = PACKET_HELLO;
+    packet.length = 5 + NETPLAY_HELLO_LEN;
+    _write_u32(&packet.payload[0], localNonce);
+    packet.payload[4] = hasPeerHello;
+    memcpy(&packet.payload[5], localHello, NETPLAY_HELLO_LEN);
+
+    _send(&packet);
+}
+
+// Every input of ours the other console hasn't acknowledged, up to
+// INPUT_MAX_SEND. Sending them again until they are means a lost packet
+// costs nothing but a rollback.
+static void _send_inputs(void) {
+    Packet packet;
+    int start = peerAck + 1;
+
+    if(localLast - start >= INPUT_MAX_SEND)
+        start = localLast - INPUT_MAX_SEND + 1;
+
+    int count = localLast - start + 1;
+
+    packet.type = PACKET_INPUT;
+    packet.length = 9 + 2*count;
+    _write_u32(&packet.payload[0], remoteLast);
+    _write_u32(&packet.payload[4], start);
+    packet.payload[8] = count;
+
+    for(int i = 0; i < count; i++) {
+        uint16_t held = inputs[player][(start + i) & (INPUT_RING-1)];
+        packet.payload[9 + 2*i] = held;
+        packet.payload[10 + 2*i] = held >> 8;
+    }
+
+    _send(&packet);
+}
+
+static void _receive_hello(const Packet *packet) {
+    if(packet->length != 5 + NETPLAY_HELLO_LEN)
+        return;
+
+    peerNonce = _read_u32(&packet->payload[0]);
+    peerHasHello = packet->payload[4];
+    memcpy(peerHello, &packet->payload[5], NETPLAY_HELLO_LEN);
+    hasPeerHello = 1;
+
+    // Both picked the same number, try again with new ones
+    if(peerNonce == localNonce) {
+        localNonce = localNonce * 1664525 + 1013904223 + get_system_time_us();
+        hasPeerHello = 0;
+    }
+}
+
+static void _receive_inputs(const Packet *packet) {
+    int remote = !player;
+    int ack = (int)_read_u32(&packet->payload[0]);
+    int start = (int)_read_u32(&packet->payload[4]);
+    int count = packet->payload[8];
+
+    if(packet->length != 9 + 2*count)
+        return;
+
+    if(ack > peerAck)
+        peerAck = ack;
+
+    for(int i = 0; i < count; i++) {
+        int f = start + i;
+        uint16_t held = packet->payload[9 + 2*i] | (packet->payload[10 + 2*i] << 8);
+
+        // Only the next one in order, repeats and gaps are skipped
+        if(f != remoteLast + 1)
+            continue;
+
+        uint16_t *slot = &inputs[remote][f & (INPUT_RING-1)];
+
+        // Already stepped with a guess, and the guess was wrong
+        if(f < frame && *slot != held && f < rollbackTo)
+            rollbackTo = f;
+
+        *slot = held;
+        remoteLast = f;
+    }
+}
+
+static void _receive_packets(void) {
+    uint8_t byte;
+
+    while(serial_read(&byte, 1)) {
+        // Magic, type, length, payload, checksum
+        if(rxPos == 0) {
+            if(byte == PACKET_MAGIC)
+                rxPos = 1;
+            continue;
+        } else if(rxPos == 1) {
+            rxPacket.type = byte;
+        } else if(rxPos == 2) {
+            rxPacket.length = byte;
+            if(byte > PACKET_MAX_PAYLOAD) {
+                stats.badPackets++;
+                rxPos = 0;
+                continue;
+            }
+        } else if(rxPos - 3 < rxPacket.length) {
+            rxPacket.payload[rxPos - 3] = byte;
+        } else {
+            rxPos = 0;
+
+            if(byte != _checksum(&rxPacket)) {
+                stats.badPackets++;
+                continue;
+            }
+
+            lastPacketTime = get_system_time();
+
+            if(rxPacket.type == PACKET_HELLO) {
+                if(state == NETPLAY_CONNECTING)
+                    _receive_hello(&rxPacket);
+            } else if(rxPacket.type == PACKET_INPUT) {
+                // The other console is running, so it has our hello
+                if(state == NETPLAY_CONNECTING && hasPeerHello)
+                    peerHasHello = 1;
+                if(state == NETPLAY_RUNNING)
+                    _receive_inputs(&rxPacket);
+            }
+            continue;
+        }
+
+        rxPos++;
+    }
+}
+
+static void _step(const int f, const int isReplay) {
+    uint16_t now[NETPLAY_PLAYERS], last[NETPLAY_PLAYERS];
+
+    for(int p = 0; p < NETPLAY_PLAYERS; p++) {
+        now[p] = inputs[p][f & (INPUT_RING-1)];
+        last[p] = (f > 0) ? inputs[p][(f - 1) & (INPUT_RING-1)] : 0;
+    }
+
+    cb->save(f % NETPLAY_SAVE_SLOTS);
+    cb->step(now, last, isReplay);
+}
+
+static void _begin_match(void) {
+    state = NETPLAY_RUNNING;
+    player = (localNonce > peerNonce) ? 0 : 1;
+
+    memset(inputs, 0, sizeof(inputs));
+
+    // Nobody has input for the first frames, they are confirmed as nothing
+    frame = 0;
+    localLast = NETPLAY_INPUT_DELAY - 1;
+    remoteLast = NETPLAY_INPUT_DELAY - 1;
+    peerAck = NETPLAY_INPUT_DELAY - 1;
+    rollbackTo = INT32_MAX;
+
+    cb->start(localNonce ^ peerNonce, player, peerHello);
+}
+
+static void _update_connecting(void) {
+    if(hasPeerHello && peerHasHello) {
+        _begin_match();
+        return;
+    }
+
+    if(connectFrames++ % HELLO_INTERVAL == 0)
+        _send_hello();
+}
+
+static void _update_running(const uint16_t held) {
+    int remote = !player;
+
+    // Replay from the first wrong guess with the real input
+    if(rollbackTo < frame) {
+        int f = rollbackTo;
+
+        cb->load(f % NETPLAY_SAVE_SLOTS);
+        for(; f < frame; f++) {
+            // Past what has arrived, keep guessing they held the same
+            if(f > remoteLast)
+                inputs[remote][f & (INPUT_RING-1)] = inputs[remote][remoteLast & (INPUT_RING-1)];
+            _step(f, 1);
+        }
+
+        stats.rollback = frame - rollbackTo;
+        if(stats.rollback > stats.maxRollback)
+            stats.maxRollback = stats.rollback;
+    }
+    rollbackTo = INT32_MAX;
+
+    // Too far ahead of the other player to roll back, wait for them
+    if(frame - remoteLast > NETPLAY_MAX_ROLLBACK) {
+        stats.stalls++;
+        _send_inputs();
+        return;
+    }
+
+    localLast = frame + NETPLAY_INPUT_DELAY;
+    inputs[player][localLast & (INPUT_RING-1)] = held;
+
+    if(frame > remoteLast)
+        inputs[remote][frame & (INPUT_RING-1)] = inputs[remote][remoteLast & (INPUT_RING-1)];
+
+    _step(frame, 0);
+    frame++;
+
+    _send_inputs();
+}
+
+void start_netplay(const NetplayCallbacks *callbacks, const uint8_t hello[NETPLAY_HELLO_LEN]) {
+    init_serial(SERIAL_BAUD);
+
+    cb = callbacks;
+    memcpy(localHello, hello, NETPLAY_HELLO_LEN);
+    memset(&stats, 0, sizeof(stats));
+
+    localNonce = get_system_time_us() * 2654435761u;
+    hasPeerHello = 0;
+    peerHasHello = 0;
+    connectFrames = 0;
+    rxPos = 0;
+    lastPacketTime = get_system_time();
+
+    state = NETPLAY_CONNECTING;
+}
+
+void stop_netplay(void) {
+    if(state == NETPLAY_OFF)
+        return;
+
+    close_serial();
+    state = NETPLAY_OFF;
+}
+
+NetplayState update_netplay(const uint16_t held) {
+    uint32_t start = get_system_time_us();
+
+    stats.rollback = 0;
+
+    if(state == NETPLAY_OFF || state == NETPLAY_LOST)
+        return state;
+
+    _receive_packets();
+
+    if(state == NETPLAY_CONNECTING) {
+        // Wait as long as it takes for the other console to turn up
+        lastPacketTime = get_system_time();
+        _update_connecting();
+    } else {
+        _update_running(held);
+
+        if(get_system_time() - lastPacketTime > NETPLAY_TIMEOUT_MS) {
+            printf("Netplay: link lost at frame %d\n", frame);
+            state = NETPLAY_LOST;
+        }
+    }
+
+    stats.frame = frame;
+    stats.confirmed = remoteLast;
+    stats.updateUs = (int)(get_system_time_us() - start);
+    return state;
+}
+
+void get_netplay_stats(NetplayStats *out) {
+    *out = stats;
+}
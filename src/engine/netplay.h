@@ -0,0 +1,97 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include "serial.h"
+
+// Two player lockstep over the link cable with input delay and rollback.
+//
+// Each console sends its pad a few frames ahead (NETPLAY_INPUT_DELAY) and
+// steps the game as soon as it has its own input, guessing the other
+// player's as whatever they last held. When the real input turns up and
+// the guess was wrong, the game is loaded back to that frame and stepped
+// again up to the present. The game only has to be deterministic given the
+// inputs and the seed both consoles agree on, and able to save and load
+// its state.
+//
+// Frames are only stepped ahead of the other player's last input by up to
+// NETPLAY_MAX_ROLLBACK, after that this console waits for them.
+
+#define NETPLAY_PLAYERS 2
+#define NETPLAY_INPUT_DELAY 2
+#define NETPLAY_MAX_ROLLBACK 8
+
+// Slots of saved state the game needs, one per frame that can be rolled back
+#define NETPLAY_SAVE_SLOTS (NETPLAY_MAX_ROLLBACK + 2)
+
+// Bytes of game data swapped when connecting, e.g. settings
+#define NETPLAY_HELLO_LEN 16
+
+// The other console is gone after this long without a packet
+#define NETPLAY_TIMEOUT_MS 3000
+
+typedef enum _NetplayState {
+    NETPLAY_OFF         = 0,
+    NETPLAY_CONNECTING  = 1,
+    NETPLAY_RUNNING     = 2,
+    NETPLAY_LOST        = 3
+} NetplayState;
+
+typedef struct _NetplayCallbacks {
+    // The link is up, set up the match from the shared seed. player is
+    // this console's index in inputs, peerHello what the other one sent.
+    void (*start)(const uint32_t seed, const int player, const uint8_t *peerHello);
+
+    // Save or load the state before a frame to or from a slot
+    void (*save)(const int slot);
+    void (*load)(const int slot);
+
+    // Step one frame. lastInputs is what was held the frame before, so
+    // pressed and released can be worked out when replaying. isReplay is
+    // set when the frame was stepped before, e.g. its sounds have played.
+    void (*step)(const uint16_t inputs[NETPLAY_PLAYERS], const uint16_t lastInputs[NETPLAY_PLAYERS],
+        const int isReplay);
+} NetplayCallbacks;
+
+typedef struct _NetplayStats {
+    int frame;          // Frames stepped for real
+    int confirmed;      // Last frame with the other player's real input
+    int rollback;       // Frames stepped again last update
+    int maxRollback;
+    int stalls;         // Updates spent waiting on the other console
+    int badPackets;
+    int updateUs;       // Time the last update took, steps included
+} NetplayStats;
+
+// Opens the serial port and starts looking for the other console
+void start_netplay(const NetplayCallbacks *callbacks, const uint8_t hello[NETPLAY_HELLO_LEN]);
+void stop_netplay(void);
+
+// Call once a frame with this console's pad. Connects, sends and receives
+// inputs, and steps the game through the callbacks, rolling back when a
+// guess was wrong. Once running the game should only be drawn, not
+// stepped, outside of the step callback.
+NetplayState update_netplay(const uint16_t held);
+
+void get_netplay_stats(NetplayStats *stats);
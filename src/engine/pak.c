@@ -0,0 +1,475 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "pak.h"
+#include <stdio.h>
+#include <string.h>
+#include "timer.h"
+#include "arena.h"
+
+static int pakLba = -1;
+static uint32_t pakToc[CD_SECTOR_SIZE/4];
+
+static PakHeader *pakHeader = (PakHeader*)pakToc;
+static PakEntry *pakEntries = (PakEntry*)((PakHeader*)pakToc + 1);
+
+static int _num_sectors(const int size) {
+    return (size + CD_SECTOR_SIZE - 1) / CD_SECTOR_SIZE;
+}
+
+uint32_t hash_pak_name(const char *name) {
+    uint32_t hash = 2166136261u;
+
+    for(; *name; name++) {
+        char c = *name;
+        if(c >= 'a' && c <= 'z') c -= 'a' - 'A';
+
+        hash = (hash ^ (uint8_t)c) * 16777619u;
+    }
+
+    return hash;
+}
+
+int open_pak(const char *filename) {
+    CdlFILE filePos;
+    CdLoadRequest req;
+
+    // The only directory lookup, every asset is found through the TOC
+    if(CdSearchFile(&filePos, filename) == NULL) {
+        printf("file: %s not found.\n", filename);
+        return 0;
+    }
+
+    init_cd_request(&req, NULL);
+    req.lba = CdPosToInt(&filePos.pos);
+    req.size = CD_SECTOR_SIZE;
+    req.buffer = (char*)pakToc;
+
+    queue_cd_load(&req);
+    wait_cd_load(&req);
+
+    if(req.status != CD_LOAD_DONE) {
+        return 0;
+    }
+
+    if(pakHeader->magic != PAK_MAGIC || pakHeader->version != PAK_VERSION) {
+        printf("Error: %s is not a valid archive.\n", filename);
+        return 0;
+    }
+
+    pakLba = req.lba;
+    return 1;
+}
+
+const PakEntry *find_pak_entry(const char *name) {
+    uint32_t hash = hash_pak_name(name);
+
+    for(int i = 0; i < pakHeader->numEntries; i++) {
+        if(pakEntries[i].hash == hash)
+            return &pakEntries[i];
+    }
+
+    printf("Error: %s not found in archive.\n", name);
+    return NULL;
+}
+
+int get_pak_entry_lba(const PakEntry *entry) {
+    return pakLba + entry->sector;
+}
+
+static int _is_compressed(const PakEntry *entry) {
+    return (entry->flags & PAK_FLAG_LZ) != 0;
+}
+
+// Offset of the stored data in a compressed load buffer. It sits at the end
+// so it can be decoded in place, rounded up to a word for the CD DMA.
+static int _stored_offset(const PakEntry *entry) {
+    return (LZ_INPLACE_SIZE(entry->rawSize, entry->size) - entry->size + 3) & ~3;
+}
+
+// Load buffers come from the scene arena. Entries are read one after the
+// other, so each one is given back before the next is taken, unless it is
+// kept as a PAK_RAW file.
+static char *_alloc_load_buffer(const PakEntry *entry) {
+    if(_is_compressed(entry))
+        return (char*)alloc_arena(&sceneArena, _stored_offset(entry) + entry->size);
+
+    return (char*)alloc_arena(&sceneArena, entry->size);
+}
+
+// Textures go from the sectors to VRAM, through a block of staging when
+// they are compressed
+static int _is_streamed(const PakLoad *load) {
+    return load->type == PAK_TIM;
+}
+
+// Where the stored data goes in the load buffer
+static char *_stored_data(const PakLoad *load) {
+    if(_is_compressed(load->entry))
+        return load->buffer + _stored_offset(load->entry);
+
+    return load->buffer;
+}
+
+// A compressed texture's blocks are staged one at a time. Entries are
+// streamed one after the other, so one stage does for all of them.
+#define LZ_STAGE_SIZE LZ_INPLACE_SIZE(PAK_LZ_BLOCK_SIZE, PAK_LZ_BLOCK_SIZE)
+
+static uint8_t *lzStage = NULL;
+static int lzHeaderBytes;
+static int lzBlockHeader;
+static int lzStaged;
+static int lzDecoded;   // Raw bytes of the entry uploaded so far
+static int isLzCorrupt;
+
+static void _begin_lz_stream(void) {
+    lzStage = (uint8_t*)alloc_arena(&sceneArena, LZ_STAGE_SIZE);
+    lzHeaderBytes = 0;
+    lzBlockHeader = 0;
+    lzDecoded = 0;
+    isLzCorrupt = (lzStage == NULL);
+}
+
+static void _end_lz_stream(void) {
+    free_arena_to(&sceneArena, lzStage);
+    lzStage = NULL;
+}
+
+static void _stream_lz_tim(PakLoad *load, const uint8_t *data, int len) {
+    const int rawSize = load->entry->rawSize;
+
+    while(len > 0 && !isLzCorrupt) {
+        // Each block starts with its u16 size, which can straddle sectors
+        if(lzHeaderBytes < 2) {
+            lzBlockHeader |= *data++ << (8 * lzHeaderBytes++);
+            lzStaged = 0;
+            len--;
+            continue;
+        }
+
+        int size = lzBlockHeader & ~PAK_LZ_BLOCK_STORED;
+        int raw = rawSize - lzDecoded;
+        if(raw > PAK_LZ_BLOCK_SIZE) raw = PAK_LZ_BLOCK_SIZE;
+
+        if(size > PAK_LZ_BLOCK_SIZE || ((lzBlockHeader & PAK_LZ_BLOCK_STORED) && size != raw)) {
+            isLzCorrupt = 1;
+            break;
+        }
+
+        // Staged at the end of the block's in place buffer
+        uint8_t *src = lzStage + LZ_INPLACE_SIZE(raw, size) - size;
+
+        int n = size - lzStaged;
+        if(n > len) n = len;
+
+        memcpy(src + lzStaged, data, n);
+        lzStaged += n;
+        data += n;
+        len -= n;
+
+        if(lzStaged < size)
+            break;
+
+        if(lzBlockHeader & PAK_LZ_BLOCK_STORED) {
+            stream_tim_bytes((TimStream*)load->dest, src, raw);
+        } else if(decompress_lz(lzStage, raw, src, size) == raw) {
+            stream_tim_bytes((TimStream*)load->dest, lzStage, raw);
+        } else {
+            isLzCorrupt = 1;
+            break;
+        }
+
+        // The stage is reused by the next block
+        DrawSync(0);
+
+        lzDecoded += raw;
+        lzHeaderBytes = 0;
+        lzBlockHeader = 0;
+    }
+}
+
+static void _pak_load_data(PakLoad *load, const uint8_t *data, const int offset, const int len) {
+    if(_is_streamed(load)) {
+        TimStream *stream = (TimStream*)load->dest;
+
+        if(offset == 0) {
+            init_tim_stream(stream);
+
+            if(_is_compressed(load->entry))
+                _begin_lz_stream();
+        }
+
+        if(_is_compressed(load->entry)) {
+            _stream_lz_tim(load, data, len);
+            return;
+        }
+
+        stream_tim_bytes(stream, data, len);
+
+        // The sector buffer is reused once we return
+        DrawSync(0);
+        return;
+    }
+
+    if(offset == 0)
+        load->buffer = _alloc_load_buffer(load->entry);
+
+    // Out of memory, already reported
+    if(load->buffer == NULL)
+        return;
+
+    memcpy(_stored_data(load) + offset, data, len);
+}
+
+static int _pak_decompress(PakLoad *load) {
+    const PakEntry *entry = load->entry;
+
+    if(!_is_compressed(entry))
+        return 1;
+
+    int len = decompress_lz((uint8_t*)load->buffer, entry->rawSize, (const uint8_t*)_stored_data(load), entry->size);
+
+    if(len != (int)entry->rawSize) {
+        printf("Error: %s is corrupt.\n", load->name);
+        return 0;
+    }
+
+    return 1;
+}
+
+// Passes a fully loaded and decoded asset on to wherever it lives
+static void _pak_hand_over(PakLoad *load) {
+    switch(load->type) {
+        case PAK_TIM: {
+            TimStream *stream = (TimStream*)load->dest;
+
+            if(stream->state != TIM_STREAM_DONE)
+                printf("Error: %s is not a valid TIM.\n", load->name);
+            break;
+        }
+        case PAK_VAG: {
+            AudioSample *sample = (AudioSample*)load->dest;
+            init_sample_byte(sample, (const uint8_t*)load->buffer);
+
+            // Only SPU RAM holds the sample from here on
+            sample->header = NULL;
+            free_arena_to(&sceneArena, load->buffer);
+            load->buffer = NULL;
+            break;
+        }
+        default:
+            *((char**)load->dest) = load->buffer;
+            break;
+    }
+}
+
+static void _pak_load_done(PakLoad *load) {
+    if(_is_streamed(load)) {
+        if(_is_compressed(load->entry)) {
+            if(isLzCorrupt)
+                printf("Error: %s is corrupt.\n", load->name);
+            _end_lz_stream();
+        }
+
+        _pak_hand_over(load);
+        return;
+    }
+
+    if(load->buffer == NULL)
+        return;
+
+    if(!_pak_decompress(load)) {
+        free_arena_to(&sceneArena, load->buffer);
+        load->buffer = NULL;
+        return;
+    }
+
+    _pak_hand_over(load);
+}
+
+static void _pak_scene_sector(CdLoadRequest *req, const uint32_t *sector, const int index) {
+    PakScene *scene = (PakScene*)req->userData;
+    const int sectorNum = scene->firstSector + index;
+
+    // Entries never share a sector, so at most one load wants this one.
+    // Sectors of entries that are not part of the scene are skipped.
+    for(int i = 0; i < scene->numLoads; i++) {
+        PakLoad *load = &(scene->loads[i]);
+        const PakEntry *entry = load->entry;
+
+        if(entry == NULL || sectorNum < entry->sector || 
+            sectorNum >= entry->sector + _num_sectors(entry->size)) {
+            continue;
+        }
+
+        int offset = (sectorNum - entry->sector) * CD_SECTOR_SIZE;
+        int len = entry->size - offset;
+        if(len > CD_SECTOR_SIZE) len = CD_SECTOR_SIZE;
+
+        _pak_load_data(load, (const uint8_t*)sector, offset, len);
+
+        if(offset + len >= entry->size)
+            _pak_load_done(load);
+
+        break;
+    }
+}
+
+void queue_pak_scene(PakScene *scene, PakLoad *loads, const int numLoads, CdLoadCallback onComplete) {
+    int first = -1;
+    int last = -1;
+
+    scene->loads = loads;
+    scene->numLoads = numLoads;
+
+    // Find the span of sectors covering every asset in the scene
+    for(int i = 0; i < numLoads; i++) {
+        const PakEntry *entry = find_pak_entry(loads[i].name);
+        loads[i].entry = entry;
+        loads[i].buffer = NULL;
+
+        if(entry == NULL)
+            continue;
+
+        int end = entry->sector + _num_sectors(entry->size);
+
+        if(first < 0 || (int)entry->sector < first) first = entry->sector;
+        if(end > last) last = end;
+    }
+
+    init_cd_request(&(scene->req), NULL);
+    scene->req.onSector = &_pak_scene_sector;
+    scene->req.onComplete = onComplete;
+    scene->req.userData = scene;
+
+    if(first < 0) {
+        // Nothing to read, still report completion through the loader
+        first = last = 0;
+    }
+
+    scene->firstSector = first;
+    scene->req.lba = pakLba + first;
+    scene->req.size = (last - first) * CD_SECTOR_SIZE;
+
+    queue_cd_load(&(scene->req));
+}
+
+void load_pak_scene(PakLoad *loads, const int numLoads) {
+    PakScene scene;
+
+    queue_pak_scene(&scene, loads, numLoads, NULL);
+    wait_cd_load(&(scene.req));
+}
+
+void add_pak_samples_to_bank(SampleBank *bank, const PakLoad *loads, const int numLoads) {
+    for(int i = 0; i < numLoads; i++) {
+        if(loads[i].type == PAK_VAG && is_sample_resident((AudioSample*)loads[i].dest))
+            add_to_sample_bank(bank, (AudioSample*)loads[i].dest);
+    }
+}
+
+void bench_pak_scene(PakLoad *loads, const int numLoads) {
+    uint32_t totalRaw = 0;
+    uint32_t totalRead = 0;
+    uint32_t totalDecompress = 0;
+
+    printf("asset           raw  stored  2x raw us  read us  unpack us\n");
+
+    for(int i = 0; i < numLoads; i++) {
+        PakLoad *load = &loads[i];
+        const PakEntry *entry = find_pak_entry(load->name);
+        CdLoadRequest req;
+
+        load->entry = entry;
+        load->buffer = NULL;
+
+        if(entry == NULL)
+            continue;
+
+        // The drive writes whole sectors, leave room for the last one.
+        // Textures are read into a scratch buffer and fed through the
+        // streaming path a sector at a time, so their unpack time includes
+        // the VRAM upload. Everything else is read where it is decoded.
+        int storedOffset = (!_is_streamed(load) && _is_compressed(entry)) ? _stored_offset(entry) : 0;
+        char *stored = (char*)alloc_arena(&sceneArena, storedOffset + _num_sectors(entry->size) * CD_SECTOR_SIZE);
+        if(stored == NULL)
+            continue;
+
+        init_cd_request(&req, NULL);
+        req.lba = pakLba + entry->sector;
+        req.size = entry->size;
+        req.buffer = stored + storedOffset;
+
+        uint32_t start = get_system_time_us();
+        queue_cd_load(&req);
+        wait_cd_load(&req);
+        uint32_t read = get_system_time_us() - start;
+
+        if(req.status != CD_LOAD_DONE) {
+            free_arena_to(&sceneArena, stored);
+            continue;
+        }
+
+        int ok = 1;
+        start = get_system_time_us();
+
+        if(_is_streamed(load)) {
+            for(int offset = 0; offset < (int)entry->size; offset += CD_SECTOR_SIZE) {
+                int len = entry->size - offset;
+                if(len > CD_SECTOR_SIZE) len = CD_SECTOR_SIZE;
+
+                _pak_load_data(load, (const uint8_t*)stored + offset, offset, len);
+            }
+            _pak_load_done(load);
+        } else {
+            load->buffer = stored;
+            ok = _pak_decompress(load);
+        }
+
+        uint32_t decompress = get_system_time_us() - start;
+
+        if(_is_streamed(load))
+            free_arena_to(&sceneArena, stored);
+
+        if(!ok) {
+            free_arena_to(&sceneArena, load->buffer);
+            load->buffer = NULL;
+            continue;
+        }
+
+        // 2x speed streams 150 sectors a second, seek time not included
+        uint32_t rawRead = _num_sectors(entry->rawSize) * 1000000 / 150;
+
+        printf("%-12s %6d %7d %10d %8d %10d\n", load->name, (int)entry->rawSize, 
+            (int)entry->size, (int)rawRead, (int)read, (int)decompress);
+
+        totalRaw += rawRead;
+        totalRead += read;
+        totalDecompress += decompress;
+
+        if(!_is_streamed(load))
+            _pak_hand_over(load);
+    }
+
+    printf("total: 2x raw %d us, read %d us + unpack %d us = %d us\n", (int)totalRaw, 
+        (int)totalRead, (int)totalDecompress, (int)(totalRead + totalDecompress));
+}
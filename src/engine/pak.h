@@ -0,0 +1,123 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include "cdload.h"
+#include "graphics2d.h"
+#include "audio.h"
+#include "lz.h"
+
+// Packed asset archive, built by tools/mkpak.py from assets.txt.
+//
+// Sector 0 holds a PakHeader followed by the table of contents. Every entry
+// starts on a sector boundary and entries are stored in load order, so the
+// assets of a scene can be read with one contiguous streaming read.
+// Entries flagged PAK_FLAG_LZ hold an LZ block (see lz.h) of rawSize bytes,
+// except textures. Those are streamed into VRAM as their sectors arrive, so
+// they are a run of blocks of up to PAK_LZ_BLOCK_SIZE raw bytes, each after
+// a u16 of its stored size, and only one block is staged at a time.
+
+#define PAK_MAGIC 0x4b415054 // "TPAK"
+#define PAK_VERSION 3
+#define PAK_MAX_ENTRIES ((CD_SECTOR_SIZE - sizeof(PakHeader)) / sizeof(PakEntry))
+
+typedef enum _PakType {
+    PAK_RAW = 0,
+    PAK_TIM = 1,
+    PAK_VAG = 2
+} PakType;
+
+#define PAK_FLAG_LZ 0x0001
+
+#define PAK_LZ_BLOCK_SIZE   8192
+#define PAK_LZ_BLOCK_STORED 0x8000  // In a block's size, stored uncompressed
+
+// Set to 1 to time reading and decompressing every asset at boot
+#define PAK_BENCH 0
+
+typedef struct _PakHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t numEntries;
+    uint32_t _reserved[2];
+} PakHeader;
+
+typedef struct _PakEntry {
+    uint32_t hash;      // FNV-1a of the upper case name
+    uint32_t sector;    // Relative to the start of the archive
+    uint32_t size;      // Stored size in bytes
+    uint32_t rawSize;   // Size once decompressed
+    uint16_t type;      // PakType
+    uint16_t flags;
+} PakEntry;
+
+// One asset to load as part of a scene. dest is a TimStream for PAK_TIM,
+// an AudioSample for PAK_VAG, or a char* that receives a copy of the data
+// for PAK_RAW, kept in the scene arena.
+typedef struct _PakLoad {
+    const char *name;
+    PakType type;
+    void *dest;
+
+    const PakEntry *entry;
+    char *buffer;
+} PakLoad;
+
+#define PAK_TEXTURE(name, stream) { (name), PAK_TIM, (stream), NULL, NULL }
+#define PAK_SAMPLE(name, sample)  { (name), PAK_VAG, (sample), NULL, NULL }
+#define PAK_FILE(name, bufferPtr) { (name), PAK_RAW, (bufferPtr), NULL, NULL }
+
+typedef struct _PakScene {
+    PakLoad *loads;
+    int numLoads;
+    int firstSector;
+    CdLoadRequest req;
+} PakScene;
+
+uint32_t hash_pak_name(const char *name);
+
+// Looks the archive up on the disc and reads its table of contents,
+// returns 0 on failure.
+int open_pak(const char *filename);
+
+const PakEntry *find_pak_entry(const char *name);
+
+// First sector of an entry on the disc, for reading it outside a scene
+int get_pak_entry_lba(const PakEntry *entry);
+
+// Queues a single read covering every asset in loads. loads is used until
+// the read completes. onComplete may be NULL.
+void queue_pak_scene(PakScene *scene, PakLoad *loads, const int numLoads, CdLoadCallback onComplete);
+
+// Reads a scene and waits for it
+void load_pak_scene(PakLoad *loads, const int numLoads);
+
+// Adds every sample loaded by a scene to bank, so they can be freed together
+void add_pak_samples_to_bank(SampleBank *bank, const PakLoad *loads, const int numLoads);
+
+// Reads every asset of a scene on its own and prints the read and
+// decompression times next to the time a raw copy would take at 2x speed.
+// Texture times include the upload, as they are decoded on the way to VRAM.
+// The assets are loaded as with load_pak_scene.
+void bench_pak_scene(PakLoad *loads, const int numLoads);
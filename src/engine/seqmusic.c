@@ -0,0 +1,333 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "music.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "timer.h"
+#include "arena.h"
+
+// Plays songs compiled by tools/mkseq.py. Each channel of the song has a
+// voice of its own and a list of (note, rows) events, played one row at a
+// time at the song's tempo times the speed. Instruments are short looped
+// waves, a note's pitch is set from the instrument's root.
+
+#define SEQ_MAGIC   0x51455354 // "TSEQ"
+#define SEQ_VERSION 1
+
+#define SEQ_INST_LOOP 0x01
+
+#define SPU_MAX_PITCH 0x3fff
+
+// After a stall, e.g. a load, carry on from where the song was rather than
+// playing every row that was due at once
+#define SEQ_MAX_CATCH_UP_MS 100
+
+typedef struct _SeqHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint8_t numInstruments;
+    uint8_t numChannels;
+    uint16_t tempo;         // Beats per minute
+    uint8_t rowsPerBeat;
+    uint8_t _reserved;
+    uint32_t numRows;
+} SeqHeader;
+
+typedef struct _SeqInstrument {
+    uint32_t offset;        // ADPCM data, from the start of the file
+    uint32_t size;
+    uint16_t rootPitch;     // Pitch register value that plays rootNote
+    uint8_t rootNote;
+    uint8_t flags;
+    uint16_t adsr1;
+    uint16_t adsr2;
+    uint16_t volume;
+    uint16_t _reserved;
+} SeqInstrument;
+
+typedef struct _SeqChannel {
+    uint32_t offset;        // Events, from the start of the file
+    uint16_t numEvents;
+    uint8_t instrument;
+    uint8_t _reserved;
+} SeqChannel;
+
+typedef struct _SeqEvent {
+    uint8_t note;           // MIDI note, 0 for a rest
+    uint8_t rows;
+} SeqEvent;
+
+typedef struct _SeqTrack {
+    const SeqEvent *events;
+    const SeqInstrument *instrument;
+    int numEvents;
+    int next;
+    int rowsLeft;
+    int isSounding;
+} SeqTrack;
+
+// 2^(n/12), fixed point
+static const uint16_t semitones[12] = {
+    4096, 4340, 4598, 4871, 5161, 5468, 5793, 6137, 6502, 6889, 7298, 7732
+};
+
+static char *song = NULL;
+static const SeqHeader *header;
+static const SeqInstrument *instruments;
+static int instAddr[SEQ_MAX_INSTRUMENTS];
+static SeqTrack tracks[SEQ_MAX_CHANNELS];
+static int numReserved = 0;
+
+static int isPlaying = 0;
+static int volume = 0;
+static int speed = FIXED_ONE;
+
+// Time into the current row, in ms scaled by FIXED_ONE, and a row's length
+static int rowClock;
+static int rowLength;
+static uint32_t lastTime;
+
+// Key ons and offs of the rows played by an update, written together
+static uint32_t keyOnMask, keyOffMask, oneShotMask;
+
+static int _pitch(const SeqInstrument *inst, const int note) {
+    int d = note - inst->rootNote;
+    int octave = (d >= 0) ? d / 12 : -((11 - d) / 12);
+    int pitch = (inst->rootPitch * semitones[d - octave*12]) >> FIXED_SCALE;
+
+    pitch = (octave >= 0) ? pitch << octave : pitch >> -octave;
+    return (pitch < SPU_MAX_PITCH) ? pitch : SPU_MAX_PITCH;
+}
+
+static int _track_volume(const SeqTrack *track) {
+    return (track->instrument->volume * volume) >> 14;
+}
+
+static void _free_song(void) {
+    for(int i = 0; i < SEQ_MAX_INSTRUMENTS; i++) {
+        if(instAddr[i])
+            free_spu_ram(instAddr[i]);
+        instAddr[i] = 0;
+    }
+
+    for(int i = 0; i < numReserved; i++)
+        release_voice(MUSIC_CHANNEL + i);
+    numReserved = 0;
+
+    // The data stays in the scene arena until the scene is reset
+    song = NULL;
+}
+
+static void _note_on(const int ch, SeqTrack *track, const int note) {
+    const SeqInstrument *inst = track->instrument;
+    int vol = _track_volume(track);
+    int mask = 1 << ch;
+
+    SPU_CH_FREQ(ch) = _pitch(inst, note);
+    SPU_CH_ADDR(ch) = getSPUAddr(instAddr[inst - instruments]);
+    SPU_CH_VOL_L(ch) = vol;
+    SPU_CH_VOL_R(ch) = vol;
+    SPU_CH_ADSR1(ch) = inst->adsr1;
+    SPU_CH_ADSR2(ch) = inst->adsr2;
+
+    keyOnMask |= mask;
+    keyOffMask &= ~mask;
+
+    if(inst->flags & SEQ_INST_LOOP)
+        oneShotMask &= ~mask;
+    else
+        oneShotMask |= mask;
+
+    track->isSounding = 1;
+}
+
+static void _note_off(const int ch, SeqTrack *track) {
+    keyOffMask |= 1 << ch;
+    keyOnMask &= ~(1 << ch);
+    track->isSounding = 0;
+}
+
+static void _play_row(void) {
+    for(int i = 0; i < header->numChannels; i++) {
+        SeqTrack *track = &tracks[i];
+
+        if(--track->rowsLeft > 0)
+            continue;
+
+        const SeqEvent *ev = &track->events[track->next];
+
+        if(++track->next >= track->numEvents)
+            track->next = 0;
+        track->rowsLeft = ev->rows;
+
+        if(ev->note)
+            _note_on(MUSIC_CHANNEL + i, track, ev->note);
+        else
+            _note_off(MUSIC_CHANNEL + i, track);
+    }
+}
+
+static void _flush_keys(void) {
+    if(keyOffMask)
+        SpuSetKey(0, keyOffMask);
+
+    if(keyOnMask) {
+        SpuSetKey(1, keyOnMask);
+
+        // One-shot instruments end on the silent loop like sound effects,
+        // looped ones repeat from their own loop start
+        for(int ch = 0; ch < SPU_NUM_VOICES; ch++) {
+            if(keyOnMask & oneShotMask & (1 << ch))
+                SPU_CH_LOOP_ADDR(ch) = getSPUAddr(SPU_SILENT_BLOCK_ADDR);
+        }
+    }
+
+    keyOnMask = 0;
+    keyOffMask = 0;
+}
+
+int open_music(const char *name) {
+    char *data = NULL;
+    PakLoad load = PAK_FILE(name, &data);
+
+    if(find_pak_entry(name) == NULL)
+        return 0;
+
+    stop_music();
+    _free_song();
+
+    load_pak_scene(&load, 1);
+    if(data == NULL)
+        return 0;
+
+    const SeqHeader *h = (const SeqHeader*)data;
+
+    if(h->magic != SEQ_MAGIC || h->version != SEQ_VERSION ||
+        h->numChannels == 0 || h->numChannels > SEQ_MAX_CHANNELS ||
+        h->numInstruments > SEQ_MAX_INSTRUMENTS || h->numRows == 0) {
+        printf("Error: %s is not a valid sequence.\n", name);
+        free_arena_to(&sceneArena, data);
+        return 0;
+    }
+
+    song = data;
+    header = h;
+    instruments = (const SeqInstrument*)&h[1];
+
+    for(int i = 0; i < h->numInstruments; i++) {
+        instAddr[i] = upload_sample(song + instruments[i].offset, instruments[i].size);
+
+        if(instAddr[i] == 0) {
+            printf("Error: no SPU RAM left for %s.\n", name);
+            _free_song();
+            return 0;
+        }
+    }
+
+    const SeqChannel *channels = (const SeqChannel*)&instruments[h->numInstruments];
+
+    for(int i = 0; i < h->numChannels; i++) {
+        tracks[i].events = (const SeqEvent*)(song + channels[i].offset);
+        tracks[i].numEvents = channels[i].numEvents;
+        tracks[i].instrument = &instruments[channels[i].instrument];
+
+        reserve_voice(MUSIC_CHANNEL + i);
+        numReserved++;
+    }
+
+    rowLength = (60000 * FIXED_ONE) / (h->tempo * h->rowsPerBeat);
+    return 1;
+}
+
+void play_music(const int vol) {
+    if(song == NULL)
+        return;
+
+    if(isPlaying)
+        stop_music();
+
+    for(int i = 0; i < header->numChannels; i++) {
+        tracks[i].next = 0;
+        tracks[i].rowsLeft = 1;
+        tracks[i].isSounding = 0;
+    }
+
+    volume = vol;
+    speed = FIXED_ONE;
+    rowClock = 0;
+    lastTime = get_system_time();
+    isPlaying = 1;
+
+    _play_row();
+    _flush_keys();
+}
+
+void stop_music(void) {
+    if(!isPlaying)
+        return;
+
+    for(int i = 0; i < header->numChannels; i++)
+        _note_off(MUSIC_CHANNEL + i, &tracks[i]);
+
+    _flush_keys();
+    isPlaying = 0;
+}
+
+void set_music_volume(const int vol) {
+    volume = vol;
+
+    if(song == NULL)
+        return;
+
+    for(int i = 0; i < header->numChannels; i++) {
+        if(tracks[i].isSounding) {
+            SPU_CH_VOL_L(MUSIC_CHANNEL + i) = _track_volume(&tracks[i]);
+            SPU_CH_VOL_R(MUSIC_CHANNEL + i) = _track_volume(&tracks[i]);
+        }
+    }
+}
+
+void set_music_speed(const int newSpeed) {
+    speed = newSpeed;
+}
+
+void update_music(void) {
+    if(!isPlaying)
+        return;
+
+    uint32_t now = get_system_time();
+    int elapsed = (int)(now - lastTime);
+    lastTime = now;
+
+    if(elapsed > SEQ_MAX_CATCH_UP_MS)
+        elapsed = SEQ_MAX_CATCH_UP_MS;
+
+    rowClock += elapsed * speed;
+
+    while(rowClock >= rowLength) {
+        rowClock -= rowLength;
+        _play_row();
+    }
+
+    _flush_keys();
+}
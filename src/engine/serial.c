@@ -0,0 +1,134 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "serial.h"
+#include <hwregs_c.h>
+
+#define SIO_STAT_TX_READY   0x0001
+#define SIO_STAT_RX_READY   0x0002
+#define SIO_STAT_OVERRUN    0x0010
+
+#define SIO_CTRL_TX_ENABLE  0x0001
+#define SIO_CTRL_DTR        0x0002
+#define SIO_CTRL_RX_ENABLE  0x0004
+#define SIO_CTRL_ACK_IRQ    0x0010
+#define SIO_CTRL_RTS        0x0020
+#define SIO_CTRL_RESET      0x0040
+#define SIO_CTRL_TX_IRQ     0x0400
+#define SIO_CTRL_RX_IRQ     0x0800
+
+#define SIO_MODE_8N1_X16    0x004e  // Baud reload x16, 8 data bits, 1 stop bit
+
+#define SIO_CTRL_ON (SIO_CTRL_TX_ENABLE | SIO_CTRL_DTR | SIO_CTRL_RX_ENABLE | SIO_CTRL_RTS | SIO_CTRL_RX_IRQ)
+
+static volatile uint8_t rxBuffer[SERIAL_RX_LEN];
+static volatile uint8_t txBuffer[SERIAL_TX_LEN];
+
+// The IRQ writes rxHead and txTail, everything else the caller
+static volatile uint32_t rxHead = 0, rxTail = 0;
+static volatile uint32_t txHead = 0, txTail = 0;
+static volatile int dropped = 0;
+
+static void _sio1_callback(void) {
+    // Empty the FIFO, a full buffer drops the newest bytes
+    while(SIO_STAT(1) & SIO_STAT_RX_READY) {
+        uint8_t byte = SIO_DATA(1);
+
+        if(rxHead - rxTail < SERIAL_RX_LEN)
+            rxBuffer[rxHead++ & (SERIAL_RX_LEN-1)] = byte;
+        else
+            dropped++;
+    }
+
+    if(SIO_STAT(1) & SIO_STAT_OVERRUN)
+        dropped++;
+
+    while((txTail != txHead) && (SIO_STAT(1) & SIO_STAT_TX_READY))
+        SIO_DATA(1) = txBuffer[txTail++ & (SERIAL_TX_LEN-1)];
+
+    // Nothing left to send, stop asking for TX ready IRQs
+    uint16_t ctrl = SIO_CTRL_ON;
+    if(txTail != txHead)
+        ctrl |= SIO_CTRL_TX_IRQ;
+
+    SIO_CTRL(1) = ctrl | SIO_CTRL_ACK_IRQ;
+}
+
+void init_serial(const int baud) {
+    EnterCriticalSection();
+
+    SIO_CTRL(1) = SIO_CTRL_RESET;
+    SIO_MODE(1) = SIO_MODE_8N1_X16;
+    SIO_BAUD(1) = F_CPU / (16 * baud);
+
+    rxHead = rxTail = 0;
+    txHead = txTail = 0;
+    dropped = 0;
+
+    InterruptCallback(IRQ_SIO1, &_sio1_callback);
+    SIO_CTRL(1) = SIO_CTRL_ON;
+
+    ExitCriticalSection();
+}
+
+void close_serial(void) {
+    EnterCriticalSection();
+
+    InterruptCallback(IRQ_SIO1, NULL);
+    SIO_CTRL(1) = SIO_CTRL_RESET;
+    SIO_CTRL(1) = 0;
+
+    ExitCriticalSection();
+}
+
+int serial_write(const void *data, const int len) {
+    const uint8_t *bytes = (const uint8_t*)data;
+    int count = 0;
+
+    while(count < len && (txHead - txTail) < SERIAL_TX_LEN)
+        txBuffer[txHead++ & (SERIAL_TX_LEN-1)] = bytes[count++];
+
+    // The TX ready IRQ takes it from here
+    EnterCriticalSection();
+    SIO_CTRL(1) = SIO_CTRL_ON | SIO_CTRL_TX_IRQ;
+    ExitCriticalSection();
+
+    return count;
+}
+
+int serial_read(void *data, const int len) {
+    uint8_t *bytes = (uint8_t*)data;
+    int count = 0;
+
+    while(count < len && rxTail != rxHead)
+        bytes[count++] = rxBuffer[rxTail++ & (SERIAL_RX_LEN-1)];
+
+    return count;
+}
+
+int serial_available(void) {
+    return rxHead - rxTail;
+}
+
+int serial_dropped(void) {
+    return dropped;
+}
@@ -0,0 +1,52 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <psxetc.h>
+#include <psxapi.h>
+
+// Link cable on the serial port (SIO1), 8 data bits, no parity, 1 stop
+// bit. Bytes are moved by the SIO1 IRQ into and out of ring buffers, so
+// reads and writes never wait on the line.
+
+#define SERIAL_BAUD 115200
+
+// Power of 2
+#define SERIAL_RX_LEN 512
+#define SERIAL_TX_LEN 512
+
+void init_serial(const int baud);
+void close_serial(void);
+
+// Queues len bytes to send, returns how many fit
+int serial_write(const void *data, const int len);
+
+// Takes up to len received bytes, returns how many there were
+int serial_read(void *data, const int len);
+
+// Bytes received and not read yet
+int serial_available(void);
+
+// Bytes lost because the receive buffer was full or the FIFO overran
+int serial_dropped(void);
@@ -0,0 +1,159 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#include "spuram.h"
+#include <stdio.h>
+
+typedef struct _SpuSpan {
+    int addr;
+    int size;
+    int isUsed;
+} SpuSpan;
+
+// Cover the heap with no gaps, in address order
+static SpuSpan spans[SPU_RAM_MAX_SPANS];
+static int numSpans = 0;
+
+static int usedBytes = 0;
+static int peakBytes = 0;
+
+static int _align(const int size) {
+    return (size + SPU_RAM_ALIGN - 1) & ~(SPU_RAM_ALIGN - 1);
+}
+
+static void _remove_span(const int index) {
+    for(int i = index; i < numSpans - 1; i++) {
+        spans[i] = spans[i + 1];
+    }
+    numSpans--;
+}
+
+static int _insert_span(const int index, const int addr, const int size, const int isUsed) {
+    if(numSpans >= SPU_RAM_MAX_SPANS)
+        return 0;
+
+    for(int i = numSpans; i > index; i--) {
+        spans[i] = spans[i - 1];
+    }
+
+    spans[index].addr = addr;
+    spans[index].size = size;
+    spans[index].isUsed = isUsed;
+    numSpans++;
+
+    return 1;
+}
+
+void init_spu_ram(void) {
+    numSpans = 0;
+    usedBytes = 0;
+    peakBytes = 0;
+
+    _insert_span(0, SPU_HEAP_START, SPU_RAM_SIZE - SPU_HEAP_START, 0);
+}
+
+int alloc_spu_ram(const int size) {
+    const int _size = _align(size);
+
+    for(int i = 0; i < numSpans; i++) {
+        SpuSpan *span = &spans[i];
+
+        if(span->isUsed || span->size < _size)
+            continue;
+
+        // Split off what is left, unless the list is full, then the whole
+        // span is handed out
+        if(span->size > _size && _insert_span(i + 1, span->addr + _size, span->size - _size, 0))
+            span->size = _size;
+
+        span->isUsed = 1;
+
+        usedBytes += span->size;
+        if(usedBytes > peakBytes) peakBytes = usedBytes;
+
+        return span->addr;
+    }
+
+    printf("Error: no room for %d bytes in SPU RAM.\n", size);
+    return 0;
+}
+
+void free_spu_ram(const int addr) {
+    for(int i = 0; i < numSpans; i++) {
+        if(spans[i].addr != addr)
+            continue;
+
+        if(!spans[i].isUsed)
+            break;
+
+        spans[i].isUsed = 0;
+        usedBytes -= spans[i].size;
+
+        if(i + 1 < numSpans && !spans[i + 1].isUsed) {
+            spans[i].size += spans[i + 1].size;
+            _remove_span(i + 1);
+        }
+
+        if(i > 0 && !spans[i - 1].isUsed) {
+            spans[i - 1].size += spans[i].size;
+            _remove_span(i);
+        }
+
+        return;
+    }
+
+    printf("Error: 0x%x is not allocated SPU RAM.\n", addr);
+}
+
+void get_spu_ram_stats(SpuRamStats *stats) {
+    stats->used = usedBytes;
+    stats->peak = peakBytes;
+    stats->free = 0;
+    stats->largestFree = 0;
+    stats->numFreeSpans = 0;
+    stats->numAllocs = 0;
+
+    for(int i = 0; i < numSpans; i++) {
+        if(spans[i].isUsed) {
+            stats->numAllocs++;
+            continue;
+        }
+
+        stats->free += spans[i].size;
+        stats->numFreeSpans++;
+        if(spans[i].size > stats->largestFree) stats->largestFree = spans[i].size;
+    }
+}
+
+void print_spu_ram_usage(void) {
+    SpuRamStats stats;
+    get_spu_ram_stats(&stats);
+
+    // Share of the free space that can't be had in one piece
+    int fragmentation = stats.free ? 100 - (int)((uint32_t)stats.largestFree * 100 / stats.free) : 0;
+
+    printf("SPU RAM: %d KB used (peak %d KB) in %d allocations, %d KB free\n", 
+        stats.used >> 10, stats.peak >> 10, stats.numAllocs, stats.free >> 10);
+    printf("SPU RAM: %d free spans, largest %d KB, %d%% fragmented\n", 
+        stats.numFreeSpans, stats.largestFree >> 10, fragmentation);
+}
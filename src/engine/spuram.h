@@ -0,0 +1,66 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <stdint.h>
+
+// SPU RAM allocator. Samples, the music ring and anything else uploaded to
+// the SPU get their space here and can give it back, so SPU RAM can be
+// reused between scenes.
+//
+// Space is handed out first fit in whole DMA blocks of SPU_RAM_ALIGN bytes
+// from a sorted list of spans. Freed spans are merged with free neighbours.
+
+#define SPU_RAM_SIZE      0x80000
+#define SPU_RAM_ALIGN     64
+
+// 0x0000-0x0fff holds the CD and voice capture buffers, 0x1000 the silent
+// block voices loop on once a sample ends
+#define SPU_SILENT_BLOCK_ADDR 0x1000
+#define SPU_HEAP_START        0x1040
+
+#define SPU_RAM_MAX_SPANS 64
+
+typedef struct _SpuRamStats {
+    int used;           // Bytes handed out
+    int peak;           // Most bytes ever handed out at once
+    int free;
+    int largestFree;    // The biggest allocation that would succeed
+    int numFreeSpans;
+    int numAllocs;
+} SpuRamStats;
+
+// Marks the whole heap as free
+void init_spu_ram(void);
+
+// Returns the address of size bytes rounded up to whole DMA blocks, or 0 if
+// there is no span big enough left
+int alloc_spu_ram(const int size);
+
+void free_spu_ram(const int addr);
+
+void get_spu_ram_stats(SpuRamStats *stats);
+
+// Prints occupancy and how fragmented the free space is
+void print_spu_ram_usage(void);
@@ -22,6 +22,7 @@
 
 #include "text.h"
 #include <string.h>
+#include "arena.h"
 
 static void _draw_character(TextSprite *textSprite, const int x, const int y, const int c) {
     if(c == -1) return;
@@ -31,20 +32,26 @@ static void _draw_character(TextSprite *textSprite, const int x, const int y, co
     draw_sprite(&sprite);
 }
 
-void load_text(TextSprite *textSprite, const char *charList, TIM_IMAGE *textSheet,
-                const int w, const int h, const int length) {
+int load_text(TextSprite *textSprite, const char *charList, const AtlasSheet *sheet,
+                TIM_IMAGE *atlas, const int length) {
     
+    textSprite->characterList = alloc_arena(&sceneArena, sizeof(char)*length);
+    if(textSprite->characterList == NULL || textSprite->spritesList == NULL) {
+        textSprite->size = 0;
+        return 0;
+    }
+
     textSprite->size = length;
-    
-    textSprite->characterList = malloc(sizeof(char)*length);
     memcpy(textSprite->characterList, charList, length);
 
-    textSprite->charW = w;
-    textSprite->charH = h;
-    textSprite->cols = (textSheet->prect->w<<(2-textSheet->mode&0x3))/w;
-    textSprite->rows = textSheet->prect->h/h;
+    textSprite->charW = sheet->cellW;
+    textSprite->charH = sheet->cellH;
+    textSprite->cols = sheet->cols;
+    textSprite->rows = (sheet->numCells + sheet->cols - 1) / sheet->cols;
+
+    load_atlas_sheet(textSprite->spritesList, length, sheet, atlas);
 
-    load_sprite_sheet(textSprite->spritesList, h, w, length, textSprite->cols, textSheet);
+    return 1;
 }
 
 int print_text(TextSprite *textSprite, const int x, const int y, 
@@ -32,8 +32,11 @@ typedef struct _TextSprite {
     int size;
 } TextSprite;
 
-void load_text(TextSprite *textSprite, const char *charList, TIM_IMAGE *textSheet, 
-                const int w, const int h, const int length);
+// charList gives the character of each sprite in the sheet, in order.
+// spritesList must already hold length sprites, returns 0 if either list
+// is NULL or there's no room left in the scene arena.
+int load_text(TextSprite *textSprite, const char *charList, const AtlasSheet *sheet,
+                TIM_IMAGE *atlas, const int length);
 
 int print_text(TextSprite *textSprite, const int x, const int y, 
                 const char *fmt, ...);
\ No newline at end of file
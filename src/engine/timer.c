@@ -22,10 +22,16 @@
 
 #include "timer.h"
 
+#define SYSTEM_TIMER_RELOAD ((F_CPU / 8) / 1000)
+
 volatile static uint32_t systemTime;
+static void (*tickCallback)(void) = NULL;
 
 static void _timer2_callback(void) {
     systemTime++;
+
+    if(tickCallback != NULL)
+        tickCallback();
 }
 
 void create_timer(Timer *timer) {
@@ -45,7 +51,7 @@ void init_system_timer(void) {
 	
 	SetRCnt(RCntCNT2, counter, RCntMdINTR);
 	TIMER_CTRL(2) = 0x0258; // CLK/8 input, IRQ on reload
-    TIMER_RELOAD(2)    = (F_CPU / 8) / 1000;    // 100 Hz
+    TIMER_RELOAD(2)    = SYSTEM_TIMER_RELOAD;    // 100 Hz
 
     // Configure timer 2 IRQ
 	InterruptCallback(IRQ_TIMER2, &_timer2_callback);
@@ -54,6 +60,36 @@ void init_system_timer(void) {
 	ExitCriticalSection();
 }
 
+void set_system_tick_callback(void (*callback)(void)) {
+    EnterCriticalSection();
+    tickCallback = callback;
+    ExitCriticalSection();
+}
+
 uint32_t get_system_time(void) {
     return systemTime;
-}
\ No newline at end of file
+}
+
+uint32_t get_system_time_us(void) {
+    uint32_t ms, ticks;
+
+    // Re-read if the IRQ bumped systemTime between the two reads
+    do {
+        ms    = systemTime;
+        ticks = TIMER_VALUE(2) & 0xffff;
+    } while(ms != systemTime);
+
+    return (ms * 1000) + ((ticks * 1000) / SYSTEM_TIMER_RELOAD);
+}
+
+uint32_t get_system_cycles(void) {
+    uint32_t ms, ticks;
+
+    do {
+        ms    = systemTime;
+        ticks = TIMER_VALUE(2) & 0xffff;
+    } while(ms != systemTime);
+
+    // Counter 2 runs at CLK/8
+    return ((ms * SYSTEM_TIMER_RELOAD) + ticks) * 8;
+}
@@ -37,3 +37,14 @@ typedef struct _Timer {
 void create_timer(Timer *timer);
 void init_system_timer(void);
 uint32_t get_system_time(void);
+
+// Calls callback from the system timer IRQ every ms, NULL to stop. It runs
+// with interrupts off and must be short.
+void set_system_tick_callback(void (*callback)(void));
+
+// Microseconds since init_system_timer, read from the root counter
+uint32_t get_system_time_us(void);
+
+// CPU cycles since init_system_timer, to the 8 cycles the root counter
+// ticks in. Wraps about every 2 minutes, differences stay right across it.
+uint32_t get_system_cycles(void);
@@ -0,0 +1,90 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "trace.h"
+
+#if TRACE_MODE
+
+typedef struct _TraceRecord {
+    uint32_t time;  // microseconds
+    uint8_t event;
+    uint8_t tid;
+    char phase;
+} TraceRecord;
+
+static TraceRecord traceBuffer[TRACE_BUFFER_LEN];
+static int traceHead  = 0;
+static int traceCount = 0;
+
+static const char *traceNames[NUM_TRACE_EVENTS] = {
+    "frame",
+    "pad poll",
+    "play_game",
+    "draw_matrix",
+    "display",
+    "DrawSync",
+    "VSync",
+    "DrawOTag",
+    "SPU upload",
+    "CD reseek"
+};
+
+void trace_event(const TraceEvent event, const int tid, const char phase) {
+    TraceRecord *rec = &traceBuffer[traceHead];
+
+    rec->time  = get_system_time_us();
+    rec->event = event;
+    rec->tid   = tid;
+    rec->phase = phase;
+
+    // Overwrite the oldest record once the buffer is full
+    traceHead = (traceHead + 1) % TRACE_BUFFER_LEN;
+    if(traceCount < TRACE_BUFFER_LEN)
+        traceCount++;
+}
+
+void dump_trace(void) {
+    int i = (traceHead - traceCount + TRACE_BUFFER_LEN) % TRACE_BUFFER_LEN;
+
+    printf("{\"traceEvents\":[\n");
+
+    // Name the rows so boards are easy to tell apart
+    printf("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"main\"}}", TRACE_TID_MAIN);
+    for(int b = 0; b < TRACE_NUM_BOARDS; b++)
+        printf(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"board %d\"}}", TRACE_TID_BOARD+b, b+1);
+
+    for(int n = 0; n < traceCount; n++) {
+        TraceRecord *rec = &traceBuffer[i];
+        printf(",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%u,\"pid\":0,\"tid\":%d}",
+            traceNames[rec->event], rec->phase, (unsigned) rec->time, rec->tid);
+        i = (i + 1) % TRACE_BUFFER_LEN;
+    }
+
+    printf("\n]}\n");
+}
+
+void clear_trace(void) {
+    traceHead  = 0;
+    traceCount = 0;
+}
+
+#endif
@@ -0,0 +1,70 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include "timer.h"
+
+// Records begin/end events of frame phases into a RAM ring buffer, which
+// can be dumped over TTY in Chrome trace-event format (chrome://tracing or
+// ui.perfetto.dev). Compiled out entirely when disabled, buffer included.
+#define TRACE_MODE 0
+#define TRACE_BUFFER_LEN 4096
+
+typedef enum _TraceEvent {
+    TRACE_FRAME = 0,
+    TRACE_PAD_POLL,
+    TRACE_PLAY_GAME,
+    TRACE_DRAW_MATRIX,
+    TRACE_DISPLAY,
+    TRACE_DRAW_SYNC,
+    TRACE_VSYNC,
+    TRACE_DMA_KICK,
+    TRACE_SPU_UPLOAD,
+    TRACE_CD_RESEEK,
+    NUM_TRACE_EVENTS
+} TraceEvent;
+
+// Thread ids used to split the timeline into rows.
+// Boards use TRACE_TID_BOARD + controller.
+#define TRACE_TID_MAIN  0
+#define TRACE_TID_BOARD 1
+#define TRACE_NUM_BOARDS 4
+
+#if TRACE_MODE
+    #define TRACE_BEGIN(event, tid) trace_event((event), (tid), 'B')
+    #define TRACE_END(event, tid)   trace_event((event), (tid), 'E')
+    #define TRACE_INSTANT(event, tid) trace_event((event), (tid), 'i')
+#else
+    #define TRACE_BEGIN(event, tid)
+    #define TRACE_END(event, tid)
+    #define TRACE_INSTANT(event, tid)
+#endif
+
+void trace_event(const TraceEvent event, const int tid, const char phase);
+
+// Prints the ring buffer as a JSON trace, oldest event first.
+void dump_trace(void);
+
+void clear_trace(void);
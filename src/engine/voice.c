@@ -0,0 +1,209 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include <string.h>
+#include <psxspu.h>
+#include <hwregs_c.h>
+#include "voice.h"
+
+static Voice voices[SPU_NUM_VOICES];
+static uint32_t nextAge = 0;
+
+// Voices keyed on since the last update_voices, their ENDX bit may not
+// have been reset by the SPU yet
+static uint32_t startedMask = 0;
+
+static VoiceStats stats;
+static VoiceStats frameStats;
+
+static uint32_t _ended_voices(void) {
+    return SPU_CHAN_STATUS1 | ((uint32_t)SPU_CHAN_STATUS2 << 16);
+}
+
+// How loud the voice is right now, its envelope scaled by its volume
+static int _loudness(const int ch) {
+    return ((int)SPU_CH_ADSR_VOL(ch) * voices[ch].volume) >> 15;
+}
+
+// With a sample, the oldest voice playing it. Without, the voice to steal
+// for a sound of the given priority, or -1 if every voice outranks it.
+static int _pick_victim(const AudioSample *sample, const int priority) {
+    int victim = -1;
+
+    for(int ch = 0; ch < SPU_NUM_VOICES; ch++) {
+        Voice *v = &voices[ch];
+
+        if(v->isReserved || v->sample == NULL)
+            continue;
+        if(sample != NULL && v->sample != sample)
+            continue;
+        if(sample == NULL && v->priority > priority)
+            continue;
+
+        if(victim < 0) {
+            victim = ch;
+            continue;
+        }
+
+        Voice *best = &voices[victim];
+
+        if(sample == NULL) {
+            if(v->priority != best->priority) {
+                if(v->priority < best->priority)
+                    victim = ch;
+                continue;
+            }
+
+            int loud = _loudness(ch), bestLoud = _loudness(victim);
+            if(loud != bestLoud) {
+                if(loud < bestLoud)
+                    victim = ch;
+                continue;
+            }
+        }
+
+        if((int32_t)(v->age - best->age) < 0)
+            victim = ch;
+    }
+
+    return victim;
+}
+
+static void _claim(const int ch, const AudioSample *sample) {
+    Voice *v = &voices[ch];
+
+    v->sample = sample;
+    v->priority = sample->priority;
+    v->volume = sample->volume;
+    v->age = nextAge++;
+
+    startedMask |= 1 << ch;
+    frameStats.started++;
+}
+
+void init_voices(void) {
+    memset(voices, 0, sizeof(voices));
+    memset(&stats, 0, sizeof(stats));
+    memset(&frameStats, 0, sizeof(frameStats));
+    startedMask = 0;
+}
+
+void reserve_voice(const int ch) {
+    SpuSetKey(0, 1 << ch);
+
+    voices[ch].sample = NULL;
+    voices[ch].isReserved = 1;
+}
+
+void release_voice(const int ch) {
+    voices[ch].isReserved = 0;
+}
+
+int alloc_voice(const AudioSample *sample) {
+    int ch;
+
+    // At its cap the sound restarts its own oldest voice
+    if(sample->maxVoices > 0) {
+        int count = 0;
+
+        for(ch = 0; ch < SPU_NUM_VOICES; ch++) {
+            if(voices[ch].sample == sample)
+                count++;
+        }
+
+        if(count >= sample->maxVoices) {
+            ch = _pick_victim(sample, 0);
+            _claim(ch, sample);
+            frameStats.limited++;
+            return ch;
+        }
+    }
+
+    for(ch = 0; ch < SPU_NUM_VOICES; ch++) {
+        if(!voices[ch].isReserved && voices[ch].sample == NULL) {
+            _claim(ch, sample);
+            return ch;
+        }
+    }
+
+    ch = _pick_victim(NULL, sample->priority);
+    if(ch < 0) {
+        frameStats.dropped++;
+        return -1;
+    }
+
+    _claim(ch, sample);
+    frameStats.stolen++;
+    return ch;
+}
+
+void free_voice(const int ch) {
+    voices[ch].sample = NULL;
+    startedMask &= ~(1 << ch);
+}
+
+void stop_sample_voices(const AudioSample *sample) {
+    for(int ch = 0; ch < SPU_NUM_VOICES; ch++) {
+        if(voices[ch].sample == sample) {
+            SpuSetKey(0, 1 << ch);
+            free_voice(ch);
+        }
+    }
+}
+
+void update_voices(void) {
+    uint32_t ended = _ended_voices() & ~startedMask;
+    int active = 0, reserved = 0;
+
+    for(int ch = 0; ch < SPU_NUM_VOICES; ch++) {
+        Voice *v = &voices[ch];
+
+        if(v->isReserved) {
+            reserved++;
+            continue;
+        }
+
+        // Past the end the voice loops on the silent block, key it off
+        // so its envelope reads 0 like any other idle voice
+        if(v->sample != NULL && (ended & (1 << ch))) {
+            SpuSetKey(0, 1 << ch);
+            v->sample = NULL;
+        }
+
+        if(v->sample != NULL)
+            active++;
+    }
+
+    startedMask = 0;
+
+    frameStats.active = active;
+    frameStats.reserved = reserved;
+    frameStats.peak = (active > stats.peak) ? active : stats.peak;
+
+    stats = frameStats;
+    memset(&frameStats, 0, sizeof(frameStats));
+    frameStats.peak = stats.peak;
+}
+
+void get_voice_stats(VoiceStats *out) {
+    *out = stats;
+}
@@ -0,0 +1,86 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include "audiotypes.h"
+
+// SPU voice manager. play_sample asks it for a voice instead of scanning
+// the hardware, so a sound can't grab a voice something else owns.
+//
+// - Reserved voices, e.g. the music stream's MUSIC_CHANNEL, are never
+//   handed out.
+// - A sample playing on as many voices as its maxVoices restarts the
+//   oldest of them instead of taking another.
+// - With no voice free, the lowest priority voice not above the new
+//   sound's priority is stolen, the quietest then the oldest among equals.
+//   If every voice outranks it the sound is dropped.
+//
+// A voice is free again once it reaches the loop end flag of its sample,
+// which the SPU reports in ENDX. update_voices picks that up once a frame.
+
+#define SPU_NUM_VOICES 24
+
+#define VOICE_PRIORITY_LOW    0
+#define VOICE_PRIORITY_NORMAL 1
+#define VOICE_PRIORITY_HIGH   2
+
+typedef struct _Voice {
+    const AudioSample *sample;  // NULL when free
+    int priority;
+    int volume;
+    uint32_t age;               // Order voices were keyed on in
+    int isReserved;
+} Voice;
+
+typedef struct _VoiceStats {
+    int active;     // Voices playing a sample at the end of the last frame
+    int reserved;
+    int peak;       // Most voices ever playing at once
+    int started;    // Per frame: sounds given a voice,
+    int stolen;     // voices taken from another sound,
+    int limited;    // sounds that restarted one of their own voices,
+    int dropped;    // and sounds that got no voice
+} VoiceStats;
+
+void init_voices(void);
+
+// Takes a voice out of the pool for the caller to drive directly
+void reserve_voice(const int ch);
+void release_voice(const int ch);
+
+// Returns the voice to key sample on, -1 if it should not play. A voice
+// taken from another sound is cut off by the new key on.
+int alloc_voice(const AudioSample *sample);
+
+// Marks a voice free, it must already be keyed off
+void free_voice(const int ch);
+
+// Keys off every voice playing sample
+void stop_sample_voices(const AudioSample *sample);
+
+// Frees voices that finished and rolls the per frame stats. Called once a
+// frame by flush_audio, after the frame's key ons.
+void update_voices(void);
+
+void get_voice_stats(VoiceStats *stats);
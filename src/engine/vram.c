@@ -0,0 +1,291 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#include "vram.h"
+#include <stdio.h>
+#include <string.h>
+#include "graphics2d.h"
+
+typedef struct _VramClut {
+    uint32_t hash;
+    int16_t x, y, w, h;
+    uint16_t *colors;   // Copy in clutColors, the caller's are gone by the next upload
+} VramClut;
+
+// Height in use of every column, per band
+static uint16_t skyline[VRAM_NUM_BANDS][VRAM_NUM_COLUMNS];
+
+// Bit per colour mode of what has been placed in each texture page
+static uint8_t pageModes[VRAM_NUM_BANDS][VRAM_NUM_PAGES];
+
+static RECT clutArea;
+static uint8_t clutRowSlots[VRAM_MAX_CLUT_ROWS];
+static VramClut cluts[VRAM_MAX_CLUTS];
+static int numCluts = 0;
+static uint16_t clutColors[VRAM_CLUT_POOL_COLORS];
+static int numClutColors = 0;
+static int numClutShares = 0;
+
+static uint32_t usedArea = 0;
+
+static int _clamp_mode(const int mode) {
+    // 24-bit images can't be textures, only the page width matters for them
+    return (mode & 0x3) > 2 ? 2 : (mode & 0x3);
+}
+
+static void _raise_skyline(const int band, const int col, const int numCols, const int height) {
+    for(int i = col; i < col + numCols; i++) {
+        if(skyline[band][i] < height)
+            skyline[band][i] = height;
+    }
+}
+
+void reserve_vram(const RECT *rect) {
+    const int col = rect->x / VRAM_COLUMN;
+    const int numCols = (rect->x + rect->w + VRAM_COLUMN - 1) / VRAM_COLUMN - col;
+
+    for(int band = 0; band < VRAM_NUM_BANDS; band++) {
+        int top = rect->y - band * VRAM_BAND_HEIGHT;
+        int bottom = top + rect->h;
+
+        if(bottom <= 0 || top >= VRAM_BAND_HEIGHT)
+            continue;
+
+        if(bottom > VRAM_BAND_HEIGHT) bottom = VRAM_BAND_HEIGHT;
+        _raise_skyline(band, col, numCols, bottom);
+    }
+
+    usedArea += rect->w * rect->h;
+}
+
+int alloc_vram(RECT *rect, const int w, const int h, const int mode) {
+    const int m = _clamp_mode(mode);
+    const int pageSpan = VRAM_PAGE_WIDTH << m;
+    const int numCols = (w + VRAM_COLUMN - 1) / VRAM_COLUMN;
+
+    int bestBand = -1, bestCol = 0, bestY = 0;
+    int bestShared = 0, bestWaste = 0;
+
+    if(h > VRAM_BAND_HEIGHT || w > pageSpan)
+        return 0;
+
+    for(int band = 0; band < VRAM_NUM_BANDS; band++) {
+        for(int col = 0; col + numCols <= VRAM_NUM_COLUMNS; col++) {
+            const int x = col * VRAM_COLUMN;
+
+            // UVs are 8-bit, the image has to fit in the page it starts in
+            if((x % VRAM_PAGE_WIDTH) + w > pageSpan)
+                continue;
+
+            int y = 0;
+            for(int i = col; i < col + numCols; i++) {
+                if(skyline[band][i] > y) y = skyline[band][i];
+            }
+
+            if(y + h > VRAM_BAND_HEIGHT)
+                continue;
+
+            int waste = 0;
+            for(int i = col; i < col + numCols; i++) {
+                waste += y - skyline[band][i];
+            }
+
+            // Sharing a page with the same depth saves tpage switches, then
+            // go for the lowest spot leaving the smallest gap
+            const int shared = (pageModes[band][x / VRAM_PAGE_WIDTH] >> m) & 1;
+
+            if(bestBand >= 0) {
+                if(shared != bestShared) {
+                    if(!shared) continue;
+                } else if(y != bestY) {
+                    if(y > bestY) continue;
+                } else if(waste >= bestWaste) {
+                    continue;
+                }
+            }
+
+            bestBand = band;
+            bestCol = col;
+            bestY = y;
+            bestShared = shared;
+            bestWaste = waste;
+        }
+    }
+
+    if(bestBand < 0) {
+        printf("Error: no room in VRam for %dx%d image.\n", w, h);
+        return 0;
+    }
+
+    _raise_skyline(bestBand, bestCol, numCols, bestY + h);
+    pageModes[bestBand][(bestCol * VRAM_COLUMN) / VRAM_PAGE_WIDTH] |= 1 << m;
+    usedArea += w * h;
+
+    rect->x = bestCol * VRAM_COLUMN;
+    rect->y = bestBand * VRAM_BAND_HEIGHT + bestY;
+    rect->w = w;
+    rect->h = h;
+
+    return 1;
+}
+
+static uint32_t _hash_colors(const uint16_t *colors, const int numColors) {
+    uint32_t hash = 2166136261u;
+
+    for(int i = 0; i < numColors; i++) {
+        hash = (hash ^ colors[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+int alloc_vram_clut(RECT *rect, const uint16_t *colors, const int w, const int h) {
+    const uint32_t hash = _hash_colors(colors, w * h);
+    const int slots = (w + VRAM_CLUT_SLOT - 1) / VRAM_CLUT_SLOT;
+    const int rowSlots = clutArea.w / VRAM_CLUT_SLOT;
+
+    rect->w = w;
+    rect->h = h;
+
+    // The hash only rules CLUTs out, the colours have to match to share
+    for(int i = 0; i < numCluts; i++) {
+        if(cluts[i].hash == hash && cluts[i].w == w && cluts[i].h == h &&
+            memcmp(cluts[i].colors, colors, w * h * sizeof(uint16_t)) == 0) {
+            rect->x = cluts[i].x;
+            rect->y = cluts[i].y;
+            numClutShares++;
+            return 1;
+        }
+    }
+
+    // Blocks of several CLUTs need the same slots free in h rows in a row
+    int row, slot = 0;
+    for(row = 0; row + h <= clutArea.h; row++) {
+        slot = 0;
+        for(int i = row; i < row + h; i++) {
+            if(clutRowSlots[i] > slot) slot = clutRowSlots[i];
+        }
+
+        if(slot + slots <= rowSlots)
+            break;
+    }
+
+    if(row + h > clutArea.h) {
+        printf("Error: no room in VRam for %dx%d CLUT.\n", w, h);
+        return 0;
+    }
+
+    rect->x = clutArea.x + slot * VRAM_CLUT_SLOT;
+    rect->y = clutArea.y + row;
+
+    for(int i = row; i < row + h; i++) {
+        clutRowSlots[i] = slot + slots;
+    }
+
+    LoadImage(rect, (const uint32_t*)colors);
+    DrawSync(0);
+
+    if(numCluts < VRAM_MAX_CLUTS && numClutColors + w * h <= VRAM_CLUT_POOL_COLORS) {
+        cluts[numCluts].colors = &clutColors[numClutColors];
+        memcpy(cluts[numCluts].colors, colors, w * h * sizeof(uint16_t));
+        numClutColors += w * h;
+
+        cluts[numCluts].hash = hash;
+        cluts[numCluts].x = rect->x;
+        cluts[numCluts].y = rect->y;
+        cluts[numCluts].w = w;
+        cluts[numCluts].h = h;
+        numCluts++;
+    }
+
+    return 1;
+}
+
+void print_vram_usage(void) {
+    uint32_t skylineArea = 0;
+    int pages = 0;
+
+    for(int band = 0; band < VRAM_NUM_BANDS; band++) {
+        for(int col = 0; col < VRAM_NUM_COLUMNS; col++) {
+            skylineArea += skyline[band][col] * VRAM_COLUMN;
+        }
+
+        for(int page = 0; page < VRAM_NUM_PAGES; page++) {
+            if(pageModes[band][page]) pages++;
+        }
+    }
+
+    const uint32_t total = VRAM_WIDTH * VRAM_HEIGHT;
+
+    printf("VRam: %d%% used, %d%% lost to packing, %d%% free\n", 
+        (int)(usedArea * 100 / total), (int)((skylineArea - usedArea) * 100 / total),
+        (int)((total - skylineArea) * 100 / total));
+    printf("VRam: %d texture pages, %d CLUTs (%d shared)\n", pages, numCluts, numClutShares);
+}
+
+void init_vram(void) {
+    const RECT framebuffers = { 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT * 2 };
+
+    for(int band = 0; band < VRAM_NUM_BANDS; band++) {
+        for(int col = 0; col < VRAM_NUM_COLUMNS; col++) {
+            skyline[band][col] = 0;
+        }
+
+        for(int page = 0; page < VRAM_NUM_PAGES; page++) {
+            pageModes[band][page] = 0;
+        }
+    }
+
+    for(int row = 0; row < VRAM_MAX_CLUT_ROWS; row++) {
+        clutRowSlots[row] = 0;
+    }
+
+    numCluts = 0;
+    numClutColors = 0;
+    numClutShares = 0;
+    usedArea = 0;
+
+    reserve_vram(&framebuffers);
+
+#if DEBUG_MODE
+    // Font texture and its CLUT, see init_debug_fnt
+    const RECT debugFont = { 960, 0, 64, 130 };
+    reserve_vram(&debugFont);
+#endif
+
+    // CLUTs go under the framebuffers when there is room, otherwise they
+    // get a block of their own
+    clutArea.x = 0;
+    clutArea.y = framebuffers.h;
+    clutArea.w = framebuffers.w - (framebuffers.w % VRAM_CLUT_SLOT);
+    clutArea.h = VRAM_HEIGHT - framebuffers.h;
+
+    if(clutArea.h < 1) {
+        alloc_vram(&clutArea, 256, 16, 2);
+    } else {
+        if(clutArea.h > VRAM_MAX_CLUT_ROWS)
+            clutArea.h = VRAM_MAX_CLUT_ROWS;
+
+        reserve_vram(&clutArea);
+    }
+}
@@ -0,0 +1,70 @@
+/*
+* Copyright (c) 2024 Logan Campbell
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <stdint.h>
+#include <psxgpu.h>
+
+// VRam allocator. Textures and CLUTs are given a place in VRam when they are
+// loaded instead of using the coordinates in their TIM headers.
+//
+// Each 256 line half of VRam is packed with a skyline in columns of
+// VRAM_COLUMN halfwords. Images never cross a texture page and are placed
+// in pages already holding images of the same depth where possible, so
+// small sprite sheets end up sharing pages. CLUTs get 16 colour slots in a
+// strip of rows and identical CLUT blocks are only uploaded once.
+
+#define VRAM_WIDTH 1024
+#define VRAM_HEIGHT 512
+#define VRAM_BAND_HEIGHT 256
+#define VRAM_NUM_BANDS (VRAM_HEIGHT / VRAM_BAND_HEIGHT)
+#define VRAM_COLUMN 16
+#define VRAM_NUM_COLUMNS (VRAM_WIDTH / VRAM_COLUMN)
+
+#define VRAM_PAGE_WIDTH 64
+#define VRAM_NUM_PAGES (VRAM_WIDTH / VRAM_PAGE_WIDTH)
+
+#define VRAM_CLUT_SLOT 16
+#define VRAM_MAX_CLUT_ROWS 32
+#define VRAM_MAX_CLUTS 64
+// Colours kept to check a CLUT really matches before it is shared, CLUTs
+// past this are uploaded but never shared
+#define VRAM_CLUT_POOL_COLORS 4096
+
+// Resets VRam to empty apart from the framebuffers and the debug font
+void init_vram(void);
+
+// Marks an area as used, for things placed by hand
+void reserve_vram(const RECT *rect);
+
+// Finds room for a w x h (in halfwords) image of the given TIM colour mode.
+// Fills in the x and y of rect, returns 0 if VRam is full.
+int alloc_vram(RECT *rect, const int w, const int h, const int mode);
+
+// Places and uploads a block of h CLUTs of w colours, or finds an identical
+// block uploaded earlier. Fills in rect, returns 0 if there is no room left.
+int alloc_vram_clut(RECT *rect, const uint16_t *colors, const int w, const int h);
+
+// Prints how much of VRam is in use
+void print_vram_usage(void);
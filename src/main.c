@@ -29,11 +29,19 @@
 */
 
 
+#include <stddef.h>
+#include <string.h>
 #include "engine/fpmath.h"
 #include "engine/graphics2d.h"
 #include "engine/input.h"
 #include "engine/text.h"
 #include "engine/audio.h"
+#include "engine/pak.h"
+#include "engine/music.h"
+#include "engine/netplay.h"
+#include "engine/memcard.h"
+#include "engine/arena.h"
+#include "sprites.h"
 
 #define MATRIX_WIDTH 10
 #define MATRIX_HEIGHT 20
@@ -42,19 +50,38 @@
 #define NUM_NEXT_TETRIMINOS 14
 #define NUM_TETRIMINO_TYPES 7
 #define NUM_TETRIMINO_EXTRAS 1
-#define TETRIMINO_HORZ_SPEED 3
-#define TETRIMINO_MOVE_COOLDOWN 10
+#define MAX_BOARDS INPUT_MAX_PADS //One per pad, four with a Multitap
+#define DEFAULT_DAS 10 //Frames a direction is held before it auto-shifts
+#define DEFAULT_ARR 3  //Frames between auto-shifts, 0 shifts straight to the wall
+#define DEFAULT_SDF 8  //Soft drop is this many times faster than gravity, 0 drops to the floor
+#define MAX_DAS 30
+#define MAX_ARR 10
+#define MAX_SDF 20
 #define TETRIMINO_SET_TIME 80
+
+// Primitive bytes a board may add in a frame, so every board fits in the
+// PRIM_BUFFER_LEN buffer with the rest of the scene. Each bound is the most
+// a board can draw, every sprite with its own tpage change: all cells
+// filled, the piece and its ghost, the next and held pieces, its text and
+// a message. bench/ draws that case (draw_game_worst) in ~4850 bytes for a
+// full size board and 4604 for a compact one, as tpage changes are shared.
+#define SPRITE_PRIM_BYTES (sizeof(SPRT) + sizeof(DR_TPAGE))
+#define BOARD_PRIM_BUDGET ((MATRIX_HEIGHT*MATRIX_WIDTH + 2*4 + 4*4 + 6*6 + 11) * SPRITE_PRIM_BYTES)
+#define COMPACT_BOARD_PRIM_BUDGET ((MATRIX_HEIGHT*MATRIX_WIDTH + 2*4 + 2*4 + 2*6 + 11) * SPRITE_PRIM_BYTES + sizeof(TILE))
+#define SCENE_PRIM_BUDGET 4096 //Backgrounds, foregrounds and the text around the boards
+
+_Static_assert(2*BOARD_PRIM_BUDGET + SCENE_PRIM_BUDGET <= PRIM_BUFFER_LEN, "two boards don't fit in the primitive buffer");
+_Static_assert(MAX_BOARDS*COMPACT_BOARD_PRIM_BUDGET + SCENE_PRIM_BUDGET <= PRIM_BUFFER_LEN, "four boards don't fit in the primitive buffer");
 #define CENTER 3
 
 #define BASE_DROP_RATE 30
 #define LEVEL_DROP_RATE_MULTI 4506 //1.10, Fixed int
-#define SOFT_DROP_RATE 4
-#define MAIN_MENU_OPTIONS 3
-#define OPTIONS_MENU_OPTIONS 3
+#define MUSIC_SPEED_PER_LEVEL 4300 //1.05, Fixed int. The CD music modes pre-render these speeds, see TETRADE_MUSIC_RATES
+#define MUSIC_MAX_SPEED (4 * FIXED_ONE) //As fast as the SPU can pitch a voice
+#define MAIN_MENU_OPTIONS 5
+#define OPTIONS_MENU_OPTIONS 6
 #define CONTINUE_TIME (10 * VYSNC_RATE)
 #define PAUSE_TIME (3 * VYSNC_RATE)
-#define MUSIC_CHANNEL 0 
 
 #define SINGLE_LINE_SCORE 200
 #define DOUBLE_LINE_SCORE 500
@@ -64,18 +91,42 @@
 #define HARD_DROP_SCORE   2
 #define LEVEL_GOAL        8
 
-extern const uint8_t click[];
-extern const uint8_t confirm[];
-extern const uint8_t place[];
-extern const uint8_t clear[];
-extern const uint8_t theme[];
-extern const uint8_t negative[];
-extern const uint8_t hold[];
+// Asset archive on the disc, see assets.txt and iso.xml
+#define PAK_FILE_NAME "\\TETRADE.PAK;1"
+
+// Settings, high scores and the last marathon's replay, one block on the
+// card in slot 1
+#define SAVE_FILE_NAME "BASLUS-00000TETRADE"
+#define SAVE_CARD_PORT 0
+#define SAVE_BLOCKS 1
+#define SAVE_MAGIC 0x56415354 // "TSAV"
+#define SAVE_VERSION 1
+#define NUM_HIGH_SCORES 5
+#define REPLAY_MAX_BYTES 7680 // ~2500 button changes, what fits in the block
+
+// Builds a tetrade.exe that times fixed scenarios in CPU cycles and prints
+// them over TTY instead of playing, see tools/runbench.py. Configure with
+// -DTETRADE_BENCH=ON to set it.
+#ifndef BENCH_MODE
+#define BENCH_MODE 0
+#endif
+
+typedef enum _TextureId {
+    TEX_SPRITES = 0,
+    TEX_TITLE,
+    TEX_BACKGROUND_LEFT,
+    TEX_BACKGROUND_RIGHT,
+    TEX_FOREGROUND_LEFT,
+    TEX_FOREGROUND_RIGHT,
+    NUM_TEXTURES
+} TextureId;
 
 typedef enum _GameState {
     START   = 0,
     REGULAR = 1,
-    VERSUS  = 2
+    VERSUS  = 2,
+    LINK    = 3,
+    REPLAY  = 4
 } GameState;
 
 typedef enum _MenuState {
@@ -84,6 +135,21 @@ typedef enum _MenuState {
     OPTIONS = 2
 } MenuState;
 
+// Options that change how a board plays. Each board points at its player's,
+// over the link cable the other console's come with its hello.
+typedef struct _PlayerSettings {
+    int isRandomBag;
+    int das;
+    int arr;
+    int sdf;
+} PlayerSettings;
+
+typedef struct _HighScore {
+    uint32_t score;
+    uint16_t level;
+    uint16_t lines;
+} HighScore;
+
 typedef struct _Game {
     GameState gameState;
     MenuState menuState;
@@ -97,6 +163,7 @@ typedef struct _Game {
     Sprite tetriminoSprites[NUM_TETRIMINO_TYPES+NUM_TETRIMINO_EXTRAS];
     Sprite tetriminoGhostSprites[NUM_TETRIMINO_TYPES+NUM_TETRIMINO_EXTRAS];
     Sprite tetriminoSmallSprites[NUM_TETRIMINO_TYPES+NUM_TETRIMINO_EXTRAS];
+    Sprite tetriminoSmallGhostSprites[NUM_TETRIMINO_TYPES+NUM_TETRIMINO_EXTRAS];
 
     AudioSample click_sfx;
     AudioSample confirm_sfx;
@@ -104,17 +171,21 @@ typedef struct _Game {
     AudioSample clear_sfx;
     AudioSample negative_sfx;
     AudioSample hold_sfx;
-    AudioSample theme_song;
+
+    // Sound effects used everywhere, loaded at boot
+    SampleBank sfxBank;
 
     int isMusicPlaying;
 
     // Settings
-    int isRandomBag;
+    PlayerSettings settings;
     int sfxVol;
     int musicVol;
 
-    int playerOneStart;
-    int playerTwoStart;
+    int playerStart[MAX_BOARDS];
+    int numBoards; // Boards laid out on screen
+
+    HighScore highScores[NUM_HIGH_SCORES]; // Marathon, best first
 
     int winner;
 
@@ -147,7 +218,8 @@ typedef struct _TetradeGame {
     int tripleLine;
     int tetrade;
 
-    int moveCooldown;
+    int shiftDir;   // -1 left, 1 right, 0 neither held
+    int shiftTime;  // Frames shiftDir has been held, the frame it went down is 0
     int setTime;
     int level;
     int ghostY;
@@ -168,14 +240,26 @@ typedef struct _TetradeGame {
     int nextXY[3][2];
     int holdX, holdY;
     
-    struct _TetradeGame *opponent;
+    int isCompact;  // Quarter screen board drawn with the small minos
+    int minoWidth;
+    int drawCost;   // Time to update and draw the board last frame, in us
+    int primCost;   // Primitive bytes the board added last frame
+    int isOut;      // Versus board that has stopped playing
+
+    struct _TetradeGame *opponent; // Versus boards form a ring
     int controller;
+    const PlayerSettings *settings;
+    uint32_t rng;   // Each match's pieces and garbage come from its seed
     Timer pauseTimer;
     Timer continueTimer;
     Timer gameTimer;
 } TetradeGame;
 
 static Game gameCtx;
+static TetradeGame boards[MAX_BOARDS];
+
+// Set while frames are stepped again for rollback, their sounds already played
+static int isReplaying = 0;
 
 static const int pieces[7][4][4] = {
         {{0, 0, 0, 0}, 
@@ -241,7 +325,6 @@ static const int wallKickITests[8][5][2] = {
         {{-1,  0}, { 2,  0}, {-1,  2}, { 2, -1}, { 0, -2}}, //0>>3
     };
 
-static const int musicSRsbyLevel[10] = { 22050, 23152, 24310, 25525, 26802, 28142, 29546, 31026, 32577, 34206 };
 static const int volumeLevels[11] = { 0x0000, 0x0666, 0x0CCC, 0x1332, 0x1999, 0x1FFF, 0x2665, 0x2CCC, 0x3332, 0x3998, 0x3fff };
 
 // 0 counterClockwise 1 clockwise
@@ -303,8 +386,21 @@ void pick_tetrimino(Tetrimino *tetrimino, const int type) {
     tetrimino->rotState = 0;
 }
 
-void set_random_tetrimino(Tetrimino *tetrimino) {
-        pick_tetrimino(tetrimino, ((rand() % 7) + 1));
+// Sounds from the game logic, quiet when the frame is being replayed
+void play_game_sfx(AudioSample *sample) {
+    if(!isReplaying)
+        play_sample(sample);
+}
+
+// Random number in [0, n) from a match's own generator, the same on every
+// console given the same seed
+int random_int(uint32_t *rng, const int n) {
+    *rng = (*rng * 1103515245) + 12345;
+    return (int)((*rng >> 16) % n);
+}
+
+void set_random_tetrimino(Tetrimino *tetrimino, uint32_t *rng) {
+        pick_tetrimino(tetrimino, (random_int(rng, 7) + 1));
 }
 
 // Return true if all minos are within bounds and do not overlap other minos
@@ -351,7 +447,7 @@ void remove_row(const int row, const int rowc, const int colc, int matrix[rowc][
 }
 
 // Add row of minos to the bottom of the matrix with one mino missing
-void add_garbage(int matrix[MATRIX_HEIGHT][MATRIX_WIDTH]) {
+void add_garbage(int matrix[MATRIX_HEIGHT][MATRIX_WIDTH], uint32_t *rng) {
     for(int i = 0; i < MATRIX_HEIGHT-1; i++ ) {
         for(int j = 0; j < MATRIX_WIDTH; j++) {
             matrix[i][j] = matrix[i+1][j];
@@ -361,12 +457,36 @@ void add_garbage(int matrix[MATRIX_HEIGHT][MATRIX_WIDTH]) {
     for(int i = 0; i < MATRIX_WIDTH; i++) {
         matrix[MATRIX_HEIGHT-1][i] = 8;
     }
-    matrix[MATRIX_HEIGHT-1][rand() % 8] = 0;
+    matrix[MATRIX_HEIGHT-1][random_int(rng, 8)] = 0;
+}
+
+// Next board round the versus ring still playing, NULL if there is none
+TetradeGame *live_opponent(const TetradeGame *game) {
+    TetradeGame *opponent = game->opponent;
+    for(int i = 0; i < MAX_BOARDS && opponent != NULL && opponent != game; i++) {
+        if(!opponent->isGameOver)
+            return opponent;
+        opponent = opponent->opponent;
+    }
+    return NULL;
 }
 
 void set_music_speed_by_level(TetradeGame *game) {
-    int highestLevel = (game->opponent == NULL || game->level >= game->opponent->level ) ? game->level : game->opponent->level;
-    change_ch_sample_rate(0, musicSRsbyLevel[highestLevel]);
+    int highestLevel = game->level;
+    int speed = FIXED_ONE;
+
+    const TetradeGame *opponent = game->opponent;
+    for(int i = 0; i < MAX_BOARDS && opponent != NULL && opponent != game; i++) {
+        if(opponent->level > highestLevel)
+            highestLevel = opponent->level;
+        opponent = opponent->opponent;
+    }
+
+    for(int i = 0; i < highestLevel && speed < MUSIC_MAX_SPEED; i++) {
+        speed = MulFixed(speed, MUSIC_SPEED_PER_LEVEL);
+    }
+
+    set_music_speed((speed < MUSIC_MAX_SPEED) ? speed : MUSIC_MAX_SPEED);
 }
 
 // Check for complete rows, remove rows, add garbage, increase level, and score points.
@@ -383,9 +503,10 @@ void check_lines(TetradeGame *game) {
 
         if(isFullRow) {
             remove_row(row, MATRIX_HEIGHT, MATRIX_WIDTH, game->matrix);
-            //Adding garbage to a game overed opponent looks weird
-            if(game->opponent != NULL && !game->opponent->isGameOver) {
-                add_garbage(game->opponent->matrix);
+            //Adding garbage to a game overed opponent looks weird, it goes to the next one
+            TetradeGame *opponent = live_opponent(game);
+            if(opponent != NULL) {
+                add_garbage(opponent->matrix, &(opponent->rng));
             }
             
             linesCleared++;
@@ -393,7 +514,7 @@ void check_lines(TetradeGame *game) {
     }
     
     if(linesCleared > 0) {
-        play_sample(&(gameCtx.clear_sfx)); //Audio played here so not to stack
+        play_game_sfx(&(gameCtx.clear_sfx)); //Audio played here so not to stack
         int totalLines = game->singleLine + game->doubleLine*2 + game->tripleLine*3 + game->tetrade*4;
 
         if(totalLines >= (LEVEL_GOAL * (game->level+1))) {
@@ -473,6 +594,12 @@ void draw_tetrimino(const int x, const int y, const int minoWidth,
 }
 
 void draw_matrix(const int x, const int y, TetradeGame *game) {
+    TRACE_BEGIN(TRACE_DRAW_MATRIX, TRACE_TID_BOARD + game->controller);
+
+    int minoWidth = game->minoWidth;
+    Sprite *minos = game->isCompact ? gameCtx.tetriminoSmallSprites : gameCtx.tetriminoSprites;
+    Sprite *ghosts = game->isCompact ? gameCtx.tetriminoSmallGhostSprites : gameCtx.tetriminoGhostSprites;
+
     int startX = x;
     int startY = y;
     Sprite *sprite;
@@ -482,42 +609,58 @@ void draw_matrix(const int x, const int y, TetradeGame *game) {
             //Draw minos on matrix
             if(game->matrix[row][col] > 0) {
 
-                sprite = &(gameCtx.tetriminoSprites[game->matrix[row][col]-1]);
-                sprite->x = startX + MINO_WIDTH/2;
-                sprite->y = startY + MINO_WIDTH/2;
+                sprite = &(minos[game->matrix[row][col]-1]);
+                sprite->x = startX + minoWidth/2;
+                sprite->y = startY + minoWidth/2;
                 draw_sprite(sprite);
             }
             
-            startX += MINO_WIDTH;
+            startX += minoWidth;
         }
-        startY += MINO_WIDTH;
+        startY += minoWidth;
         startX = x;
     }
 
     if(game->tetrimino.type > 0) {
         //Current tetrimino
-        draw_tetrimino(x + (game->tetrimino.x * MINO_WIDTH), 
-                      y + (game->tetrimino.y * MINO_WIDTH), 
-                      MINO_WIDTH, 
+        draw_tetrimino(x + (game->tetrimino.x * minoWidth), 
+                      y + (game->tetrimino.y * minoWidth), 
+                      minoWidth, 
                       &(game->tetrimino), 
-                      gameCtx.tetriminoSprites,
+                      minos,
                       0);
         
         //Ghost tetrimino
-        draw_tetrimino(x + (game->tetrimino.x * MINO_WIDTH), 
-                      y + (game->ghostY * MINO_WIDTH), 
-                      MINO_WIDTH, 
+        draw_tetrimino(x + (game->tetrimino.x * minoWidth), 
+                      y + (game->ghostY * minoWidth), 
+                      minoWidth, 
                       &(game->tetrimino), 
-                      gameCtx.tetriminoGhostSprites,
+                      ghosts,
                       0);
     }
 
     print_text(&(gameCtx.scoreText), game->scoreX,  game->scoreY,  "%6d", game->score);
+    print_text(&(gameCtx.scoreText), game->levelX,  game->levelY,  "%6d", game->level);
+
+    //Compact boards only have room for the score, level, next and hold
+    if(game->isCompact) {
+        draw_tetrimino(game->nextXY[0][0], game->nextXY[0][1], MINO_SMALL_WIDTH, &(game->nextTetriminos[0]), gameCtx.tetriminoSmallSprites, 1);
+
+        if(game->holdTerimino.type > 0) {
+            draw_tetrimino(game->holdX, game->holdY, MINO_SMALL_WIDTH, &(game->holdTerimino), gameCtx.tetriminoSmallSprites, 1);
+        }
+
+        //There is no foreground art for them, added last so it's drawn under the minos
+        draw_tile((CVECTOR) {.r = 0, .g = 0, .b = 0}, x, y, MATRIX_WIDTH*MINO_SMALL_WIDTH, MATRIX_HEIGHT*MINO_SMALL_WIDTH);
+
+        TRACE_END(TRACE_DRAW_MATRIX, TRACE_TID_BOARD + game->controller);
+        return;
+    }
+
     print_text(&(gameCtx.scoreText), game->singleX, game->singleY, "%6d", game->singleLine);
     print_text(&(gameCtx.scoreText), game->doubleX, game->doubleY, "%6d", game->doubleLine);
     print_text(&(gameCtx.scoreText), game->tripleX, game->tripleY, "%6d", game->tripleLine);
     print_text(&(gameCtx.scoreText), game->tetrisX, game->tetrisY, "%6d", game->tetrade);
-    print_text(&(gameCtx.scoreText), game->levelX,  game->levelY,  "%6d", game->level);
 
 
     draw_tetrimino(game->nextXY[0][0], game->nextXY[0][1], MINO_WIDTH, &(game->nextTetriminos[0]), gameCtx.tetriminoSprites, 1);
@@ -527,6 +670,8 @@ void draw_matrix(const int x, const int y, TetradeGame *game) {
     if(game->holdTerimino.type > 0) {
         draw_tetrimino(game->holdX, game->holdY, MINO_SMALL_WIDTH, &(game->holdTerimino), gameCtx.tetriminoSmallSprites, 1);
     }
+
+    TRACE_END(TRACE_DRAW_MATRIX, TRACE_TID_BOARD + game->controller);
 }
 
 void swap(int *a, int *b) {
@@ -538,10 +683,10 @@ void swap(int *a, int *b) {
 // start: inclusive
 // end: exclusive
 // length: length of the array
-void shuffle_elements(const int start, const int end, const int length, int arr[length]) {
+void shuffle_elements(const int start, const int end, const int length, int arr[length], uint32_t *rng) {
     //Fisher-Yates shuffle
     for(int i = end-1; i > start; i--) {
-        int r = rand() % (i + 1) + start;
+        int r = random_int(rng, i + 1) + start;
         swap(&arr[i], &arr[r]);
     }
 }
@@ -626,58 +771,90 @@ void rotate_tetrimino(const int direction, TetradeGame *game) {
 
 }
 
-// Load Assets, intialize variables
-void init_game(Game *game) {
+// Load Assets, intialize variables. Returns 0 if something the game can't
+// run without didn't load.
+int init_game(Game *game) {
+
+    // Everything is read in one pass over the archive. Textures are
+    // streamed straight into VRam, samples into SPU RAM. The theme is
+    // streamed from the disc while it plays. The streams hold a row of
+    // carry each, too much for the stack.
+    static TimStream textures[NUM_TEXTURES];
+    PakLoad bootAssets[] = {
+        PAK_TEXTURE("SPRITES.TIM",  &textures[TEX_SPRITES]),
+        PAK_TEXTURE("TITLE.TIM",    &textures[TEX_TITLE]),
+        PAK_TEXTURE("BKG_L.TIM",    &textures[TEX_BACKGROUND_LEFT]),
+        PAK_TEXTURE("BKG_R.TIM",    &textures[TEX_BACKGROUND_RIGHT]),
+        PAK_TEXTURE("FG_L.TIM",     &textures[TEX_FOREGROUND_LEFT]),
+        PAK_TEXTURE("FG_R.TIM",     &textures[TEX_FOREGROUND_RIGHT]),
+
+        PAK_SAMPLE("CLICK.VAG",    &(game->click_sfx)),
+        PAK_SAMPLE("CONFIRM.VAG",  &(game->confirm_sfx)),
+        PAK_SAMPLE("PLACE.VAG",    &(game->place_sfx)),
+        PAK_SAMPLE("CLEAR.VAG",    &(game->clear_sfx)),
+        PAK_SAMPLE("NEGATIVE.VAG", &(game->negative_sfx)),
+        PAK_SAMPLE("HOLD.VAG",     &(game->hold_sfx)),
+    };
 
-    //Load Text
-    TIM_IMAGE textSheetImage;
-    extern uint32_t text_sheet_image[];
-    load_texture(text_sheet_image, &textSheetImage);
+    if(!open_pak(PAK_FILE_NAME)) {
+        printf("Error: %s could not be opened, is it on the disc?\n", PAK_FILE_NAME);
+        return 0;
+    }
+
+#if PAK_BENCH
+    bench_pak_scene(bootAssets, sizeof(bootAssets)/sizeof(PakLoad));
+#else
+    // SPU RAM carries on clearing while the textures stream in
+    PakScene bootScene;
+    queue_pak_scene(&bootScene, bootAssets, sizeof(bootAssets)/sizeof(PakLoad), NULL);
 
+    while(bootScene.req.status == CD_LOAD_QUEUED || bootScene.req.status == CD_LOAD_READING) {
+        update_cd_loader();
+        update_spu_ram_clear();
+    }
+#endif
+
+    init_sample_bank(&(game->sfxBank));
+    add_pak_samples_to_bank(&(game->sfxBank), bootAssets, sizeof(bootAssets)/sizeof(PakLoad));
+
+#if MUSIC_MODE == MUSIC_MODE_XA
+    open_music("\\THEME.XA;1");
+#elif MUSIC_MODE == MUSIC_MODE_SEQ
+    open_music("THEME.SEQ");
+#else
+    open_music("THEME.VAG");
+#endif
+
+#if DEBUG_MODE
+    // The boot scene is the longest streamed read, it should never have to
+    // seek back
+    printf("Boot scene: %d CD reseeks\n", get_cd_reseeks());
+    print_vram_usage();
+    print_spu_ram_usage();
+#endif
+
+    //Load Text
     int charNum = 95;
-    game->scoreText.spritesList = malloc(sizeof(Sprite)*charNum);
+    game->scoreText.spritesList = alloc_arena(&sceneArena, sizeof(Sprite)*charNum);
     char charList[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz1234567890!\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~";
-    load_text(&(game->scoreText), charList, &textSheetImage, 8, 8, charNum);
+    if(!load_text(&(game->scoreText), charList, &SPRITES_TEXT, &(textures[TEX_SPRITES].tim), charNum))
+        return 0;
 
     //Load title
-    TIM_IMAGE titleImage;
-    extern uint32_t title[];
-    load_texture(title, &titleImage);
-    load_sprite(&(game->title), &titleImage);
-
-    //Load Left Background
-    TIM_IMAGE backgroundLeftImage;
-    extern uint32_t background_left[];
-    load_texture(background_left, &backgroundLeftImage);
-    load_sprite(&(game->backgroundLeft), &backgroundLeftImage);
-
-    //Load Right Background
-    TIM_IMAGE backgroundRightImage;
-    extern uint32_t background_right[];
-    load_texture(background_right, &backgroundRightImage);
-    load_sprite(&(game->backgroundRight), &backgroundRightImage);
-
-    //Load Left Foreground
-    TIM_IMAGE foregroundLeftImage;
-    extern uint32_t foreground_left[];
-    load_texture(foreground_left, &foregroundLeftImage);
-    load_sprite(&(game->foregroundLeft), &foregroundLeftImage);
-
-    //Load Right Foreground
-    TIM_IMAGE foregroundRightImage;
-    extern uint32_t foreground_right[];
-    load_texture(foreground_right, &foregroundRightImage);
-    load_sprite(&(game->foregroundRight), &foregroundRightImage);
+    load_sprite(&(game->title), &(textures[TEX_TITLE].tim));
 
-    //Load Big Text
-    TIM_IMAGE bigFontImage;
-    extern uint32_t big_font[];
-    load_texture(big_font, &bigFontImage);
+    //Load Backgrounds and Foregrounds
+    load_sprite(&(game->backgroundLeft), &(textures[TEX_BACKGROUND_LEFT].tim));
+    load_sprite(&(game->backgroundRight), &(textures[TEX_BACKGROUND_RIGHT].tim));
+    load_sprite(&(game->foregroundLeft), &(textures[TEX_FOREGROUND_LEFT].tim));
+    load_sprite(&(game->foregroundRight), &(textures[TEX_FOREGROUND_RIGHT].tim));
 
+    //Load Big Text
     charNum = 39;
-    game->bigText.spritesList = malloc(sizeof(Sprite)*charNum);
+    game->bigText.spritesList = alloc_arena(&sceneArena, sizeof(Sprite)*charNum);
     char charList2[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890!?";
-    load_text(&(game->bigText), charList2, &bigFontImage, 16, 16, charNum);
+    if(!load_text(&(game->bigText), charList2, &SPRITES_BIG_FONT, &(textures[TEX_SPRITES].tim), charNum))
+        return 0;
 
     //Set background positions
     game->title.x = (SCREEN_WIDTH-game->title.w)/2;
@@ -697,44 +874,37 @@ void init_game(Game *game) {
 
 
     //Load Mino Sprites
-    TIM_IMAGE minosImage;
-    extern uint32_t blocks[];
-    load_texture(blocks, &minosImage);
-
-    TIM_IMAGE minosSmallImage;
-    extern uint32_t blocks_small[];
-    load_texture(blocks_small, &minosSmallImage);
-
     int numMinos = NUM_TETRIMINO_TYPES + NUM_TETRIMINO_EXTRAS;
     Sprite minos[numMinos*2];
     Sprite minosSmall[numMinos];
-    load_sprite_sheet(minos, MINO_WIDTH, MINO_WIDTH, numMinos*2, numMinos, &minosImage);
-    load_sprite_sheet(minosSmall, 4, 4, numMinos, numMinos, &minosSmallImage);
+
+    // Normal minos on the first row of the sheet, ghosts on the second
+    load_atlas_sheet(minos, numMinos*2, &SPRITES_BLOCKS, &(textures[TEX_SPRITES].tim));
+    load_atlas_sheet(minosSmall, numMinos, &SPRITES_BLOCKS_SMALL, &(textures[TEX_SPRITES].tim));
 
     for(int i = 0; i < numMinos; i++) {
         game->tetriminoSprites[i] = minos[i];
         game->tetriminoGhostSprites[i] = minos[numMinos + i];
         game->tetriminoSmallSprites[i] = minosSmall[i];
+
+        // There is no small ghost on the sheet, darken the small mino
+        game->tetriminoSmallGhostSprites[i] = minosSmall[i];
+        game->tetriminoSmallGhostSprites[i].color = (CVECTOR) {.r = 64, .g = 64, .b = 64};
     }
 
     game->isMusicPlaying = 0;
-    game->isRandomBag = 1;
+    game->settings.isRandomBag = 1;
     game->sfxVol = 11;
     game->musicVol = 5;
-    game->playerOneStart = 0;
-    game->playerTwoStart = 0;
+    game->settings.das = DEFAULT_DAS;
+    game->settings.arr = DEFAULT_ARR;
+    game->settings.sdf = DEFAULT_SDF;
+    for(int i = 0; i < MAX_BOARDS; i++) {
+        game->playerStart[i] = 0;
+    }
+    game->numBoards = 2;
     game->winner = -1;
 
-    //Audio
-    init_sample_byte(&(game->click_sfx), click);
-    init_sample_byte(&(game->confirm_sfx), confirm);
-    init_sample_byte(&(game->place_sfx), place);
-    init_sample_byte(&(game->clear_sfx), clear);
-    init_sample_byte(&(game->negative_sfx), negative);
-    init_sample_byte(&(game->hold_sfx), hold);
-    init_sample_byte(&(game->theme_song), theme);
-    
-
     game->click_sfx.volume    = volumeLevels[game->sfxVol];
     game->confirm_sfx.volume  = volumeLevels[game->sfxVol];
 
@@ -743,15 +913,26 @@ void init_game(Game *game) {
     
     game->negative_sfx.volume = volumeLevels[game->sfxVol];
     game->hold_sfx.volume     = volumeLevels[game->sfxVol];
-    game->theme_song.volume   = volumeLevels[game->musicVol];
+
+    // Auto-shift and soft drop click every few frames, two voices is
+    // enough for the repeats to overlap. Line clears always get heard.
+    game->click_sfx.priority    = VOICE_PRIORITY_LOW;
+    game->click_sfx.maxVoices   = 2;
+    game->place_sfx.maxVoices   = 2;
+    game->clear_sfx.priority    = VOICE_PRIORITY_HIGH;
+    game->confirm_sfx.priority  = VOICE_PRIORITY_HIGH;
 
     create_timer(&(game->mainTimer));
     game->gameState = START;
     game->menuState = PRESS_START;
 
+    return 1;
 }
 
-void reset_tetris_game(TetradeGame *game) {
+// Starts a board over with pieces drawn from seed
+void start_tetris_game(TetradeGame *game, const uint32_t seed) {
+    game->rng = seed;
+
     for(int row = 0; row < MATRIX_HEIGHT; row++) {
         for(int col = 0; col < MATRIX_WIDTH; col++) {
             game->matrix[row][col] = 0;
@@ -767,6 +948,7 @@ void reset_tetris_game(TetradeGame *game) {
     game->ghostY = 0;
     game->isGameOver = 0;
     game->isGamePaused = 0;
+    game->isOut = 0;
     game->m_u = MATRIX_HEIGHT-1;
     game->m_v = 0;
 
@@ -774,17 +956,17 @@ void reset_tetris_game(TetradeGame *game) {
     game->tetrimino.type = -1;
 
     
-    if(gameCtx.isRandomBag) {
+    if(game->settings->isRandomBag) {
         for(int i = 0; i < NUM_NEXT_TETRIMINOS; i += NUM_TETRIMINO_TYPES){
             int typeArr[] = {1, 2, 3, 4, 5, 6, 7 };
-            shuffle_elements(0, 7, 7, typeArr);
+            shuffle_elements(0, 7, 7, typeArr, &(game->rng));
             for(int k = 0; k < 7; k++) {
                 pick_tetrimino(&(game->nextTetriminos[i+k]), typeArr[k]);
             } 
         }
     } else {
         for(int i = 0; i < NUM_NEXT_TETRIMINOS; i++) {
-            set_random_tetrimino(&(game->nextTetriminos[i]));
+            set_random_tetrimino(&(game->nextTetriminos[i]), &(game->rng));
         }
     }
 
@@ -795,16 +977,49 @@ void reset_tetris_game(TetradeGame *game) {
     create_timer(&(game->pauseTimer));
     game->continueTimer.time = CONTINUE_TIME;
     game->pauseTimer.time = PAUSE_TIME;
-    game->moveCooldown = 0;
-
+    game->shiftDir = 0;
+    game->shiftTime = 0;
+}
 
+void reset_tetris_game(TetradeGame *game) {
+    start_tetris_game(game, (uint32_t)rand());
+}
 
+// Places a board for numBoards players. One or two boards get half the
+// screen each and line up with the foreground art, three or four get a
+// quarter each and are drawn with the small minos.
+void layout_board(TetradeGame *game, const int slot, const int numBoards) {
+    if(numBoards > 2) {
+        int width = SCREEN_WIDTH / numBoards;
+        int left = slot * width;
+        int textX = left + (width - 6*gameCtx.scoreText.charW)/2;
+
+        game->isCompact = 1;
+        game->minoWidth = MINO_SMALL_WIDTH;
+
+        game->matrixX = left + (width - MATRIX_WIDTH*MINO_SMALL_WIDTH)/2;
+        game->matrixY = 64;
+        game->nextXY[0][0] = game->matrixX + (MATRIX_WIDTH-4)*MINO_SMALL_WIDTH;
+        game->nextXY[0][1] = 40;
+        game->holdX = game->matrixX;
+        game->holdY = 40;
+        game->scoreX = textX;
+        game->scoreY = game->matrixY + MATRIX_HEIGHT*MINO_SMALL_WIDTH + 8;
+        game->levelX = textX;
+        game->levelY = game->scoreY + 10;
+        game->continueX = left;
+        game->continueY = 100;
+        // The start countdown is two characters of the small text, centred
+        // where the messages go. Line counts aren't drawn on compact boards.
+        game->continueCountX = left + (width - 2*gameCtx.scoreText.charW)/2;
+        game->continueCountY = game->continueY;
+        return;
+    }
 
-}
+    game->isCompact = 0;
+    game->minoWidth = MINO_WIDTH;
 
-// Set TetradeGame values.
-void init_tetris_game(TetradeGame *game, const int controller) {
-    if(controller) {
+    if(slot) {
         game->matrixX = 207;
         game->matrixY = 36;
         game->scoreX = 158;
@@ -863,9 +1078,15 @@ void init_tetris_game(TetradeGame *game, const int controller) {
         game->holdX = 7;
         game->holdY = 18;
     }
+}
+
+// Set TetradeGame values.
+void init_tetris_game(TetradeGame *game, const int controller) {
+    layout_board(game, controller, 2);
 
     game->opponent = NULL;
     game->controller = controller;
+    game->settings = &(gameCtx.settings);
 
     reset_tetris_game(game);
 }
@@ -878,6 +1099,117 @@ int last_valid_y(const TetradeGame *game) {
     return y;
 }
 
+// Furthest x the tetrimino can slide to in direction
+int last_valid_x(const TetradeGame *game, const int direction) {
+    int x = game->tetrimino.x;
+    while(is_valid_move(x+direction, game->tetrimino.y, &(game->tetrimino), game->matrix) && x >= -4 && x <= MATRIX_WIDTH) {
+        x += direction;
+    }
+    return x;
+}
+
+// A direction going down moves the piece once and starts auto-shift from
+// that frame
+static void _press_shift(TetradeGame *game, const int dir) {
+    game->shiftDir = dir;
+    game->shiftTime = 0;
+
+    if(game->tetrimino.type > 0 &&
+        is_valid_move(game->tetrimino.x+dir, game->tetrimino.y, &(game->tetrimino), game->matrix)) {
+        game->tetrimino.x += dir;
+        play_game_sfx(&(gameCtx.click_sfx));
+    }
+}
+
+// Shifts and rotates for buttons that went down together, shifting first.
+// Returns true if a direction was pressed.
+static int _press_buttons(TetradeGame *game, const uint16_t pressed) {
+    int dir = (pressed & PAD_LEFT) ? -1 : ((pressed & PAD_RIGHT) ? 1 : 0);
+
+    if(dir != 0)
+        _press_shift(game, dir);
+
+    // Rotate Clockwise
+    if(pressed & PAD_CIRCLE) {
+        rotate_tetrimino(1, game);
+    // Rotate Counterclockwise
+    } else if(pressed & PAD_CROSS) {
+        rotate_tetrimino(0, game);
+    }
+
+    return dir != 0;
+}
+
+// Delayed auto-shift. A direction moves once the frame it goes down (see
+// _press_shift), then after DAS frames every ARR frames, counted from that
+// frame rather than the game timer. The last direction pressed wins,
+// releasing it hands back to the other if that is still held. isPressed is
+// set when a direction went down this frame.
+void shift_tetrimino(TetradeGame *game, const int isPressed) {
+    int controller = game->controller;
+    int leftHeld = button_held(controller, PAD_LEFT);
+    int rightHeld = button_held(controller, PAD_RIGHT);
+    int dir = game->shiftDir;
+
+    if(isPressed)
+        return;
+
+    if((dir < 0 && !leftHeld) || (dir > 0 && !rightHeld)) {
+        dir = leftHeld ? -1 : (rightHeld ? 1 : 0);
+    }
+
+    if(dir != game->shiftDir) {
+        game->shiftDir = dir;
+        game->shiftTime = 0;
+    } else if(dir != 0) {
+        game->shiftTime++;
+    }
+
+    if(dir == 0 || game->tetrimino.type <= 0)
+        return;
+
+    int time = game->shiftTime;
+    int x = game->tetrimino.x;
+
+    if(time == 0) {
+        if(is_valid_move(x+dir, game->tetrimino.y, &(game->tetrimino), game->matrix))
+            x += dir;
+    } else if(time >= game->settings->das) {
+        // With no repeat delay the piece sits against the wall while held
+        if(game->settings->arr == 0) {
+            x = last_valid_x(game, dir);
+        } else if((time - game->settings->das) % game->settings->arr == 0 &&
+            is_valid_move(x+dir, game->tetrimino.y, &(game->tetrimino), game->matrix)) {
+            x += dir;
+        }
+    }
+
+    if(x != game->tetrimino.x) {
+        game->tetrimino.x = x;
+        play_game_sfx(&(gameCtx.click_sfx));
+    }
+}
+
+// Keeps a marathon score if it makes the table
+void add_high_score(const TetradeGame *game) {
+    HighScore *scores = gameCtx.highScores;
+    int i = NUM_HIGH_SCORES;
+
+    if(game->score <= 0)
+        return;
+
+    while(i > 0 && scores[i-1].score < (uint32_t)game->score)
+        i--;
+
+    if(i >= NUM_HIGH_SCORES)
+        return;
+
+    memmove(&scores[i+1], &scores[i], (NUM_HIGH_SCORES - 1 - i) * sizeof(HighScore));
+    scores[i].score = game->score;
+    scores[i].level = game->level;
+    scores[i].lines = game->singleLine + 2*game->doubleLine + 3*game->tripleLine + 4*game->tetrade;
+}
+
 // return 0 - reset game
 // return 1 - continue game
 int lose_game(TetradeGame *game) {
@@ -906,17 +1238,18 @@ int lose_game(TetradeGame *game) {
             return 0;
         }
 
-        print_text(&(gameCtx.bigText), game->continueX, game->continueY, "CONTINUE?");
-        print_text(&(gameCtx.bigText), game->continueCountX, game->continueCountY, "%2d", TimerSeconds(&(game->continueTimer)));
-
-        if(button_down(game->controller, PAD_START)) {
-            reset_tetris_game(game);
+        // The board's own generator picks the next seed, so a replay
+        // continues the same way
+        if(button_pressed(game->controller, PAD_START)) {
+            if(gameCtx.gameState == REGULAR)
+                add_high_score(game);
+            start_tetris_game(game, game->rng);
             game->isGameOver = 0;
             set_music_speed_by_level(game);
         }
 
         //Do not continue, just lose
-        if(button_down(game->controller, PAD_CIRCLE)) {
+        if(button_pressed(game->controller, PAD_CIRCLE)) {
             return 0;
         }
 
@@ -931,26 +1264,23 @@ int lose_game(TetradeGame *game) {
     return 1;
 }
 
-int play_game(TetradeGame *game) {
+// Runs one frame of a board's game logic without drawing anything, so it
+// can be stepped again for rollback. Everything it depends on is in the
+// TetradeGame and the pad's frame.
+int step_game(TetradeGame *game) {
  
     //Stall game if in game over state
     if(game->isGameOver) {
-        int isContinue = lose_game(game);
-        //Draw matrix after so lose game continue text appears on top
-        draw_matrix(game->matrixX, game->matrixY, game);
-        return isContinue;
+        return lose_game(game);
     }
     int controller = game->controller;
 
     //Pause game. Should not pause when in VERSUS mode
-    if(!game->isGamePaused && game->opponent == NULL && button_down(controller, PAD_START)) {
+    if(!game->isGamePaused && game->opponent == NULL && button_pressed(controller, PAD_START)) {
         game->isGamePaused = 1;
 
     } else if(game->isGamePaused) {
-        print_text(&(gameCtx.bigText), game->continueX+16, game->continueY, "PAUSED");
-        draw_matrix(game->matrixX, game->matrixY, game);
-
-        if(button_down(controller, PAD_START)) {
+        if(button_pressed(controller, PAD_START)) {
             game->isGamePaused = 0;
             game->pauseTimer.time = PAUSE_TIME;
         }
@@ -960,70 +1290,47 @@ int play_game(TetradeGame *game) {
 
     //Countdown timer when game is unpaused
     if(game->pauseTimer.time > 1) {
-        print_text(&(gameCtx.bigText), game->continueCountX, game->continueCountY, "%2d", TimerSeconds(&(game->pauseTimer)));
         game->pauseTimer.time--;
-        draw_matrix(game->matrixX, game->matrixY, game);
         return 1;
     }
     
     int isSoftDropping = 0;
-
-    // Move Piece Left
-    if(button_down(controller, PAD_LEFT)) {
-        if(is_valid_move(game->tetrimino.x-1, game->tetrimino.y, &(game->tetrimino), game->matrix)) {
-            game->tetrimino.x--;
-            game->moveCooldown = TETRIMINO_MOVE_COOLDOWN;
-            play_sample(&(gameCtx.click_sfx));
-        }
-    // Move Piece Left continuously
-    } else if(button_pressed(controller, PAD_LEFT)) {
-        if(is_valid_move(game->tetrimino.x-1, game->tetrimino.y, &(game->tetrimino), game->matrix) &&
-            (game->gameTimer.time%TETRIMINO_HORZ_SPEED == 0) && game->moveCooldown <= 0) {
-            game->tetrimino.x--;
-            play_sample(&(gameCtx.click_sfx));
-        }
-    // Move Piece Right
-    } else if(button_down(controller, PAD_RIGHT)) {
-        if(is_valid_move(game->tetrimino.x+1, game->tetrimino.y, &(game->tetrimino), game->matrix)) {
-            game->tetrimino.x++;
-            game->moveCooldown = TETRIMINO_MOVE_COOLDOWN;
-            play_sample(&(gameCtx.click_sfx));
-        }
-    // Move Piece Right continuously
-    } else if(button_pressed(controller, PAD_RIGHT)) {
-        if(is_valid_move(game->tetrimino.x+1, game->tetrimino.y, &(game->tetrimino), game->matrix) &&
-            (game->gameTimer.time%TETRIMINO_HORZ_SPEED == 0) && game->moveCooldown <= 0) {
-            game->tetrimino.x++;
-            play_sample(&(gameCtx.click_sfx));
-        }
-    } 
+    int isShiftPressed = 0;
+
+    // Move Piece Left/Right and rotate
+#if INPUT_SUBFRAME
+    // Every press is played in the order it happened, so two taps inside a
+    // frame shift twice and a shift then a rotation isn't turned around
+    const InputEvent *events;
+    int numEvents = get_input_events(controller, &events);
+
+    for(int i = 0; i < numEvents; i++) {
+        if(events[i].isDown)
+            isShiftPressed |= _press_buttons(game, events[i].buttons);
+    }
+#else
+    isShiftPressed = _press_buttons(game, get_input_frame(controller)->pressed);
+#endif
+    shift_tetrimino(game, isShiftPressed);
     
     // Soft Drop
-    if(button_pressed(controller, PAD_DOWN)) {
+    if(button_held(controller, PAD_DOWN)) {
         isSoftDropping = 1;
     }
-    
-    // Rotate Clockwise
-    if(button_down(controller, PAD_CIRCLE)) {
-        rotate_tetrimino(1, game);
-    // Rotate Counterclockwise
-    } else if (button_down(controller, PAD_CROSS)) {
-        rotate_tetrimino(0, game);
-    }
 
     // Hard Drop
-    if(button_down(controller, PAD_UP)) {
+    if(button_pressed(controller, PAD_UP)) {
         int y = last_valid_y(game);
         game->score += (y - game->tetrimino.y) * HARD_DROP_SCORE;
         game->tetrimino.y = y;
         place_tetrimino(&(game->tetrimino), game->matrix);
         game->tetrimino.type = -1;
-        play_sample(&(gameCtx.place_sfx));
+        play_game_sfx(&(gameCtx.place_sfx));
 
     // Hold
-    }else if(button_down(controller, PAD_SQUARE) || 
-             button_down(controller, PAD_L1)     ||
-             button_down(controller, PAD_R1)) {
+    }else if(button_pressed(controller, PAD_SQUARE) || 
+             button_pressed(controller, PAD_L1)     ||
+             button_pressed(controller, PAD_R1)) {
         if((game->tetrimino.type > 0) && !(game->tetrimino.wasHeld)) {
             Tetrimino temp = game->holdTerimino;
             game->holdTerimino = game->tetrimino;
@@ -1035,9 +1342,9 @@ int play_game(TetradeGame *game) {
             game->tetrimino.x = CENTER;
             game->tetrimino.y = 0;
 
-            play_sample(&(gameCtx.hold_sfx));
+            play_game_sfx(&(gameCtx.hold_sfx));
         } else if(game->tetrimino.wasHeld) {
-            play_sample(&(gameCtx.negative_sfx));
+            play_game_sfx(&(gameCtx.negative_sfx));
         }
     }
 
@@ -1051,11 +1358,11 @@ int play_game(TetradeGame *game) {
         game->nextTCount--;
 
         // Replace removed tetriminos
-        if(gameCtx.isRandomBag) {
+        if(game->settings->isRandomBag) {
             if(game->nextTCount <= NUM_TETRIMINO_TYPES) {
 
                 int typeArr[] = {1, 2, 3, 4, 5, 6, 7};
-                shuffle_elements(0, 7, 7, typeArr);
+                shuffle_elements(0, 7, 7, typeArr, &(game->rng));
                 for(int i = 0; i < 7; i++) {
                     pick_tetrimino(&(game->nextTetriminos[NUM_TETRIMINO_TYPES+i]), typeArr[i]);
                 }  
@@ -1064,7 +1371,7 @@ int play_game(TetradeGame *game) {
             }
         } else {
             // Last next tetrimino is empty, replace it.
-            set_random_tetrimino(&(game->nextTetriminos[NUM_NEXT_TETRIMINOS-1]));
+            set_random_tetrimino(&(game->nextTetriminos[NUM_NEXT_TETRIMINOS-1]), &(game->rng));
         }
         
         // If can't place current tetrimino, lose game
@@ -1075,9 +1382,23 @@ int play_game(TetradeGame *game) {
         }
     }
 
-    int dropRate = SOFT_DROP_RATE;
-    if(!isSoftDropping)
-        dropRate = (game->level > 0) ? FixedToInt(DivFixed(IntToFixed(BASE_DROP_RATE),(LEVEL_DROP_RATE_MULTI * game->level))) : BASE_DROP_RATE;
+    int dropRate = (game->level > 0) ? FixedToInt(DivFixed(IntToFixed(BASE_DROP_RATE),(LEVEL_DROP_RATE_MULTI * game->level))) : BASE_DROP_RATE;
+    if(isSoftDropping && game->settings->sdf > 0) {
+        dropRate /= game->settings->sdf;
+        if(dropRate < 1)
+            dropRate = 1;
+    }
+
+    // Instant soft drop, falls to the floor but doesn't lock like a hard drop
+    if(isSoftDropping && game->settings->sdf == 0 && game->tetrimino.type > 0) {
+        int y = last_valid_y(game);
+        if(y != game->tetrimino.y) {
+            game->score += (y - game->tetrimino.y) * SOFT_DROP_SCORE;
+            game->tetrimino.y = y;
+            game->setTime = TETRIMINO_SET_TIME;
+            play_game_sfx(&(gameCtx.click_sfx));
+        }
+    }
     
     // Movement down
     if(game->tetrimino.type > 0 && game->gameTimer.time%dropRate == 0) {
@@ -1086,11 +1407,11 @@ int play_game(TetradeGame *game) {
             game->setTime = TETRIMINO_SET_TIME;
             if(isSoftDropping) {
                 game->score += SOFT_DROP_SCORE;
-                play_sample(&(gameCtx.click_sfx));
+                play_game_sfx(&(gameCtx.click_sfx));
             }
         } else if(game->setTime <= 0) {
             place_tetrimino(&(game->tetrimino), game->matrix);
-            play_sample(&(gameCtx.place_sfx));
+            play_game_sfx(&(gameCtx.place_sfx));
             game->tetrimino.type = -1;
         }
     }
@@ -1102,20 +1423,364 @@ int play_game(TetradeGame *game) {
     
     check_lines(game);
 
-    if(game->moveCooldown > 0)
-        game->moveCooldown--;
-
     game->gameTimer.time++;
 
-    draw_matrix(game->matrixX, game->matrixY, game);
     return 1;
 }
 
+// PRESS START or WAITING over a board that isn't playing yet. Compact
+// boards are too narrow for the big text.
+void print_board_message(TetradeGame *game, const char *line1, const char *line2) {
+    if(game->isCompact) {
+        int width = SCREEN_WIDTH / gameCtx.numBoards;
+        int charW = gameCtx.scoreText.charW;
+        print_text(&(gameCtx.scoreText), game->continueX + (width - (int)strlen(line1)*charW)/2, game->continueY, "%s", line1);
+        if(line2 != NULL)
+            print_text(&(gameCtx.scoreText), game->continueX + (width - (int)strlen(line2)*charW)/2, game->continueY+10, "%s", line2);
+        return;
+    }
+
+    if(line2 != NULL) {
+        print_text(&(gameCtx.bigText), game->continueX+32, game->continueY,    "%s", line1);
+        print_text(&(gameCtx.bigText), game->continueX+32, game->continueY+18, "%s", line2);
+    } else {
+        print_text(&(gameCtx.bigText), game->continueX+16, game->continueY,    "%s", line1);
+    }
+}
+
+void draw_game(TetradeGame *game) {
+    // Compact boards are too narrow for a big text countdown
+    TextSprite *countText = game->isCompact ? &(gameCtx.scoreText) : &(gameCtx.bigText);
+
+    if(game->isGameOver) {
+        //Only after all minos are changed show continue countdown. In VERSUS mode, there are no continues.
+        if(game->gameTimer.time > 120 && game->opponent == NULL) {
+            if(game->isCompact)
+                print_board_message(game, "CONTINUE?", NULL);
+            else
+                print_text(&(gameCtx.bigText), game->continueX, game->continueY, "CONTINUE?");
+            print_text(countText, game->continueCountX, game->continueCountY + (game->isCompact ? 10 : 0), "%2d", TimerSeconds(&(game->continueTimer)));
+        }
+    } else if(game->isGamePaused) {
+        print_board_message(game, "PAUSED", NULL);
+    } else if(game->pauseTimer.time > 1) {
+        print_text(countText, game->continueCountX, game->continueCountY, "%2d", TimerSeconds(&(game->pauseTimer)));
+    }
+
+    //Draw matrix after so text appears on top
+    draw_matrix(game->matrixX, game->matrixY, game);
+}
+
+int play_game(TetradeGame *game) {
+    TRACE_BEGIN(TRACE_PLAY_GAME, TRACE_TID_BOARD + game->controller);
+    uint32_t start = get_system_time_us();
+    int primStart = get_prim_bytes();
+    int isContinue = step_game(game);
+    draw_game(game);
+    game->drawCost = (int)(get_system_time_us() - start);
+    game->primCost = get_prim_bytes() - primStart;
+    TRACE_END(TRACE_PLAY_GAME, TRACE_TID_BOARD + game->controller);
+
+#if DEBUG_MODE
+    int budget = game->isCompact ? COMPACT_BOARD_PRIM_BUDGET : BOARD_PRIM_BUDGET;
+    if(game->primCost > budget)
+        printf("Board %d drew %d primitive bytes, over its budget of %d.\n", 
+            game->controller + 1, game->primCost, budget);
+#endif
+
+    return isContinue;
+}
+
+// A marathon's board 0 as the buttons its pad held each frame. Played back
+// from its seed and settings the board does exactly the same.
+typedef struct _Replay {
+    uint32_t seed;
+    uint32_t score;         // Where it ended
+    uint8_t isRandomBag, das, arr, sdf;
+    uint16_t startHeld;     // The pad the frame before the first
+    uint16_t length;        // Bytes of runs used
+
+    // Runs of three bytes, the buttons low byte first, then the 1-255
+    // frames they were held for
+    uint8_t runs[REPLAY_MAX_BYTES];
+} Replay;
+
+// The BIOS card manager's title and icon, the first two sectors of a file
+typedef struct _SaveTitle {
+    char magic[2];          // "SC"
+    uint8_t iconFlags;      // 0x11, an icon of one frame
+    uint8_t blocks;
+    uint8_t title[64];      // Shift-JIS
+    uint8_t _reserved[28];
+    uint16_t clut[16];
+    uint8_t icon[128];      // 16x16, 4 bits a pixel
+} SaveTitle;
+
+typedef struct _SaveData {
+    SaveTitle title;
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;          // Bytes in use from the start of the file
+    uint32_t checksum;      // Sum of the bytes after it up to size
+
+    uint8_t isRandomBag, das, arr, sdf;
+    uint8_t sfxVol, musicVol;
+    uint8_t _reserved[2];
+    HighScore highScores[NUM_HIGH_SCORES];
+    Replay replay;          // Written up to its length
+} SaveData;
+
+static SaveData saveData;       // Read into and written from by saveJob
+static CardJob saveJob;
+static int isSaveLoaded = 0;    // Nothing is written before the card is read
+static int isSavePending = 0;   // Asked to save while saveJob was busy
+
+static Replay lastReplay;       // Played back by Replay, saved with the rest
+static Replay recording;
+static int isRecording = 0;
+
+static int replayPos;           // Next run
+static int replayLeft;          // Frames left of the current run
+static uint16_t replayHeld;
+static PlayerSettings replaySettings;
+
+static int _clamp_setting(const int value, const int min, const int max) {
+    return (value < min) ? min : (value > max) ? max : value;
+}
+
+// Full width Shift-JIS of the title, the card manager can't show ASCII
+static void _to_sjis(uint8_t *out, const int len, const char *text) {
+    int n = 0;
+
+    memset(out, 0, len);
+    for(; *text && n + 2 <= len; text++) {
+        char c = *text;
+        int code = 0x8140; // Space
+
+        if(c >= 'A' && c <= 'Z')
+            code = 0x8260 + (c - 'A');
+        else if(c >= 'a' && c <= 'z')
+            code = 0x8281 + (c - 'a');
+        else if(c >= '0' && c <= '9')
+            code = 0x824f + (c - '0');
+
+        out[n++] = code >> 8;
+        out[n++] = code;
+    }
+}
+
+// A T piece, purple with a dark outline
+static void _draw_save_icon(SaveTitle *title) {
+    title->clut[1] = 20 | (28 << 10);
+    title->clut[2] = 10 | (14 << 10);
+
+    for(int y = 0; y < 16; y++) {
+        for(int x = 0; x < 16; x++) {
+            int col = (x - 2) / 4, row = y / 4;
+            int isMino = (x >= 2) && ((row == 1 && col <= 2) || (row == 2 && col == 1));
+            int isEdge = ((x - 2) % 4 == 0) || ((x - 2) % 4 == 3) || (y % 4 == 0) || (y % 4 == 3);
+            int pixel = isMino ? (isEdge ? 2 : 1) : 0;
+
+            title->icon[(y*16 + x)/2] |= pixel << ((x & 1) * 4);
+        }
+    }
+}
+
+static uint32_t _save_checksum(const SaveData *save) {
+    const uint8_t *bytes = (const uint8_t*)save;
+    uint32_t sum = 0;
+
+    for(int i = offsetof(SaveData, checksum) + sizeof(save->checksum); i < save->size; i++)
+        sum += bytes[i];
+
+    return sum;
+}
+
+static int _is_save_valid(const SaveData *save) {
+    return save->magic == SAVE_MAGIC && save->version == SAVE_VERSION &&
+        save->size == offsetof(SaveData, replay.runs) + save->replay.length &&
+        save->replay.length <= REPLAY_MAX_BYTES &&
+        save->checksum == _save_checksum(save);
+}
+
+static void _apply_sfx_volume(void) {
+    gameCtx.click_sfx.volume    = volumeLevels[gameCtx.sfxVol];
+    gameCtx.confirm_sfx.volume  = volumeLevels[gameCtx.sfxVol];
+    gameCtx.place_sfx.volume    = volumeLevels[gameCtx.sfxVol];
+    gameCtx.clear_sfx.volume    = volumeLevels[gameCtx.sfxVol];
+    gameCtx.negative_sfx.volume = volumeLevels[gameCtx.sfxVol];
+    gameCtx.hold_sfx.volume     = volumeLevels[gameCtx.sfxVol];
+}
+
+void save_to_card(void);
+
+static void _save_done(CardJob *job) {
+    if(isSavePending) {
+        isSavePending = 0;
+        save_to_card();
+    }
+}
+
+static void _load_done(CardJob *job) {
+    isSaveLoaded = 1;
+
+    if(job->status == CARD_JOB_DONE && _is_save_valid(&saveData)) {
+        // Settings changed before the card was read win
+        if(!isSavePending) {
+            gameCtx.settings.isRandomBag = saveData.isRandomBag != 0;
+            gameCtx.settings.das = _clamp_setting(saveData.das, 1, MAX_DAS);
+            gameCtx.settings.arr = _clamp_setting(saveData.arr, 0, MAX_ARR);
+            gameCtx.settings.sdf = _clamp_setting(saveData.sdf, 0, MAX_SDF);
+            gameCtx.sfxVol = _clamp_setting(saveData.sfxVol, 0, 11);
+            gameCtx.musicVol = _clamp_setting(saveData.musicVol, 0, 11);
+
+            _apply_sfx_volume();
+            set_music_volume(volumeLevels[gameCtx.musicVol]);
+        }
+
+        memcpy(gameCtx.highScores, saveData.highScores, sizeof(gameCtx.highScores));
+        memcpy(&lastReplay, &(saveData.replay), offsetof(Replay, runs) + saveData.replay.length);
+        printf("Save loaded, %d bytes.\n", saveData.size);
+    }
+
+    if(isSavePending) {
+        isSavePending = 0;
+        save_to_card();
+    }
+}
+
+// Starts reading the save, call once at boot
+void load_from_card(void) {
+    init_card_job(&saveJob, SAVE_CARD_PORT, SAVE_FILE_NAME);
+    saveJob.buffer = (uint8_t*)&saveData;
+    saveJob.size = sizeof(SaveData);
+    saveJob.onComplete = &_load_done;
+
+    if(!queue_card_job(&saveJob))
+        isSaveLoaded = 1;
+}
+
+// Writes the settings, high scores and replay in the background. While a
+// write is going the next is held back until it's done.
+void save_to_card(void) {
+    if(!isSaveLoaded || saveJob.status == CARD_JOB_QUEUED || saveJob.status == CARD_JOB_BUSY) {
+        isSavePending = 1;
+        return;
+    }
+
+    SaveData *save = &saveData;
+
+    memset(&(save->title), 0, sizeof(SaveTitle));
+    save->title.magic[0] = 'S';
+    save->title.magic[1] = 'C';
+    save->title.iconFlags = 0x11;
+    save->title.blocks = SAVE_BLOCKS;
+    _to_sjis(save->title.title, sizeof(save->title.title), "TETRADE");
+    _draw_save_icon(&(save->title));
+
+    save->magic = SAVE_MAGIC;
+    save->version = SAVE_VERSION;
+    save->isRandomBag = gameCtx.settings.isRandomBag;
+    save->das = gameCtx.settings.das;
+    save->arr = gameCtx.settings.arr;
+    save->sdf = gameCtx.settings.sdf;
+    save->sfxVol = gameCtx.sfxVol;
+    save->musicVol = gameCtx.musicVol;
+    save->_reserved[0] = save->_reserved[1] = 0;
+    memcpy(save->highScores, gameCtx.highScores, sizeof(save->highScores));
+    memcpy(&(save->replay), &lastReplay, offsetof(Replay, runs) + lastReplay.length);
+
+    save->size = offsetof(SaveData, replay.runs) + lastReplay.length;
+    save->checksum = _save_checksum(save);
+
+    init_card_job(&saveJob, SAVE_CARD_PORT, SAVE_FILE_NAME);
+    saveJob.isWrite = 1;
+    saveJob.buffer = (uint8_t*)save;
+    saveJob.size = save->size;
+    saveJob.blocks = SAVE_BLOCKS;
+    saveJob.onComplete = &_save_done;
+
+    queue_card_job(&saveJob);
+}
+
+int is_saving(void) {
+    return saveJob.isWrite && (saveJob.status == CARD_JOB_QUEUED || saveJob.status == CARD_JOB_BUSY);
+}
+
+// Records board 0 from its first frame, pad is its pad that frame
+void start_recording(const uint32_t seed, const InputFrame *pad) {
+#if INPUT_SUBFRAME
+    // Replays keep a frame's held buttons, not the presses inside it that
+    // the game plays, so they would come out different
+    return;
+#endif
+    recording.seed = seed;
+    recording.isRandomBag = gameCtx.settings.isRandomBag;
+    recording.das = gameCtx.settings.das;
+    recording.arr = gameCtx.settings.arr;
+    recording.sdf = gameCtx.settings.sdf;
+    recording.startHeld = (pad->held & ~pad->pressed) | pad->released;
+    recording.length = 0;
+    isRecording = 1;
+}
+
+// Adds a frame of buttons. A replay that runs out of room stops there.
+void record_frame(const uint16_t held) {
+    if(!isRecording)
+        return;
+
+    if(recording.length >= 3) {
+        uint8_t *run = &recording.runs[recording.length - 3];
+
+        if((run[0] | (run[1] << 8)) == held && run[2] < 255) {
+            run[2]++;
+            return;
+        }
+    }
+
+    if(recording.length + 3 > REPLAY_MAX_BYTES)
+        return;
+
+    recording.runs[recording.length++] = held;
+    recording.runs[recording.length++] = held >> 8;
+    recording.runs[recording.length++] = 1;
+}
+
+// Keeps the recording as the replay to save and play back
+void end_recording(const TetradeGame *game) {
+    if(isRecording && recording.length > 0) {
+        recording.score = game->score;
+        memcpy(&lastReplay, &recording, offsetof(Replay, runs) + recording.length);
+    }
+
+    isRecording = 0;
+}
+
+// The next frame's buttons, -1 once the replay is over
+static int _next_replay_frame(void) {
+    if(replayLeft == 0) {
+        if(replayPos + 3 > lastReplay.length)
+            return -1;
+
+        replayHeld = lastReplay.runs[replayPos] | (lastReplay.runs[replayPos + 1] << 8);
+        replayLeft = lastReplay.runs[replayPos + 2];
+        replayPos += 3;
+    }
+
+    replayLeft--;
+    return replayHeld;
+}
+
 void play_start_menu(void) {
     draw_sprite(&(gameCtx.title));
     if(gameCtx.menuState == PRESS_START) {
         print_text(&(gameCtx.scoreText), 116, 140,  "Press Start");
-        if(button_down(0, PAD_START)) {
+
+        for(int i = 0; i < 3 && gameCtx.highScores[i].score > 0; i++) {
+            print_text(&(gameCtx.scoreText), 92, 165 + i*10, "%d. %7d  Lv %2d", 
+                i + 1, (int)gameCtx.highScores[i].score, gameCtx.highScores[i].level);
+        }
+        if(button_pressed(0, PAD_START)) {
             gameCtx.menuState = MAIN_MENU;
             play_sample(&(gameCtx.confirm_sfx));
             printf("Seed: %d\n", gameCtx.mainTimer.time);
@@ -1124,12 +1789,14 @@ void play_start_menu(void) {
     } else if(gameCtx.menuState == MAIN_MENU) {
         print_text(&(gameCtx.scoreText), 108, 140,  "Marathon Mode ");
         print_text(&(gameCtx.scoreText), 108, 150,  "Versus Mode ");
-        print_text(&(gameCtx.scoreText), 108, 160,  "Options ");
-        if(button_down(0, PAD_UP)) {
+        print_text(&(gameCtx.scoreText), 108, 160,  "Link Versus ");
+        print_text(&(gameCtx.scoreText), 108, 170,  "Replay ");
+        print_text(&(gameCtx.scoreText), 108, 180,  "Options ");
+        if(button_pressed(0, PAD_UP)) {
             gameCtx.selectedOption = (gameCtx.selectedOption - 1 + MAIN_MENU_OPTIONS) % MAIN_MENU_OPTIONS;
             play_sample(&(gameCtx.click_sfx));
         }
-        if(button_down(0, PAD_DOWN)) {
+        if(button_pressed(0, PAD_DOWN)) {
             gameCtx.selectedOption = (gameCtx.selectedOption + 1) % MAIN_MENU_OPTIONS;
             play_sample(&(gameCtx.click_sfx));
         }
@@ -1142,13 +1809,32 @@ void play_start_menu(void) {
                 print_text(&(gameCtx.scoreText), 100, 150,  ">Versus Mode<");
                 break;
             case 2:
-                print_text(&(gameCtx.scoreText), 100, 160,  ">Options<");
+                print_text(&(gameCtx.scoreText), 100, 160,  ">Link Versus<");
+                break;
+            case 3:
+                print_text(&(gameCtx.scoreText), 100, 170,  ">Replay<");
+                break;
+            case 4:
+                print_text(&(gameCtx.scoreText), 100, 180,  ">Options<");
                 break;
             default:
                 printf("Selection Error. Selection Option: %d\n", gameCtx.selectedOption);
         }
 
-        if(button_down(0, PAD_CROSS) || button_down(0, PAD_START)) {
+        if(button_pressed(0, PAD_CROSS) || button_pressed(0, PAD_START)) {
+            // Nothing to play back until a marathon is recorded
+            if(gameCtx.selectedOption == 3 && lastReplay.length == 0) {
+                play_sample(&(gameCtx.negative_sfx));
+                return;
+            }
+
+            // Link play only sends each frame's held buttons, the other
+            // console would miss taps shorter than a frame
+            if(gameCtx.selectedOption == 2 && INPUT_SUBFRAME) {
+                play_sample(&(gameCtx.negative_sfx));
+                return;
+            }
+
             play_sample(&(gameCtx.confirm_sfx));
             switch(gameCtx.selectedOption) {
                 case 0:
@@ -1160,6 +1846,14 @@ void play_start_menu(void) {
                     printf("Versus Mode!\n");
                     break;
                 case 2:
+                    gameCtx.gameState = LINK;
+                    printf("Link Versus!\n");
+                    break;
+                case 3:
+                    gameCtx.gameState = REPLAY;
+                    printf("Replay!\n");
+                    break;
+                case 4:
                     gameCtx.menuState = OPTIONS;
                     gameCtx.selectedOption = 0;
                     printf("Options!\n");
@@ -1171,17 +1865,23 @@ void play_start_menu(void) {
     } else if(gameCtx.menuState == OPTIONS) {
 
         print_text(&(gameCtx.scoreText), 40, 140,  
-                    "Random Generator: %3s ", ((gameCtx.isRandomBag) ? "Random Bag" : "Pure Random"));
+                    "Random Generator: %3s ", ((gameCtx.settings.isRandomBag) ? "Random Bag" : "Pure Random"));
         print_text(&(gameCtx.scoreText), 40, 150, "SFX Volume:   ");
         draw_squares(150, 150, 4, 8, 2, gameCtx.sfxVol);
         print_text(&(gameCtx.scoreText), 40, 160, "Music Volume: ");
         draw_squares(150, 160, 4, 8, 2, gameCtx.musicVol);
-
-        if(button_down(0, PAD_UP)) {
+        print_text(&(gameCtx.scoreText), 40, 170, "Auto-Shift Delay: %2d", gameCtx.settings.das);
+        print_text(&(gameCtx.scoreText), 40, 180, "Auto-Repeat Rate: %2d", gameCtx.settings.arr);
+        if(gameCtx.settings.sdf > 0)
+            print_text(&(gameCtx.scoreText), 40, 190, "Soft Drop Speed:  x%d", gameCtx.settings.sdf);
+        else
+            print_text(&(gameCtx.scoreText), 40, 190, "Soft Drop Speed:  Instant");
+
+        if(button_pressed(0, PAD_UP)) {
             gameCtx.selectedOption = (gameCtx.selectedOption - 1 + OPTIONS_MENU_OPTIONS) % OPTIONS_MENU_OPTIONS;
             play_sample(&(gameCtx.click_sfx));
         }
-        if(button_down(0, PAD_DOWN)) {
+        if(button_pressed(0, PAD_DOWN)) {
             gameCtx.selectedOption = (gameCtx.selectedOption + 1) % OPTIONS_MENU_OPTIONS;
             play_sample(&(gameCtx.click_sfx));
         }
@@ -1189,14 +1889,14 @@ void play_start_menu(void) {
         switch(gameCtx.selectedOption) {
             case 0:
                 print_text(&(gameCtx.scoreText), 32, 140,  ">");
-                if(button_down(0, PAD_CROSS) || button_down(0, PAD_START)) {
+                if(button_pressed(0, PAD_CROSS) || button_pressed(0, PAD_START)) {
                     play_sample(&(gameCtx.confirm_sfx));
-                    gameCtx.isRandomBag = !gameCtx.isRandomBag;
+                    gameCtx.settings.isRandomBag = !gameCtx.settings.isRandomBag;
                 }
                 break;
             case 1:
                 print_text(&(gameCtx.scoreText), 32, 150,  ">");
-                if(button_down(0, PAD_LEFT) && gameCtx.sfxVol > 0) {
+                if(button_pressed(0, PAD_LEFT) && gameCtx.sfxVol > 0) {
                     gameCtx.sfxVol--;
 
                     gameCtx.click_sfx.volume    = volumeLevels[gameCtx.sfxVol];
@@ -1209,7 +1909,7 @@ void play_start_menu(void) {
                     play_sample(&(gameCtx.confirm_sfx));
                 }
 
-                if(button_down(0, PAD_RIGHT) && gameCtx.sfxVol < 11) {
+                if(button_pressed(0, PAD_RIGHT) && gameCtx.sfxVol < 11) {
                     gameCtx.sfxVol++;
 
                     gameCtx.click_sfx.volume    = volumeLevels[gameCtx.sfxVol];
@@ -1224,59 +1924,105 @@ void play_start_menu(void) {
                 break;
             case 2:
                 print_text(&(gameCtx.scoreText), 32, 160,  ">");
-                if(button_down(0, PAD_LEFT) && gameCtx.musicVol > 0) {
+                if(button_pressed(0, PAD_LEFT) && gameCtx.musicVol > 0) {
                     gameCtx.musicVol--;
-                    gameCtx.theme_song.volume  = volumeLevels[gameCtx.musicVol];
+                    set_music_volume(volumeLevels[gameCtx.musicVol]);
 
                     gameCtx.confirm_sfx.volume = volumeLevels[gameCtx.musicVol];
                     play_sample(&(gameCtx.confirm_sfx));
                     gameCtx.confirm_sfx.volume = volumeLevels[gameCtx.sfxVol];
                 }
 
-                if(button_down(0, PAD_RIGHT) && gameCtx.musicVol < 11) {
+                if(button_pressed(0, PAD_RIGHT) && gameCtx.musicVol < 11) {
                     gameCtx.musicVol++;
-                    gameCtx.theme_song.volume  = volumeLevels[gameCtx.musicVol];
+                    set_music_volume(volumeLevels[gameCtx.musicVol]);
 
                     gameCtx.confirm_sfx.volume = volumeLevels[gameCtx.musicVol];
                     play_sample(&(gameCtx.confirm_sfx));
                     gameCtx.confirm_sfx.volume = volumeLevels[gameCtx.sfxVol];
                 }
                 break;
+            case 3:
+                print_text(&(gameCtx.scoreText), 32, 170,  ">");
+                if(button_pressed(0, PAD_LEFT) && gameCtx.settings.das > 1) {
+                    gameCtx.settings.das--;
+                    play_sample(&(gameCtx.click_sfx));
+                }
+                if(button_pressed(0, PAD_RIGHT) && gameCtx.settings.das < MAX_DAS) {
+                    gameCtx.settings.das++;
+                    play_sample(&(gameCtx.click_sfx));
+                }
+                break;
+            case 4:
+                print_text(&(gameCtx.scoreText), 32, 180,  ">");
+                if(button_pressed(0, PAD_LEFT) && gameCtx.settings.arr > 0) {
+                    gameCtx.settings.arr--;
+                    play_sample(&(gameCtx.click_sfx));
+                }
+                if(button_pressed(0, PAD_RIGHT) && gameCtx.settings.arr < MAX_ARR) {
+                    gameCtx.settings.arr++;
+                    play_sample(&(gameCtx.click_sfx));
+                }
+                break;
+            case 5:
+                // Past the fastest factor is instant
+                print_text(&(gameCtx.scoreText), 32, 190,  ">");
+                if(button_pressed(0, PAD_LEFT) && gameCtx.settings.sdf != 1) {
+                    gameCtx.settings.sdf = (gameCtx.settings.sdf == 0) ? MAX_SDF : gameCtx.settings.sdf - 1;
+                    play_sample(&(gameCtx.click_sfx));
+                }
+                if(button_pressed(0, PAD_RIGHT) && gameCtx.settings.sdf != 0) {
+                    gameCtx.settings.sdf = (gameCtx.settings.sdf == MAX_SDF) ? 0 : gameCtx.settings.sdf + 1;
+                    play_sample(&(gameCtx.click_sfx));
+                }
+                break;
             default:
                 printf("Selection Error. Selection Option: %d\n", gameCtx.selectedOption);
         }
 
-        if(button_down(0, PAD_CIRCLE)) {
+        if(button_pressed(0, PAD_CIRCLE)) {
             gameCtx.menuState = MAIN_MENU;
             gameCtx.selectedOption = 0;
             play_sample(&(gameCtx.confirm_sfx));
+            save_to_card();
         }
     }
+
+    if(is_saving())
+        print_text(&(gameCtx.scoreText), 16, 220, "Saving...");
 } 
 
 void play_regular_mode(TetradeGame *gameOne, TetradeGame *gameTwo) {
     int isContinue1 = 0;
     int isContinue2 = 0;
     
-    if(!gameCtx.playerOneStart) {
-        play_sample(&(gameCtx.theme_song));
+    if(!gameCtx.playerStart[0]) {
+        play_music(volumeLevels[gameCtx.musicVol]);
         gameCtx.isMusicPlaying = 1;
-        gameCtx.playerOneStart = 1;
-        reset_tetris_game(gameOne);
+        gameCtx.playerStart[0] = 1;
+
+        uint32_t seed = (uint32_t)rand();
+        start_tetris_game(gameOne, seed);
+        start_recording(seed, get_input_frame(0));
     }
 
-    if(!gameCtx.playerTwoStart && button_down(1, PAD_START)) {            
-        gameCtx.playerTwoStart = 1;
+    if(!gameCtx.playerStart[1] && button_pressed(1, PAD_START)) {            
+        gameCtx.playerStart[1] = 1;
         play_sample(&(gameCtx.confirm_sfx));
         reset_tetris_game(gameTwo);
     }
 
-    if(gameCtx.playerOneStart) {
+    if(gameCtx.playerStart[0]) {
+        record_frame(get_input_frame(0)->held);
         isContinue1 = play_game(gameOne);
         draw_sprite(&(gameCtx.foregroundLeft));
+
+        // The replay ends with board 0's game
+        if(!isContinue1)
+            end_recording(gameOne);
     }
 
-    if(gameCtx.playerTwoStart) {
+    if(gameCtx.playerStart[1]) {
         isContinue2 = play_game(gameTwo);
         draw_sprite(&(gameCtx.foregroundRight));
     } else {
@@ -1284,151 +2030,793 @@ void play_regular_mode(TetradeGame *gameOne, TetradeGame *gameTwo) {
         print_text(&(gameCtx.bigText), gameTwo->continueX+32, gameTwo->continueY+18, "START");
     }
 
-    if((!isContinue1 && gameCtx.playerOneStart) && 
-        ((!isContinue2 && gameCtx.playerTwoStart) || !gameCtx.playerTwoStart)) {
+    if((!isContinue1 && gameCtx.playerStart[0]) && 
+        ((!isContinue2 && gameCtx.playerStart[1]) || !gameCtx.playerStart[1])) {
+
+        add_high_score(gameOne);
+        if(gameCtx.playerStart[1])
+            add_high_score(gameTwo);
+        save_to_card();
 
         gameCtx.gameState = START;
-        gameCtx.playerOneStart = 0;
-        gameCtx.playerTwoStart = 0;
+        gameCtx.playerStart[0] = 0;
+        gameCtx.playerStart[1] = 0;
         reset_tetris_game(gameOne);
         reset_tetris_game(gameTwo);
-        stop_channel(gameCtx.theme_song.channel);
+        stop_music();
         gameCtx.isMusicPlaying = 0;
     }
 }
 
-void play_versus_mode(TetradeGame *gameOne, TetradeGame *gameTwo) {
-    int isContinue1 = 0;
-    int isContinue2 = 0;
-    
-    if(!gameCtx.playerOneStart && button_down(0, PAD_START)) {
-        gameCtx.playerOneStart = 1;
-        gameOne->opponent = gameTwo;
-        play_sample(&(gameCtx.confirm_sfx));
-        reset_tetris_game(gameOne);
+// Lays out the boards for numBoards players
+void layout_boards(TetradeGame boards[MAX_BOARDS], const int numBoards) {
+    gameCtx.numBoards = numBoards;
+    for(int i = 0; i < MAX_BOARDS; i++) {
+        layout_board(&boards[i], i, numBoards);
     }
+}
 
-    if(!gameCtx.playerTwoStart && button_down(1, PAD_START)) {            
-        gameCtx.playerTwoStart = 1;
-        gameTwo->opponent = gameOne;
-        play_sample(&(gameCtx.confirm_sfx));
-        reset_tetris_game(gameTwo);
+// Last board standing wins. When the last ones go out on the same frame it
+// is the first of those, never a board that was already out. Returns how
+// many boards are still playing.
+int update_winner(const int isPlaying[], const int numBoards) {
+    int numPlaying = 0;
+    int last = -1;
+
+    for(int i = 0; i < numBoards; i++) {
+        if(isPlaying[i]) {
+            numPlaying++;
+            last = i;
+        }
     }
 
-    if(gameCtx.playerOneStart && !gameCtx.playerTwoStart) {
-        print_text(&(gameCtx.bigText), gameOne->continueX+16, gameOne->continueY,    "WAITING");
-        
-    } else if(!gameCtx.playerOneStart) {
-        print_text(&(gameCtx.bigText), gameOne->continueX+32, gameOne->continueY,    "PRESS");
-        print_text(&(gameCtx.bigText), gameOne->continueX+32, gameOne->continueY+18, "START");
+    if(numPlaying == 0) {
+        for(int i = 0; i < numBoards && last < 0; i++) {
+            if(!boards[i].isOut)
+                last = i;
+        }
     }
 
-    if(gameCtx.playerTwoStart && !gameCtx.playerOneStart) {
-        print_text(&(gameCtx.bigText), gameTwo->continueX+16, gameTwo->continueY,    "WAITING");
-        
-    } else if(!gameCtx.playerTwoStart) {
-        print_text(&(gameCtx.bigText), gameTwo->continueX+32, gameTwo->continueY,    "PRESS");
-        print_text(&(gameCtx.bigText), gameTwo->continueX+32, gameTwo->continueY+18, "START");
+    for(int i = 0; i < numBoards; i++) {
+        if(!isPlaying[i])
+            boards[i].isOut = 1;
     }
 
-    if(button_down(0, PAD_CIRCLE) && (!gameCtx.playerOneStart || !gameCtx.playerTwoStart)) {
-        gameCtx.gameState = START;
-        gameCtx.playerOneStart = 0;
-        gameCtx.playerTwoStart = 0;
-        play_sample(&(gameCtx.confirm_sfx));
-    }   
+    if(gameCtx.winner < 0 && numPlaying <= 1 && last >= 0)
+        gameCtx.winner = last;
 
-    if(gameCtx.playerOneStart && gameCtx.playerTwoStart) {
-        //Make sure to draw matrix when game is not running.
-        if(gameCtx.winner >= 0) {
-            draw_matrix(gameOne->matrixX, gameOne->matrixY, gameOne);
-            draw_matrix(gameTwo->matrixX, gameTwo->matrixY, gameTwo);
-        } else {
-            isContinue1 = play_game(gameOne);
-            isContinue2 = play_game(gameTwo);
+    return numPlaying;
+}
+
+void end_versus_mode(TetradeGame boards[MAX_BOARDS]) {
+    gameCtx.gameState = START;
+    for(int i = 0; i < MAX_BOARDS; i++) {
+        gameCtx.playerStart[i] = 0;
+    }
+    layout_boards(boards, 2);
+}
+
+// Every pad plugged in gets a board, two to four of them
+void play_versus_mode(TetradeGame boards[MAX_BOARDS]) {
+    int isContinue[MAX_BOARDS] = {0};
+    int numStarted = 0;
+
+    for(int i = 0; i < gameCtx.numBoards; i++) {
+        numStarted += gameCtx.playerStart[i];
+    }
+
+    //Players can still plug in until someone presses start
+    if(numStarted == 0) {
+        int numBoards = get_num_pads();
+        numBoards = (numBoards < 2) ? 2 : ((numBoards > MAX_BOARDS) ? MAX_BOARDS : numBoards);
+
+        if(numBoards != gameCtx.numBoards)
+            layout_boards(boards, numBoards);
+    }
+
+    int numBoards = gameCtx.numBoards;
+
+    for(int i = 0; i < numBoards; i++) {
+        if(!gameCtx.playerStart[i] && button_pressed(i, PAD_START)) {
+            gameCtx.playerStart[i] = 1;
+            //Garbage goes to the next board round
+            boards[i].opponent = &boards[(i + 1) % numBoards];
+            play_sample(&(gameCtx.confirm_sfx));
+            reset_tetris_game(&boards[i]);
+            numStarted++;
+        }
+    }
+
+    if(numStarted < numBoards) {
+        for(int i = 0; i < numBoards; i++) {
+            if(gameCtx.playerStart[i]) {
+                print_board_message(&boards[i], "WAITING", NULL);
+            } else {
+                print_board_message(&boards[i], "PRESS", "START");
+            }
         }
-        
-        draw_sprite(&(gameCtx.foregroundLeft));
-        draw_sprite(&(gameCtx.foregroundRight));
 
-        if(!gameCtx.isMusicPlaying) {
-            play_sample(&(gameCtx.theme_song));
-            gameCtx.isMusicPlaying = 1;
+        if(button_pressed(0, PAD_CIRCLE)) {
+            end_versus_mode(boards);
+            play_sample(&(gameCtx.confirm_sfx));
+        }
+        return;
+    }
+
+    //Make sure to draw matrix when game is not running.
+    if(gameCtx.winner >= 0) {
+        for(int i = 0; i < numBoards; i++) {
+            draw_matrix(boards[i].matrixX, boards[i].matrixY, &boards[i]);
+        }
+    } else {
+        for(int i = 0; i < numBoards; i++) {
+            isContinue[i] = play_game(&boards[i]);
         }
+    }
 
-        if(!isContinue2 && gameCtx.winner < 0)
-            gameCtx.winner = 0;
+    if(numBoards <= 2) {
+        draw_sprite(&(gameCtx.foregroundLeft));
+        draw_sprite(&(gameCtx.foregroundRight));
+    }
 
-        if(!isContinue1 && gameCtx.winner < 0)
-            gameCtx.winner = 1;
-        
-        if(gameCtx.winner == 0)
-            print_text(&(gameCtx.bigText), 52, 208, "PLAYER 1 WINS!");
-        
-        if(gameCtx.winner == 1)
-            print_text(&(gameCtx.bigText), 52, 208, "PLAYER 2 WINS!");
+    if(!gameCtx.isMusicPlaying) {
+        play_music(volumeLevels[gameCtx.musicVol]);
+        gameCtx.isMusicPlaying = 1;
     }
 
-    if((!isContinue1 && gameCtx.playerOneStart) && (!isContinue2 && gameCtx.playerTwoStart)) {
+    int numPlaying = update_winner(isContinue, numBoards);
+
+    if(gameCtx.winner >= 0)
+        print_text(&(gameCtx.bigText), 52, 208, "PLAYER %d WINS!", gameCtx.winner + 1);
+
+    if(numPlaying == 0) {
         print_text(&(gameCtx.scoreText), 116, 226, "Press Start");
-        if(button_down(0, PAD_START)) {
-            gameCtx.gameState = START;
-            gameCtx.playerOneStart = 0;
-            gameCtx.playerTwoStart = 0;
-            reset_tetris_game(gameOne);
-            reset_tetris_game(gameTwo);
+        if(button_pressed(0, PAD_START)) {
+            for(int i = 0; i < numBoards; i++) {
+                reset_tetris_game(&boards[i]);
+            }
+            end_versus_mode(boards);
             gameCtx.winner = -1;
-            stop_channel(gameCtx.theme_song.channel);
+            stop_music();
             gameCtx.isMusicPlaying = 0;
         }
     }
 }
 
+void end_replay_mode(void) {
+    TetradeGame *game = &boards[0];
+
+    gameCtx.gameState = START;
+    gameCtx.playerStart[0] = 0;
+    game->settings = &(gameCtx.settings);
+    reset_tetris_game(game);
+    stop_music();
+    gameCtx.isMusicPlaying = 0;
+}
+
+// Plays the last marathon back on board 0, its pad's buttons are replaced
+// with the recorded ones. Select stops it.
+void play_replay_mode(void) {
+    TetradeGame *game = &boards[0];
+    int isStopped = button_pressed(0, PAD_SELECT);
+
+    if(!gameCtx.playerStart[0]) {
+        replaySettings.isRandomBag = lastReplay.isRandomBag;
+        replaySettings.das = lastReplay.das;
+        replaySettings.arr = lastReplay.arr;
+        replaySettings.sdf = lastReplay.sdf;
+        game->settings = &replaySettings;
+        start_tetris_game(game, lastReplay.seed);
+
+        replayPos = 0;
+        replayLeft = 0;
+        replayHeld = lastReplay.startHeld;
+
+        play_music(volumeLevels[gameCtx.musicVol]);
+        gameCtx.isMusicPlaying = 1;
+        gameCtx.playerStart[0] = 1;
+    }
+
+    uint16_t lastHeld = replayHeld;
+    int held = _next_replay_frame();
+
+    if(held < 0 || isStopped) {
+        end_replay_mode();
+        return;
+    }
+
+    set_input_frame(0, held, lastHeld);
+    int isContinue = play_game(game);
+    draw_sprite(&(gameCtx.foregroundLeft));
+    print_board_message(&boards[1], "REPLAY", NULL);
+
+    if(!isContinue)
+        end_replay_mode();
+}
+
+// Packed copy of a board's game state, everything step_game reads or writes
+// and nothing it doesn't. Layout, controller, settings and sprites belong to
+// the board slot and are left alone by restore_board. The opponent is kept
+// as an index into boards. ~160 bytes against several KB for a TetradeGame.
+typedef struct _BoardSnapshot {
+    uint8_t matrix[MATRIX_HEIGHT*MATRIX_WIDTH/2];    // Two cells a byte, low nibble first
+    uint8_t next[NUM_NEXT_TETRIMINOS/2];            // Types, two a byte
+    uint16_t shape;     // Current tetrimino's minos, bit row*4 + col
+    int8_t type;        // Current tetrimino, <= 0 for none
+    int8_t x, y;
+    uint8_t rotState;
+    uint8_t wasHeld;
+    int8_t holdType;
+    uint8_t nextTCount;
+    int8_t opponent;    // Index in boards, -1 for none
+
+    uint32_t score;
+    uint16_t singleLine, doubleLine, tripleLine, tetrade;
+    uint16_t level;
+    uint8_t setTime;
+    int8_t ghostY;
+    uint8_t isGameOver;
+    uint8_t isGamePaused;
+    uint8_t isOut;
+    int8_t m_u, m_v;
+    int8_t shiftDir;
+    uint32_t shiftTime;
+
+    uint32_t gameTime;
+    uint16_t continueTime;
+    uint16_t pauseTime;
+    uint32_t rng;
+} BoardSnapshot;
+
+// Every board of a match and the state they share
+typedef struct _MatchSnapshot {
+    BoardSnapshot boards[MAX_BOARDS];
+    uint8_t numBoards;
+    int8_t winner;
+} MatchSnapshot;
+
+void save_board(const TetradeGame *game, BoardSnapshot *snap) {
+    const int *cells = &(game->matrix[0][0]);
+
+    for(int i = 0; i < MATRIX_HEIGHT*MATRIX_WIDTH/2; i++) {
+        snap->matrix[i] = cells[2*i] | (cells[2*i + 1] << 4);
+    }
+
+    for(int i = 0; i < NUM_NEXT_TETRIMINOS/2; i++) {
+        snap->next[i] = game->nextTetriminos[2*i].type | (game->nextTetriminos[2*i + 1].type << 4);
+    }
+
+    const Tetrimino *t = &(game->tetrimino);
+    snap->shape = 0;
+    for(int row = 0; row < 4; row++) {
+        for(int col = 0; col < 4; col++) {
+            if(t->shape[row][col])
+                snap->shape |= 1 << (row*4 + col);
+        }
+    }
+    snap->type = t->type;
+    snap->x = t->x;
+    snap->y = t->y;
+    snap->rotState = t->rotState;
+    snap->wasHeld = t->wasHeld;
+    snap->holdType = game->holdTerimino.type;
+    snap->nextTCount = game->nextTCount;
+    snap->opponent = (game->opponent != NULL) ? (game->opponent - boards) : -1;
+
+    snap->score = game->score;
+    snap->singleLine = game->singleLine;
+    snap->doubleLine = game->doubleLine;
+    snap->tripleLine = game->tripleLine;
+    snap->tetrade = game->tetrade;
+    snap->level = game->level;
+    snap->setTime = game->setTime;
+    snap->ghostY = game->ghostY;
+    snap->isGameOver = game->isGameOver;
+    snap->isGamePaused = game->isGamePaused;
+    snap->isOut = game->isOut;
+    snap->m_u = game->m_u;
+    snap->m_v = game->m_v;
+    snap->shiftDir = game->shiftDir;
+    snap->shiftTime = game->shiftTime;
+
+    snap->gameTime = game->gameTimer.time;
+    snap->continueTime = game->continueTimer.time;
+    snap->pauseTime = game->pauseTimer.time;
+    snap->rng = game->rng;
+}
+
+// Picks a tetrimino of type, or marks it empty
+static void _restore_tetrimino(Tetrimino *tetrimino, const int type) {
+    if(type > 0)
+        pick_tetrimino(tetrimino, type);
+    else
+        tetrimino->type = type;
+}
+
+void restore_board(TetradeGame *game, const BoardSnapshot *snap) {
+    int *cells = &(game->matrix[0][0]);
+
+    for(int i = 0; i < MATRIX_HEIGHT*MATRIX_WIDTH/2; i++) {
+        cells[2*i] = snap->matrix[i] & 0xf;
+        cells[2*i + 1] = snap->matrix[i] >> 4;
+    }
+
+    // Queued and held pieces are always as picked
+    for(int i = 0; i < NUM_NEXT_TETRIMINOS/2; i++) {
+        _restore_tetrimino(&(game->nextTetriminos[2*i]), snap->next[i] & 0xf);
+        _restore_tetrimino(&(game->nextTetriminos[2*i + 1]), snap->next[i] >> 4);
+    }
+    _restore_tetrimino(&(game->holdTerimino), snap->holdType);
+
+    Tetrimino *t = &(game->tetrimino);
+    for(int row = 0; row < 4; row++) {
+        for(int col = 0; col < 4; col++) {
+            t->shape[row][col] = (snap->shape >> (row*4 + col)) & 1;
+        }
+    }
+    t->type = snap->type;
+    t->x = snap->x;
+    t->y = snap->y;
+    t->rotState = snap->rotState;
+    t->wasHeld = snap->wasHeld;
+    game->nextTCount = snap->nextTCount;
+    game->opponent = (snap->opponent >= 0) ? &boards[(int)snap->opponent] : NULL;
+
+    game->score = snap->score;
+    game->singleLine = snap->singleLine;
+    game->doubleLine = snap->doubleLine;
+    game->tripleLine = snap->tripleLine;
+    game->tetrade = snap->tetrade;
+    game->level = snap->level;
+    game->setTime = snap->setTime;
+    game->ghostY = snap->ghostY;
+    game->isGameOver = snap->isGameOver;
+    game->isGamePaused = snap->isGamePaused;
+    game->isOut = snap->isOut;
+    game->m_u = snap->m_u;
+    game->m_v = snap->m_v;
+    game->shiftDir = snap->shiftDir;
+    game->shiftTime = snap->shiftTime;
+
+    game->gameTimer.time = snap->gameTime;
+    game->continueTimer.time = snap->continueTime;
+    game->pauseTimer.time = snap->pauseTime;
+    game->rng = snap->rng;
+}
+
+void save_match(MatchSnapshot *snap, const int numBoards) {
+    for(int i = 0; i < numBoards; i++) {
+        save_board(&boards[i], &(snap->boards[i]));
+    }
+    snap->numBoards = numBoards;
+    snap->winner = gameCtx.winner;
+}
+
+void restore_match(const MatchSnapshot *snap) {
+    for(int i = 0; i < snap->numBoards; i++) {
+        restore_board(&boards[i], &(snap->boards[i]));
+    }
+    gameCtx.winner = snap->winner;
+}
+
+// Versus against another console over the link cable, see engine/netplay.h.
+// Both consoles step both boards from the two pads' inputs, board 0 is
+// the console that won the coin toss when connecting.
+
+static MatchSnapshot linkSnapshots[NETPLAY_SAVE_SLOTS];
+static PlayerSettings linkSettings; // The other player's
+static int linkPlayer = -1;         // Board played from this console, -1 when not linked
+static int isLinkOpen = 0;
+
+static void _link_start(const uint32_t seed, const int player, const uint8_t *peerHello) {
+    linkPlayer = player;
+
+    linkSettings.isRandomBag = peerHello[0];
+    linkSettings.das = peerHello[1];
+    linkSettings.arr = peerHello[2];
+    linkSettings.sdf = peerHello[3];
+
+    //Both boards get the same pieces
+    for(int i = 0; i < NETPLAY_PLAYERS; i++) {
+        boards[i].controller = i;
+        boards[i].settings = (i == player) ? &(gameCtx.settings) : &linkSettings;
+        boards[i].opponent = &boards[!i];
+        start_tetris_game(&boards[i], seed);
+    }
+
+    gameCtx.winner = -1;
+    play_music(volumeLevels[gameCtx.musicVol]);
+    gameCtx.isMusicPlaying = 1;
+}
+
+static void _link_save(const int slot) {
+    save_match(&linkSnapshots[slot], NETPLAY_PLAYERS);
+}
+
+static void _link_load(const int slot) {
+    restore_match(&linkSnapshots[slot]);
+}
+
+static void _link_step(const uint16_t inputs[NETPLAY_PLAYERS], const uint16_t lastInputs[NETPLAY_PLAYERS],
+    const int isReplay) {
+
+    //Boards read their player's input as that pad
+    for(int i = 0; i < NETPLAY_PLAYERS; i++) {
+        set_input_frame(i, inputs[i], lastInputs[i]);
+    }
+
+    if(gameCtx.winner >= 0)
+        return;
+
+    isReplaying = isReplay;
+
+    int isPlaying[NETPLAY_PLAYERS];
+    for(int i = 0; i < NETPLAY_PLAYERS; i++) {
+        isPlaying[i] = step_game(&boards[i]);
+    }
+
+    isReplaying = 0;
+
+    update_winner(isPlaying, NETPLAY_PLAYERS);
+}
+
+static const NetplayCallbacks linkCallbacks = {
+    .start = &_link_start,
+    .save  = &_link_save,
+    .load  = &_link_load,
+    .step  = &_link_step
+};
+
+void end_link_mode(void) {
+    stop_netplay();
+    isLinkOpen = 0;
+    linkPlayer = -1;
+
+    for(int i = 0; i < NETPLAY_PLAYERS; i++) {
+        boards[i].controller = i;
+        boards[i].settings = &(gameCtx.settings);
+        boards[i].opponent = NULL;
+        reset_tetris_game(&boards[i]);
+    }
+
+    gameCtx.gameState = START;
+    gameCtx.winner = -1;
+    stop_music();
+    gameCtx.isMusicPlaying = 0;
+}
+
+void play_link_mode(void) {
+    //Pad 0 is overwritten with board 0's input by the steps, keep our own
+    InputFrame pad = *get_input_frame(0);
+
+    if(!isLinkOpen) {
+        uint8_t hello[NETPLAY_HELLO_LEN] = {
+            gameCtx.settings.isRandomBag, gameCtx.settings.das, gameCtx.settings.arr, gameCtx.settings.sdf
+        };
+
+        layout_boards(boards, 2);
+        start_netplay(&linkCallbacks, hello);
+        isLinkOpen = 1;
+    }
+
+    NetplayState state = update_netplay(pad.held);
+
+    if(state == NETPLAY_CONNECTING) {
+        print_text(&(gameCtx.bigText), 76, 100, "CONNECTING");
+        print_text(&(gameCtx.scoreText), 96, 140, "Circle to cancel");
+
+        if(pad.pressed & PAD_CIRCLE) {
+            play_sample(&(gameCtx.confirm_sfx));
+            end_link_mode();
+        }
+        return;
+    }
+
+    for(int i = 0; i < NETPLAY_PLAYERS; i++) {
+        draw_game(&boards[i]);
+    }
+
+    draw_sprite(&(gameCtx.foregroundLeft));
+    draw_sprite(&(gameCtx.foregroundRight));
+
+    print_text(&(gameCtx.scoreText), boards[linkPlayer].continueX+40, 22, "YOU");
+
+    if(state == NETPLAY_LOST) {
+        print_text(&(gameCtx.bigText), 88, 208, "LINK LOST");
+    } else if(gameCtx.winner >= 0) {
+        print_text(&(gameCtx.bigText), 52, 208, "PLAYER %d WINS!", gameCtx.winner + 1);
+    }
+
+    if(state == NETPLAY_LOST || gameCtx.winner >= 0) {
+        print_text(&(gameCtx.scoreText), 116, 226, "Press Start");
+        if(pad.pressed & PAD_START) {
+            end_link_mode();
+        }
+    }
+
+    #if DEBUG_MODE
+        NetplayStats stats;
+        get_netplay_stats(&stats);
+        FntPrint(fnt, "Link frame %d ahead %d rollback %d max %d\n", 
+            stats.frame, stats.frame - stats.confirmed, stats.rollback, stats.maxRollback);
+        FntPrint(fnt, "Stalls %d bad %d dropped %d, %d us\n", 
+            stats.stalls, stats.badPackets, serial_dropped(), stats.updateUs);
+    #endif
+}
+
+// Updates and draws a frame of whatever the game is doing, up to display
+void play_frame(void) {
+    if(gameCtx.gameState == START) {
+        play_start_menu();
+    } else if(gameCtx.gameState == REGULAR) { 
+        play_regular_mode(&boards[0], &boards[1]);
+    } else if(gameCtx.gameState == VERSUS) {
+        play_versus_mode(boards);
+    } else if(gameCtx.gameState == LINK) {
+        play_link_mode();
+    } else if(gameCtx.gameState == REPLAY) {
+        play_replay_mode();
+    }
+
+    draw_sprite(&(gameCtx.backgroundLeft));
+    draw_sprite(&(gameCtx.backgroundRight));
+    
+    gameCtx.mainTimer.time++;
+}
+
+#if BENCH_MODE
+
+// Frames each scenario is timed for
+#define BENCH_FRAMES 32
+#define BENCH_SEED 12345
+#define CYCLES_PER_FRAME (F_CPU / VYSNC_RATE)
+
+// Writing the exit code here closes PCSX-Redux when it runs with -testmode
+#define PCSX_EXIT_CODE _MMIO16(0x1f802082)
+
+typedef struct _BenchScenario {
+    const char *name;
+    void (*setup)(void);    // Puts the game back in the same state every frame
+} BenchScenario;
+
+// Fills the bottom rows of a board, one hole per row unless isFull
+static void _bench_fill_rows(TetradeGame *game, const int from, const int to, const int isFull) {
+    for(int row = from; row < to; row++) {
+        for(int col = 0; col < MATRIX_WIDTH; col++) {
+            game->matrix[MATRIX_HEIGHT-1-row][col] = 1 + (row + col) % NUM_TETRIMINO_TYPES;
+        }
+        if(!isFull)
+            game->matrix[MATRIX_HEIGHT-1-row][(row * 7) % MATRIX_WIDTH] = 0;
+    }
+}
+
+// A board mid-game with a T falling from the top and a piece held
+static void _bench_board(TetradeGame *game, const int stackHeight) {
+    game->settings = &(gameCtx.settings);
+    start_tetris_game(game, BENCH_SEED + game->controller);
+    _bench_fill_rows(game, 0, stackHeight, 0);
+
+    pick_tetrimino(&(game->tetrimino), 7);
+    pick_tetrimino(&(game->holdTerimino), 1);
+    game->level = 5;
+    game->score = 123456;
+    game->setTime = TETRIMINO_SET_TIME;
+    game->pauseTimer.time = 0;
+}
+
+static void _bench_game_state(const GameState state, const int numStarted) {
+    gameCtx.gameState = state;
+    gameCtx.menuState = MAIN_MENU;
+    gameCtx.selectedOption = 0;
+    gameCtx.winner = -1;
+    gameCtx.isMusicPlaying = 1;
+
+    layout_boards(boards, (numStarted > 2) ? numStarted : 2);
+    for(int i = 0; i < MAX_BOARDS; i++) {
+        gameCtx.playerStart[i] = (i < numStarted);
+        boards[i].opponent = NULL;
+        set_input_frame(i, 0, 0);
+    }
+}
+
+static void _bench_menu(void) {
+    _bench_game_state(START, 0);
+}
+
+// Marathon with the stack two rows from the top
+static void _bench_full_board(void) {
+    _bench_game_state(REGULAR, 1);
+    _bench_board(&boards[0], MATRIX_HEIGHT-2);
+    start_recording(BENCH_SEED, get_input_frame(0));
+}
+
+static void _bench_versus_boards(void) {
+    _bench_game_state(VERSUS, 2);
+    boards[0].opponent = &boards[1];
+    boards[1].opponent = &boards[0];
+    _bench_board(&boards[0], 10);
+    _bench_board(&boards[1], 10);
+}
+
+// Board 1 clears four lines, four rows of garbage go to board 2
+static void _bench_tetris(void) {
+    _bench_versus_boards();
+    _bench_fill_rows(&boards[0], 0, 4, 1);
+}
+
+// Four compact boards stacked to the top, the heaviest frame the game has
+static void _bench_four_boards(void) {
+    _bench_game_state(VERSUS, MAX_BOARDS);
+    for(int i = 0; i < MAX_BOARDS; i++) {
+        boards[i].opponent = &boards[(i + 1) % MAX_BOARDS];
+        _bench_board(&boards[i], MATRIX_HEIGHT-2);
+    }
+}
+
+static const BenchScenario benchScenarios[] = {
+    { "full_board",     _bench_full_board },
+    { "tetris_garbage", _bench_tetris },
+    { "versus",         _bench_versus_boards },
+    { "four_boards",    _bench_four_boards },
+    { "menu",           _bench_menu },
+};
+
+// Times play_frame in each scenario, then prints the results and stops.
+// The rest of the frame (music, loading, display) runs as usual but isn't
+// counted.
+void run_benchmarks(void) {
+    int numScenarios = sizeof(benchScenarios)/sizeof(BenchScenario);
+
+    printf("Bench: %d scenarios, %d frames each, %d cycles a frame\n", 
+        numScenarios, BENCH_FRAMES, (int)CYCLES_PER_FRAME);
+
+    for(int s = 0; s < numScenarios; s++) {
+        const BenchScenario *scenario = &benchScenarios[s];
+        uint32_t min = 0xffffffff, max = 0, total = 0;
+        int primBytes = 0;
+
+        for(int i = 0; i < BENCH_FRAMES; i++) {
+            scenario->setup();
+
+            uint32_t start = get_system_cycles();
+            play_frame();
+            uint32_t cycles = get_system_cycles() - start;
+
+            min = (cycles < min) ? cycles : min;
+            max = (cycles > max) ? cycles : max;
+            total += cycles;
+            primBytes = get_prim_bytes();
+
+            update_cd_loader();
+            update_memcard();
+            update_music();
+            display();
+            flush_audio();
+        }
+
+        uint32_t avg = total / BENCH_FRAMES;
+        printf("Bench: %-16s min %7d avg %7d max %7d cycles, %3d%% of a frame, %5d prim bytes\n",
+            scenario->name, (int)min, (int)avg, (int)max, (int)((avg * 100) / CYCLES_PER_FRAME), primBytes);
+    }
+
+    printf("Bench: done\n");
+    PCSX_EXIT_CODE = 0;
+
+    // On hardware there is nothing to exit to
+    while(1)
+        VSync(0);
+}
+
+#endif
+
 int main(void) {
+    init_arenas();
     init_gfx();
-    init_input();
-    init_audio();
     init_system_timer();
+#if DEBUG_MODE
+    uint32_t bootStart = get_system_time_us();
+#endif
+
+    // SPU RAM is cleared in the background from here, while the pads and
+    // drive are set up and the textures load
+    init_audio();
+#if DEBUG_MODE
+    uint32_t audioDone = get_system_time_us();
+#endif
+
+    init_input();
+    init_memcard();
+    init_cd_loader();
+
+    if(!init_game(&gameCtx)) {
+        printf("Error: the game could not be loaded, stopping.\n");
+        while(1)
+            VSync(0);
+    }
 
-    TetradeGame gameOne;
-    TetradeGame gameTwo;
+    for(int i = 0; i < MAX_BOARDS; i++) {
+        init_tetris_game(&boards[i], i);
+    }
 
-    init_game(&gameCtx);
-    init_tetris_game(&gameOne, 0);
-    init_tetris_game(&gameTwo, 1);
+    // Settings and scores show up once the card has been read. Benchmarks
+    // always run with the defaults.
+#if !BENCH_MODE
+    load_from_card();
+#endif
 
     DrawSync(0);
 
+#if DEBUG_MODE
+    uint32_t bootDone = get_system_time_us();
+    printf("Boot: audio %d us, total %d us\n", (int)(audioDone - bootStart), (int)(bootDone - bootStart));
+#endif
+    print_memory_map();
+
+#if BENCH_MODE
+    run_benchmarks();
+#endif
+
     printf("Game Start!\n");
 
     //Main loop
     while(1) {
+        TRACE_BEGIN(TRACE_FRAME, TRACE_TID_MAIN);
 
-        if(gameCtx.gameState == START) {
-            play_start_menu();
-        } else if(gameCtx.gameState == REGULAR) { 
-            play_regular_mode(&gameOne, &gameTwo);
-        } else if(gameCtx.gameState == VERSUS) {
-            play_versus_mode(&gameOne, &gameTwo);
-        }
+        // One snapshot of the pads for the whole frame, taken just after
+        // vblank when the BIOS has read them
+        TRACE_BEGIN(TRACE_PAD_POLL, TRACE_TID_MAIN);
+        poll_input();
+        TRACE_END(TRACE_PAD_POLL, TRACE_TID_MAIN);
 
-        draw_sprite(&(gameCtx.backgroundLeft));
-        draw_sprite(&(gameCtx.backgroundRight));
-        
-        gameCtx.mainTimer.time++;
+        play_frame();
 
         #if DEBUG_MODE
             //FntPrint(fnt, "Time: %d\n", get_system_time());
+            VoiceStats voiceStats;
+            get_voice_stats(&voiceStats);
+            FntPrint(fnt, "Voices %d/%d peak %d stolen %d dropped %d\n", 
+                voiceStats.active, SPU_NUM_VOICES - voiceStats.reserved, voiceStats.peak, 
+                voiceStats.stolen, voiceStats.dropped);
+
+        #if MUSIC_MODE == MUSIC_MODE_SPU
+            // Underruns replay stale audio, the refill should stay well
+            // under a half
+            MusicStats musicStats;
+            get_music_stats(&musicStats);
+            FntPrint(fnt, "Music underruns %d refill %d/%d us\n",
+                musicStats.underruns, musicStats.maxRefillUs, musicStats.halfUs);
+        #endif
+
+            // Each board's update and draw, and the primitives so far
+            FntPrint(fnt, "Boards %d %d %d %d us, %d %d %d %d bytes\n",
+                boards[0].drawCost, boards[1].drawCost, boards[2].drawCost, boards[3].drawCost,
+                boards[0].primCost, boards[1].primCost, boards[2].primCost, boards[3].primCost);
+            FntPrint(fnt, "Prims %d/%d dropped %d\n", get_prim_bytes(), PRIM_BUFFER_LEN, get_dropped_prims());
 
             // Draw and flush the character buffer
             FntFlush(-1);
         #endif
 
-        poll_input(0);
-        poll_input(1);
+        #if TRACE_MODE
+            // Select dumps the timeline over TTY
+            if(button_pressed(0, PAD_SELECT)) {
+                dump_trace();
+                clear_trace();
+            }
+        #endif
+
+        update_cd_loader();
+        update_memcard();
+        update_music();
+        update_spu_ram_clear();
 
         // Update the display
         display();
+
+        // Sounds played this frame start together, just after vblank
+        flush_audio();
+
+        TRACE_END(TRACE_FRAME, TRACE_TID_MAIN);
     }
     return 0;
 }
\ No newline at end of file
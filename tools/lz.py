@@ -0,0 +1,197 @@
+#!/usr/bin/env python3
+"""
+LZ compressor for assets decoded by src/engine/lz.c.
+
+The output is an LZ4-style block: a sequence of
+    token      u8   high nibble literal count, low nibble match length - 4
+    [lit ext]  u8*  while the nibble (then each byte) is 15 / 255, add the next byte
+    literals
+    offset     u16  little-endian distance back into the output, 1..65535
+    [match ext]u8*  as for the literal count
+The last sequence carries only literals, and the last LZ_LAST_LITERALS bytes
+are always literals so the decoder can run without bounds checks on matches.
+
+Blocks are built so they can be decoded in place: the compressed data is
+placed at the end of a buffer of raw size + LZ_INPLACE_MARGIN(compressed
+size) bytes and decoded to its start. compress() checks this and raises
+ValueError if a block would overrun, in which case the data should be
+stored uncompressed.
+
+Usage: lz.py <file>...   prints the compression ratio of each file
+"""
+
+import sys
+
+MIN_MATCH = 4
+MAX_OFFSET = 65535
+LAST_LITERALS = 5
+HASH_BITS = 14
+CHAIN_DEPTH = 32
+
+
+def inplace_margin(compressed_size):
+    # Must match LZ_INPLACE_MARGIN() in lz.h
+    return (compressed_size >> 8) + 32
+
+
+def _write_length(out, n):
+    while n >= 255:
+        out.append(255)
+        n -= 255
+    out.append(n)
+
+
+def _emit(out, data, lit_start, lit_end, offset, match_len):
+    lits = lit_end - lit_start
+    token_lit = min(lits, 15)
+    token_match = 0 if match_len == 0 else min(match_len - MIN_MATCH, 15)
+
+    out.append((token_lit << 4) | token_match)
+    if lits >= 15:
+        _write_length(out, lits - 15)
+
+    out += data[lit_start:lit_end]
+
+    if match_len:
+        out.append(offset & 0xFF)
+        out.append(offset >> 8)
+        if match_len - MIN_MATCH >= 15:
+            _write_length(out, match_len - MIN_MATCH - 15)
+
+
+def _hash(data, i):
+    v = data[i] | (data[i + 1] << 8) | (data[i + 2] << 16) | (data[i + 3] << 24)
+    return ((v * 2654435761) & 0xFFFFFFFF) >> (32 - HASH_BITS)
+
+
+def compress(data):
+    data = bytes(data)
+    n = len(data)
+    out = bytearray()
+
+    # (raw start, literals start in block, raw end, block end) of every
+    # sequence, used to check in place decoding afterwards
+    steps = []
+
+    head = [-1] * (1 << HASH_BITS)
+    chain = [-1] * n
+    match_limit = n - LAST_LITERALS
+
+    def insert(p):
+        if p + MIN_MATCH <= n:
+            h = _hash(data, p)
+            chain[p] = head[h]
+            head[h] = p
+
+    anchor = 0
+    i = 0
+
+    while i + MIN_MATCH <= match_limit:
+        best_len = 0
+        best_pos = -1
+        cand = head[_hash(data, i)]
+        depth = CHAIN_DEPTH
+
+        while cand >= 0 and i - cand <= MAX_OFFSET and depth > 0:
+            if data[cand + best_len:cand + best_len + 1] == data[i + best_len:i + best_len + 1]:
+                length = 0
+                limit = match_limit - i
+                while length < limit and data[cand + length] == data[i + length]:
+                    length += 1
+                if length > best_len:
+                    best_len = length
+                    best_pos = cand
+            cand = chain[cand]
+            depth -= 1
+
+        if best_len < MIN_MATCH:
+            insert(i)
+            i += 1
+            continue
+
+        block_start = len(out)
+        _emit(out, data, anchor, i, i - best_pos, best_len)
+        steps.append((anchor, block_start + _literals_offset(i - anchor), i + best_len, len(out)))
+
+        end = i + best_len
+        while i < end:
+            insert(i)
+            i += 1
+        anchor = i
+
+    block_start = len(out)
+    _emit(out, data, anchor, n, 0, 0)
+    steps.append((anchor, block_start + _literals_offset(n - anchor), n, len(out)))
+
+    _check_inplace(steps, n, len(out))
+    return bytes(out)
+
+
+def _literals_offset(lits):
+    # Token plus literal length bytes
+    return 1 + (0 if lits < 15 else (lits - 15) // 255 + 1)
+
+
+def _check_inplace(steps, raw_size, comp_size):
+    # Literals are copied with the write position trailing the read
+    # position, and a match must end before the next token is read. The
+    # write position must never pass the read position in the shared buffer.
+    start = raw_size + inplace_margin(comp_size) - comp_size
+
+    for raw_start, lit_start, raw_end, block_end in steps:
+        if raw_start > start + lit_start or raw_end > start + block_end:
+            raise ValueError("block cannot be decoded in place")
+
+
+def decompress(block, raw_size):
+    out = bytearray()
+    i = 0
+
+    def read_length(n):
+        nonlocal i
+        if n == 15:
+            while True:
+                b = block[i]
+                i += 1
+                n += b
+                if b != 255:
+                    break
+        return n
+
+    while True:
+        token = block[i]
+        i += 1
+
+        lits = read_length(token >> 4)
+        out += block[i:i + lits]
+        i += lits
+
+        if len(out) >= raw_size:
+            break
+
+        offset = block[i] | (block[i + 1] << 8)
+        i += 2
+        length = read_length(token & 15) + MIN_MATCH
+
+        for _ in range(length):
+            out.append(out[-offset])
+
+    return bytes(out)
+
+
+def main(argv):
+    if len(argv) < 2:
+        sys.exit(__doc__)
+
+    for path in argv[1:]:
+        with open(path, "rb") as f:
+            data = f.read()
+
+        block = compress(data)
+        assert decompress(block, len(data)) == data
+
+        print(f"{path}: {len(data)} -> {len(block)} bytes ({100 * len(block) / max(len(data), 1):.1f}%)")
+
+
+if __name__ == "__main__":
+    main(sys.argv)
@@ -0,0 +1,243 @@
+#!/usr/bin/env python3
+"""
+Renders tempo variants of a looping VAG for the CD music modes
+(TETRADE_MUSIC=CDDA or XA, see src/engine/cdmusic.c).
+
+The SPU stream speeds the theme up by raising the voice's sample rate. The
+CD drive can't do that, so every rate the game asks for is pre-rendered as
+the song played back at that rate (pitch and tempo both change, as they do
+on the SPU). Each rate is a variant.
+
+    cdda  writes <prefix><n>.wav, one 44.1 kHz stereo track per variant.
+    xa    writes one 2336-byte-per-sector XA file with each variant on its
+          own channel (file 1, channel n), 37.8 kHz mono 4-bit, interleaved
+          1 in 16 sectors for a double speed drive.
+
+Both also write a C header giving each variant's rate and length in ms.
+
+Usage: mkmusic.py cdda <input.vag> <output prefix> <output.h> <rate>...
+       mkmusic.py xa   <input.vag> <output.xa>     <output.h> <rate>...
+"""
+
+import array
+import os
+import struct
+import sys
+
+SPU_FILTERS = [(0, 0), (60, 0), (115, -52), (98, -55), (122, -60)]
+XA_FILTERS = SPU_FILTERS[:4]
+
+CDDA_RATE = 44100
+XA_RATE = 37800
+XA_INTERLEAVE = 16
+XA_SAMPLES_PER_SECTOR = 18 * 8 * 28
+XA_SECTOR_SIZE = 2336
+XA_SUBMODE_AUDIO = 0x64  # Realtime, form 2, audio
+XA_CODING_MONO_37800_4BIT = 0x00
+
+
+def _clamp16(x):
+    return -32768 if x < -32768 else 32767 if x > 32767 else x
+
+
+def read_vag(path):
+    """Decodes a mono VAG, returns (sample rate, samples). Stops at the
+    block flagged loop end."""
+    with open(path, "rb") as f:
+        data = f.read()
+
+    if data[:4] != b"VAGp":
+        sys.exit(f"{path}: not a mono VAG")
+
+    size, rate = struct.unpack_from(">II", data, 12)
+    samples = array.array("h")
+    s1 = s2 = 0
+
+    for pos in range(48, min(48 + size, len(data)) - 15, 16):
+        shift = data[pos] & 0x0F
+        k0, k1 = SPU_FILTERS[min(data[pos] >> 4, 4)]
+        flags = data[pos + 1]
+
+        for b in data[pos + 2:pos + 16]:
+            for n in (b & 0x0F, b >> 4):
+                t = n - 16 if n >= 8 else n
+                s = _clamp16(((t << 12) >> shift) + ((s1 * k0 + s2 * k1 + 32) >> 6))
+                samples.append(s)
+                s2, s1 = s1, s
+
+        if flags & 0x01:
+            break
+
+    return rate, samples
+
+
+def render(samples, speed_rate, out_rate):
+    """The looping song played at speed_rate, resampled to out_rate."""
+    n = len(samples)
+    count = n * out_rate // speed_rate
+    out = array.array("h", bytes(2 * count))
+    step = speed_rate / out_rate
+
+    for i in range(count):
+        p = i * step
+        k = int(p)
+        f = p - k
+        a = samples[k]
+        b = samples[(k + 1) % n]
+        out[i] = int(a + (b - a) * f)
+
+    return out
+
+
+def write_wav(path, samples, rate):
+    stereo = array.array("h", bytes(4 * len(samples)))
+    stereo[0::2] = samples
+    stereo[1::2] = samples
+    if sys.byteorder != "little":
+        stereo.byteswap()
+
+    data = stereo.tobytes()
+    with open(path, "wb") as f:
+        f.write(b"RIFF" + struct.pack("<I", 36 + len(data)) + b"WAVE")
+        f.write(b"fmt " + struct.pack("<IHHIIHH", 16, 1, 2, rate, rate * 4, 4, 16))
+        f.write(b"data" + struct.pack("<I", len(data)))
+        f.write(data)
+
+
+class XaEncoder:
+    def __init__(self):
+        self.s1 = self.s2 = 0
+
+    def encode_unit(self, block):
+        """Encodes 28 samples, returns (parameter byte, 28 nibbles)."""
+        best = None
+
+        # Pick the filter with the smallest residual against the source
+        for f, (k0, k1) in enumerate(XA_FILTERS):
+            p1, p2 = self.s1, self.s2
+            peak = 0
+            for x in block:
+                r = x - ((p1 * k0 + p2 * k1 + 32) >> 6)
+                if r < 0:
+                    r = -r
+                if r > peak:
+                    peak = r
+                p2, p1 = p1, x
+            if best is None or peak < best[0]:
+                best = (peak, f)
+
+        peak, f = best
+        k0, k1 = XA_FILTERS[f]
+
+        exp = 0
+        while exp < 12 and peak > (7 << exp):
+            exp += 1
+        step = 1 << exp
+        half = step >> 1
+
+        nibbles = []
+        s1, s2 = self.s1, self.s2
+        for x in block:
+            pred = (s1 * k0 + s2 * k1 + 32) >> 6
+            r = x - pred
+            q = (r + half) >> exp if r >= 0 else -((-r + half) >> exp)
+            q = -8 if q < -8 else 7 if q > 7 else q
+            s = _clamp16(q * step + pred)
+            nibbles.append(q & 0x0F)
+            s2, s1 = s1, s
+
+        self.s1, self.s2 = s1, s2
+        return ((12 - exp) | (f << 4)), nibbles
+
+    def encode_sector(self, samples, channel):
+        out = bytearray(struct.pack("<BBBB", 1, channel, XA_SUBMODE_AUDIO, XA_CODING_MONO_37800_4BIT) * 2)
+
+        for g in range(18):
+            params = []
+            units = []
+            for u in range(8):
+                start = (g * 8 + u) * 28
+                block = samples[start:start + 28]
+                block = list(block) + [0] * (28 - len(block))
+                p, n = self.encode_unit(block)
+                params.append(p)
+                units.append(n)
+
+            group = bytearray(params[0:4] + params + params[4:8])
+            for i in range(28):
+                for j in range(4):
+                    group.append(units[2 * j][i] | (units[2 * j + 1][i] << 4))
+            out += group
+
+        out += bytes(XA_SECTOR_SIZE - len(out))
+        return out
+
+
+def build_xa(variants):
+    """Interleaves the variants into one file."""
+    lengths = [(len(v) + XA_SAMPLES_PER_SECTOR - 1) // XA_SAMPLES_PER_SECTOR for v in variants]
+    frames = max(lengths)
+    encoders = [XaEncoder() for _ in range(XA_INTERLEAVE)]
+    silence = array.array("h", bytes(2 * XA_SAMPLES_PER_SECTOR))
+    out = bytearray()
+
+    for frame in range(frames):
+        for channel in range(XA_INTERLEAVE):
+            # Unused slots and variants that have ended hold silence on
+            # their own channel, so the filter skips them
+            samples = silence
+            if channel < len(variants) and frame < lengths[channel]:
+                start = frame * XA_SAMPLES_PER_SECTOR
+                samples = variants[channel][start:start + XA_SAMPLES_PER_SECTOR]
+            out += encoders[channel].encode_sector(samples, channel)
+
+    return out
+
+
+def write_header(path, source, rates, lengths_ms):
+    lines = [
+        f"// Generated by tools/mkmusic.py from {os.path.basename(source)}, do not edit.",
+        "",
+        "#pragma once",
+        "",
+        f"#define MUSIC_NUM_VARIANTS {len(rates)}",
+        "",
+        f"static const int MUSIC_VARIANT_RATES[MUSIC_NUM_VARIANTS] = {{ {', '.join(map(str, rates))} }};",
+        f"static const int MUSIC_VARIANT_MS[MUSIC_NUM_VARIANTS] = {{ {', '.join(map(str, lengths_ms))} }};",
+        "",
+        f"#define MUSIC_XA_INTERLEAVE {XA_INTERLEAVE}",
+    ]
+
+    with open(path, "w") as f:
+        f.write("\n".join(lines) + "\n")
+
+
+def main(argv):
+    if len(argv) < 6 or argv[1] not in ("cdda", "xa"):
+        sys.exit(__doc__)
+
+    mode, source, output, header = argv[1:5]
+    rates = [int(r) for r in argv[5:]]
+
+    if mode == "xa" and len(rates) > XA_INTERLEAVE:
+        sys.exit(f"at most {XA_INTERLEAVE} variants fit in one XA file")
+
+    _, samples = read_vag(source)
+    out_rate = CDDA_RATE if mode == "cdda" else XA_RATE
+    variants = [render(samples, rate, out_rate) for rate in rates]
+    lengths_ms = [len(v) * 1000 // out_rate for v in variants]
+
+    if mode == "cdda":
+        for n, v in enumerate(variants):
+            write_wav(f"{output}{n}.wav", v, CDDA_RATE)
+    else:
+        with open(output, "wb") as f:
+            f.write(build_xa(variants))
+
+    write_header(header, source, rates, lengths_ms)
+
+    print(f"{mode}: {len(rates)} variants, {min(lengths_ms)}-{max(lengths_ms)} ms")
+
+
+if __name__ == "__main__":
+    main(sys.argv)
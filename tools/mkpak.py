@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+"""
+Builds the packed asset archive read by src/engine/pak.c.
+
+Layout (all little-endian):
+    sector 0    PakHeader  { u32 magic "TPAK", u16 version, u16 numEntries, u32 reserved[2] }
+                PakEntry[] { u32 nameHash, u32 sector, u32 size, u32 rawSize, u16 type, u16 flags }
+    sector 1..  entry data, each entry padded to a 2048-byte sector boundary
+
+Entries are written in manifest order. Names are hashed with 32-bit FNV-1a
+over the upper-case name, matching hash_pak_name().
+
+Entries marked "lz" in the manifest are compressed with tools/lz.py and get
+PAK_FLAG_LZ, unless that would not save at least one sector. Most are one
+LZ block. Textures are streamed into VRAM as their sectors arrive, so they
+are cut into blocks of up to LZ_BLOCK_SIZE raw bytes instead, each one
+    u16        stored size, bit 15 set if the block is stored uncompressed
+    data
+and decoded on its own, with no more than one block staged in RAM.
+
+Sources are looked up next to the manifest, then in each -I directory.
+
+Usage: mkpak.py [-I <dir>]... <manifest> <output.pak>
+"""
+
+import os
+import struct
+import sys
+
+import lz
+
+SECTOR_SIZE = 2048
+PAK_MAGIC = b"TPAK"
+PAK_VERSION = 3
+HEADER_SIZE = 16
+ENTRY_SIZE = 20
+MAX_ENTRIES = (SECTOR_SIZE - HEADER_SIZE) // ENTRY_SIZE
+
+TYPES = {"raw": 0, "tim": 1, "vag": 2}
+FLAG_LZ = 0x0001
+
+# Must match PAK_LZ_BLOCK_SIZE in pak.h
+LZ_BLOCK_SIZE = 8192
+LZ_BLOCK_STORED = 0x8000
+
+
+def hash_name(name):
+    h = 2166136261
+    for c in name.upper().encode("ascii"):
+        h = ((h ^ c) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def find_source(source, dirs):
+    for d in dirs:
+        path = os.path.join(d, source)
+        if os.path.exists(path):
+            return path
+
+    sys.exit(f"{source} not found")
+
+
+def read_manifest(path, search_dirs):
+    dirs = [os.path.dirname(os.path.abspath(path))] + search_dirs
+    entries = []
+
+    with open(path, "r") as f:
+        for lineno, line in enumerate(f, 1):
+            line = line.split("#", 1)[0].strip()
+            if not line:
+                continue
+
+            fields = line.split()
+            if len(fields) not in (3, 4) or fields[1] not in TYPES or fields[3:] not in ([], ["lz"]):
+                sys.exit(f"{path}:{lineno}: expected '<name> <{'|'.join(TYPES)}> <source> [lz]'")
+
+            name, kind, source = fields[:3]
+            entries.append((name, kind, find_source(source, dirs), len(fields) == 4))
+
+    return entries
+
+
+def sectors(size):
+    return (size + SECTOR_SIZE - 1) // SECTOR_SIZE
+
+
+def compress_blocks(blob):
+    out = bytearray()
+
+    for i in range(0, len(blob), LZ_BLOCK_SIZE):
+        raw = blob[i:i + LZ_BLOCK_SIZE]
+        try:
+            packed = lz.compress(raw)
+        except ValueError:
+            packed = raw
+
+        if len(packed) < len(raw):
+            out += struct.pack("<H", len(packed)) + packed
+        else:
+            out += struct.pack("<H", len(raw) | LZ_BLOCK_STORED) + raw
+
+    return bytes(out)
+
+
+def build_pak(entries):
+    if len(entries) > MAX_ENTRIES:
+        sys.exit(f"too many entries ({len(entries)}), the TOC holds {MAX_ENTRIES}")
+
+    hashes = {}
+    toc = bytearray()
+    data = bytearray()
+    sector = 1
+
+    for name, kind, source, compress in entries:
+        h = hash_name(name)
+        if h in hashes:
+            sys.exit(f"{name} collides with {hashes[h]}, rename one of them")
+        hashes[h] = name
+
+        with open(source, "rb") as f:
+            blob = f.read()
+
+        raw_size = len(blob)
+        flags = 0
+
+        if compress:
+            if kind == "tim":
+                packed = compress_blocks(blob)
+            else:
+                try:
+                    packed = lz.compress(blob)
+                except ValueError:
+                    packed = blob
+
+            if sectors(len(packed)) < sectors(raw_size):
+                blob = packed
+                flags |= FLAG_LZ
+
+        print(f"{name:<14} {raw_size:>7} -> {len(blob):>7} bytes, {sectors(len(blob)):>4} sectors{' (lz)' if flags & FLAG_LZ else ''}")
+
+        toc += struct.pack("<IIIIHH", h, sector, len(blob), raw_size, TYPES[kind], flags)
+
+        blob += bytes(sectors(len(blob)) * SECTOR_SIZE - len(blob))
+        data += blob
+        sector += sectors(len(blob))
+
+    header = PAK_MAGIC + struct.pack("<HHII", PAK_VERSION, len(entries), 0, 0)
+    first = header + toc
+    first += bytes(SECTOR_SIZE - len(first))
+
+    return first + data
+
+
+def main(argv):
+    args = argv[1:]
+    search_dirs = []
+
+    while len(args) >= 2 and args[0] == "-I":
+        search_dirs.append(args[1])
+        args = args[2:]
+
+    if len(args) != 2:
+        sys.exit(__doc__)
+
+    pak = build_pak(read_manifest(args[0], search_dirs))
+
+    with open(args[1], "wb") as f:
+        f.write(pak)
+
+
+if __name__ == "__main__":
+    main(sys.argv)
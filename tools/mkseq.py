@@ -0,0 +1,325 @@
+#!/usr/bin/env python3
+"""
+Compiles a text score into the sequence file played by src/engine/seqmusic.c
+(TETRADE_MUSIC=SEQ).
+
+The score declares instruments, channels and patterns, then the order the
+patterns play in:
+
+    tempo <beats per minute>
+    rows <rows per beat>
+    instrument <name> <wave> <param> <adsr1> <adsr2> <volume>
+    channel <name> <instrument>
+    pattern <name>
+    <channel> <notes>...
+    order <pattern>...
+
+Waves are generated here, no recordings are needed:
+    pulse <duty %>      one looped cycle
+    triangle <unused>   one looped cycle
+    noise <length ms>   a one-shot burst that dies away
+
+Notes are a name and octave (C4, F#5, Bb3), or - for a rest, optionally
+followed by :<rows> (default 1). A note lasts until the next one on its
+channel, a rest keys it off. ( ... )*<n> repeats a group. Every channel of a
+pattern must add up to the same number of rows, channels left out of a
+pattern rest through it. The song loops back to the start of the order.
+
+Layout (all little-endian, offsets from the start of the file):
+    SeqHeader     { u32 magic "TSEQ", u16 version, u8 numInstruments,
+                    u8 numChannels, u16 tempo, u8 rowsPerBeat, u8 reserved,
+                    u32 numRows }
+    SeqInstrument { u32 offset, u32 size, u16 rootPitch, u8 rootNote,
+                    u8 flags, u16 adsr1, u16 adsr2, u16 volume,
+                    u16 reserved }[numInstruments]
+    SeqChannel    { u32 offset, u16 numEvents, u8 instrument,
+                    u8 reserved }[numChannels]
+    SeqEvent      { u8 note, u8 rows }[] per channel, note 0 for a rest
+    SPU-ADPCM data of each instrument, 64-byte aligned
+
+rootPitch is the SPU pitch register value that plays the instrument at MIDI
+note rootNote.
+
+Usage: mkseq.py <score.txt> <output.seq>
+"""
+
+import math
+import random
+import re
+import struct
+import sys
+
+SEQ_MAGIC = b"TSEQ"
+SEQ_VERSION = 1
+HEADER_SIZE = 16
+INSTRUMENT_SIZE = 20
+CHANNEL_SIZE = 8
+FLAG_LOOP = 0x01
+
+SPU_RATE = 44100
+SPU_FILTERS = [(0, 0), (60, 0), (115, -52), (98, -55), (122, -60)]
+BLOCK_SAMPLES = 28
+DATA_ALIGN = 64
+
+ADPCM_LOOP_END = 0x01
+ADPCM_LOOP_REPEAT = 0x02
+ADPCM_LOOP_START = 0x04
+
+# Looped waves are one cycle of this many samples, played at ROOT_NOTE
+CYCLE_SAMPLES = 4 * BLOCK_SAMPLES
+ROOT_NOTE = 69  # A4
+NOISE_RATE = 22050
+AMPLITUDE = 12000
+
+NOTE_NAMES = {"C": 0, "D": 2, "E": 4, "F": 5, "G": 7, "A": 9, "B": 11}
+
+
+def _clamp16(x):
+    return -32768 if x < -32768 else 32767 if x > 32767 else x
+
+
+def encode_adpcm(samples, loop_start=None):
+    """SPU-ADPCM encodes samples, a multiple of 28 long. Blocks from
+    loop_start on loop, otherwise the last block ends the sample."""
+    out = bytearray()
+    s1 = s2 = 0
+    num_blocks = len(samples) // BLOCK_SAMPLES
+
+    for b in range(num_blocks):
+        block = samples[b * BLOCK_SAMPLES:(b + 1) * BLOCK_SAMPLES]
+        best = None
+
+        # Try every filter and shift, keep the one closest to the source
+        for f, (k0, k1) in enumerate(SPU_FILTERS):
+            for shift in range(13):
+                p1, p2 = s1, s2
+                nibbles = []
+                err = 0
+                for x in block:
+                    pred = (p1 * k0 + p2 * k1 + 32) >> 6
+                    r = x - pred
+                    step = 1 << (12 - shift)
+                    q = int(round(r / step))
+                    q = -8 if q < -8 else 7 if q > 7 else q
+                    s = _clamp16(((q << 12) >> shift) + pred)
+                    err += (s - x) ** 2
+                    nibbles.append(q & 0x0F)
+                    p2, p1 = p1, s
+                if best is None or err < best[0]:
+                    best = (err, f, shift, nibbles, p1, p2)
+
+        _, f, shift, nibbles, s1, s2 = best
+
+        flags = 0
+        if loop_start is not None:
+            if b == loop_start:
+                flags |= ADPCM_LOOP_START
+            if b == num_blocks - 1:
+                flags |= ADPCM_LOOP_END | ADPCM_LOOP_REPEAT
+        elif b == num_blocks - 1:
+            flags |= ADPCM_LOOP_END
+
+        out.append((f << 4) | shift)
+        out.append(flags)
+        for i in range(0, BLOCK_SAMPLES, 2):
+            out.append(nibbles[i] | (nibbles[i + 1] << 4))
+
+    return bytes(out)
+
+
+def make_wave(kind, param):
+    """Returns (ADPCM data, root pitch register, flags)."""
+    if kind in ("pulse", "triangle"):
+        cycle = []
+        for i in range(CYCLE_SAMPLES):
+            t = i / CYCLE_SAMPLES
+            if kind == "pulse":
+                v = 1.0 if t < param / 100 else -1.0
+            else:
+                v = 4 * t - 1 if t < 0.5 else 3 - 4 * t
+            cycle.append(int(v * AMPLITUDE))
+
+        # The second cycle is encoded with the history the voice really has
+        # when it loops, and is the one looped
+        data = encode_adpcm(cycle * 2, loop_start=CYCLE_SAMPLES // BLOCK_SAMPLES)
+        rate = 440.0 * CYCLE_SAMPLES
+        return data, round(rate * 4096 / SPU_RATE), FLAG_LOOP
+
+    if kind == "noise":
+        rng = random.Random(1)
+        count = NOISE_RATE * param // 1000
+        count += -count % BLOCK_SAMPLES
+        burst = [int(rng.uniform(-1, 1) * AMPLITUDE * math.exp(-5 * i / count)) for i in range(count)]
+        return encode_adpcm(burst), round(NOISE_RATE * 4096 / SPU_RATE), 0
+
+    raise ValueError
+
+
+def parse_note(token):
+    m = re.fullmatch(r"([A-G])([#b]?)(-?\d)|-", token)
+    if m is None:
+        raise ValueError
+    if token == "-":
+        return 0
+
+    note = NOTE_NAMES[m.group(1)] + (12 * (int(m.group(3)) + 1))
+    note += {"#": 1, "b": -1, "": 0}[m.group(2)]
+    if not 1 <= note <= 127:
+        raise ValueError
+    return note
+
+
+def parse_notes(tokens):
+    """Expands groups and returns [(note, rows)]."""
+    events = []
+    stack = [events]
+
+    for token in tokens:
+        if token.startswith("("):
+            stack.append([])
+            token = token[1:]
+            if not token:
+                continue
+
+        m = re.fullmatch(r"(.*?)\)\*(\d+)", token)
+        if m is not None:
+            token = m.group(1)
+
+        if token:
+            note, _, rows = token.partition(":")
+            rows = int(rows) if rows else 1
+            if rows < 1:
+                raise ValueError
+            stack[-1].append((parse_note(note), rows))
+
+        if m is not None:
+            if len(stack) < 2:
+                raise ValueError
+            group = stack.pop()
+            stack[-1].extend(group * int(m.group(2)))
+
+    if len(stack) != 1:
+        raise ValueError
+    return events
+
+
+def read_score(path):
+    song = {"tempo": 120, "rows": 4, "instruments": {}, "channels": [], "patterns": {}, "order": []}
+    pattern = None
+
+    with open(path, "r") as f:
+        for lineno, line in enumerate(f, 1):
+            # # starts a comment unless it is a sharp
+            fields = re.sub(r"(^|\s)#.*", "", line).split()
+            if not fields:
+                continue
+
+            try:
+                key, args = fields[0], fields[1:]
+
+                if key in ("tempo", "rows"):
+                    song[key] = int(args[0])
+                elif key == "instrument":
+                    name, kind, param, adsr1, adsr2, volume = args
+                    data, pitch, flags = make_wave(kind, int(param))
+                    song["instruments"][name] = (len(song["instruments"]), data, pitch, flags,
+                                                 int(adsr1, 0), int(adsr2, 0), int(volume, 0))
+                elif key == "channel":
+                    name, inst = args
+                    song["channels"].append((name, song["instruments"][inst][0]))
+                elif key == "pattern":
+                    pattern = {}
+                    song["patterns"][args[0]] = pattern
+                elif key == "order":
+                    song["order"] += args
+                elif pattern is not None and key in (c[0] for c in song["channels"]):
+                    pattern[key] = pattern.get(key, []) + parse_notes(args)
+                else:
+                    raise ValueError
+            except (ValueError, KeyError, IndexError):
+                sys.exit(f"{path}:{lineno}: can't read '{line.strip()}'")
+
+    return song
+
+
+def flatten(song):
+    """Returns each channel's events over the whole order and the length
+    of the song in rows."""
+    streams = [[] for _ in song["channels"]]
+    total = 0
+
+    for name in song["order"]:
+        if name not in song["patterns"]:
+            sys.exit(f"order: no pattern {name}")
+        pattern = song["patterns"][name]
+
+        lengths = {sum(r for _, r in events) for events in pattern.values()}
+        if len(lengths) != 1:
+            sys.exit(f"pattern {name}: channels have different lengths {sorted(lengths)}")
+        length = lengths.pop()
+
+        for stream, (channel, _) in zip(streams, song["channels"]):
+            stream += pattern.get(channel, [(0, length)])
+        total += length
+
+    # Long rests are split, a note would be retriggered
+    for i, stream in enumerate(streams):
+        split = []
+        for note, rows in stream:
+            if note and rows > 255:
+                sys.exit(f"channel {song['channels'][i][0]}: notes can't be longer than 255 rows")
+            while rows > 255:
+                split.append((0, 255))
+                rows -= 255
+            split.append((note, rows))
+        streams[i] = split
+
+    return streams, total
+
+
+def build_seq(song):
+    streams, num_rows = flatten(song)
+    instruments = sorted(song["instruments"].values())
+
+    offset = HEADER_SIZE + INSTRUMENT_SIZE * len(instruments) + CHANNEL_SIZE * len(streams)
+    channel_table = bytearray()
+    events = bytearray()
+
+    for stream, (_, inst) in zip(streams, song["channels"]):
+        channel_table += struct.pack("<IHBB", offset + len(events), len(stream), inst, 0)
+        for note, rows in stream:
+            events += struct.pack("<BB", note, rows)
+
+    offset += len(events)
+    inst_table = bytearray()
+    inst_data = bytearray()
+
+    for _, data, pitch, flags, adsr1, adsr2, volume in instruments:
+        pad = -(offset + len(inst_data)) % DATA_ALIGN
+        inst_data += bytes(pad)
+        inst_table += struct.pack("<IIHBBHHHH", offset + len(inst_data), len(data), pitch, ROOT_NOTE,
+                                  flags, adsr1, adsr2, volume, 0)
+        inst_data += data
+
+    header = SEQ_MAGIC + struct.pack("<HBBHBBI", SEQ_VERSION, len(instruments), len(streams),
+                                     song["tempo"], song["rows"], 0, num_rows)
+
+    return header + inst_table + channel_table + events + inst_data, num_rows
+
+
+def main(argv):
+    if len(argv) != 3:
+        sys.exit(__doc__)
+
+    song = read_score(argv[1])
+    seq, num_rows = build_seq(song)
+
+    with open(argv[2], "wb") as f:
+        f.write(seq)
+
+    seconds = num_rows * 60 / (song["tempo"] * song["rows"])
+    print(f"{argv[2]}: {len(seq)} bytes, {len(song['channels'])} channels, {num_rows} rows, {seconds:.1f}s")
+
+
+if __name__ == "__main__":
+    main(sys.argv)
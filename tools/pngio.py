@@ -0,0 +1,127 @@
+"""
+Minimal PNG reading and writing for the image tools, so they only need a
+stock Python 3. Reads non-interlaced 8-bit grey, RGB, RGBA and palette
+images (palette images may use 1, 2 or 4 bits per pixel) and writes RGBA.
+"""
+
+import struct
+import zlib
+
+PNG_SIGNATURE = b"\x89PNG\r\n\x1a\n"
+
+
+def _chunks(data):
+    pos = len(PNG_SIGNATURE)
+    while pos < len(data):
+        length, kind = struct.unpack_from(">I4s", data, pos)
+        yield kind, data[pos + 8:pos + 8 + length]
+        pos += length + 12
+
+
+def _paeth(a, b, c):
+    p = a + b - c
+    pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+    if pa <= pb and pa <= pc:
+        return a
+    return b if pb <= pc else c
+
+
+def _unfilter(raw, width, height, bpp, stride):
+    rows = []
+    prev = bytearray(stride)
+    pos = 0
+
+    for _ in range(height):
+        kind = raw[pos]
+        line = bytearray(raw[pos + 1:pos + 1 + stride])
+        pos += 1 + stride
+
+        for i in range(stride):
+            a = line[i - bpp] if i >= bpp else 0
+            b = prev[i]
+            c = prev[i - bpp] if i >= bpp else 0
+
+            if kind == 1:
+                line[i] = (line[i] + a) & 0xFF
+            elif kind == 2:
+                line[i] = (line[i] + b) & 0xFF
+            elif kind == 3:
+                line[i] = (line[i] + ((a + b) >> 1)) & 0xFF
+            elif kind == 4:
+                line[i] = (line[i] + _paeth(a, b, c)) & 0xFF
+
+        rows.append(line)
+        prev = line
+
+    return rows
+
+
+def read_png(path):
+    """Returns (width, height, pixels) with pixels a row-major list of RGBA tuples."""
+    with open(path, "rb") as f:
+        data = f.read()
+
+    if not data.startswith(PNG_SIGNATURE):
+        raise ValueError(f"{path}: not a PNG")
+
+    idat = bytearray()
+    palette = []
+    alphas = b""
+
+    for kind, body in _chunks(data):
+        if kind == b"IHDR":
+            width, height, depth, color, _, _, interlace = struct.unpack(">IIBBBBB", body)
+        elif kind == b"PLTE":
+            palette = [tuple(body[i:i + 3]) for i in range(0, len(body), 3)]
+        elif kind == b"tRNS":
+            alphas = body
+        elif kind == b"IDAT":
+            idat += body
+
+    channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}.get(color)
+    if channels is None or interlace or (depth != 8 and not (color == 3 and depth in (1, 2, 4))):
+        raise ValueError(f"{path}: unsupported PNG format (colour type {color}, {depth}-bit)")
+
+    bits = channels * depth
+    stride = (width * bits + 7) // 8
+    rows = _unfilter(zlib.decompress(bytes(idat)), width, height, max(1, bits // 8), stride)
+
+    pixels = []
+    for line in rows:
+        for x in range(width):
+            if color == 3:
+                per_byte = 8 // depth
+                shift = 8 - depth * (x % per_byte + 1)
+                index = (line[x // per_byte] >> shift) & ((1 << depth) - 1)
+                alpha = alphas[index] if index < len(alphas) else 255
+                pixels.append(palette[index] + (alpha,))
+            elif color == 0:
+                v = line[x]
+                pixels.append((v, v, v, 255))
+            elif color == 4:
+                v = line[x * 2]
+                pixels.append((v, v, v, line[x * 2 + 1]))
+            elif color == 2:
+                pixels.append(tuple(line[x * 3:x * 3 + 3]) + (255,))
+            else:
+                pixels.append(tuple(line[x * 4:x * 4 + 4]))
+
+    return width, height, pixels
+
+
+def write_png(path, width, height, pixels):
+    """Writes a row-major list of RGBA tuples as an RGBA PNG."""
+    raw = bytearray()
+    for y in range(height):
+        raw.append(0)
+        for r, g, b, a in pixels[y * width:(y + 1) * width]:
+            raw += bytes((r, g, b, a))
+
+    def chunk(kind, body):
+        return struct.pack(">I", len(body)) + kind + body + struct.pack(">I", zlib.crc32(kind + body))
+
+    with open(path, "wb") as f:
+        f.write(PNG_SIGNATURE)
+        f.write(chunk(b"IHDR", struct.pack(">IIBBBBB", width, height, 8, 6, 0, 0, 0)))
+        f.write(chunk(b"IDAT", zlib.compress(bytes(raw), 9)))
+        f.write(chunk(b"IEND", b""))
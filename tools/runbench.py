@@ -0,0 +1,179 @@
+#!/usr/bin/env python3
+"""
+Runs the cycle-count benchmark build of the game in PCSX-Redux without a
+window and collects what it prints over TTY.
+
+Configure with -DTETRADE_BENCH=ON to get the benchmark build. Instead of
+playing, it steps fixed scenarios (see run_benchmarks in src/main.c), times
+each frame's update and draw with root counter 2 and prints a line per
+scenario:
+
+    Bench: <name> min <n> avg <n> max <n> cycles, <n>% of a frame, <n> prim bytes
+
+then exits the emulator. The results are printed as a table and can be
+saved as JSON. Given a baseline saved the same way, any scenario whose
+average got slower by more than the threshold fails the run, so it can gate
+changes on the real CPU's timing rather than the host's (see bench/ for
+those).
+
+Usage: runbench.py [options] <TETRADE_PSX.cue>
+    --emulator <path>      PCSX-Redux binary (default pcsx-redux, or $PCSX_REDUX)
+    --timeout <seconds>    Give up after this long (default 120)
+    --json <out.json>      Save the results
+    --baseline <old.json>  Compare against an earlier run
+    --threshold <percent>  Slowdown that fails against the baseline (default 2)
+"""
+
+import json
+import os
+import queue
+import re
+import subprocess
+import sys
+import threading
+import time
+
+DEFAULT_TIMEOUT = 120
+DEFAULT_THRESHOLD = 2.0
+
+# Headless, boot straight into the disc, TTY on stdout, and let the game's
+# write to the exit register close the emulator
+EMULATOR_ARGS = ["-no-ui", "-run", "-fastboot", "-interpreter", "-stdout", "-testmode"]
+
+RESULT_RE = re.compile(r"Bench: (\S+)\s+min\s+(\d+) avg\s+(\d+) max\s+(\d+) cycles,\s*(\d+)% of a frame,\s*(\d+) prim bytes")
+HEADER_RE = re.compile(r"Bench: (\d+) scenarios, (\d+) frames each, (\d+) cycles a frame")
+
+
+def _read_lines(stream, out):
+    """Passes each line of stream to out, then None at the end."""
+    for line in stream:
+        out.put(line.rstrip())
+    out.put(None)
+
+
+def run_emulator(emulator, cue, timeout):
+    """Returns the TTY lines up to Bench: done. The emulator is killed if
+    it hasn't got there within timeout seconds, even if it stopped
+    printing."""
+    cmd = [emulator] + EMULATOR_ARGS + ["-iso", cue]
+    proc = subprocess.Popen(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True, errors="replace")
+    lines = []
+    deadline = time.monotonic() + timeout
+
+    # Read on a thread so a hung emulator can't block past the deadline
+    output = queue.Queue()
+    threading.Thread(target=_read_lines, args=(proc.stdout, output), daemon=True).start()
+
+    try:
+        while True:
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                print(f"{emulator}: timed out after {timeout:g}s", file=sys.stderr)
+                proc.kill()
+                break
+
+            try:
+                line = output.get(timeout=remaining)
+            except queue.Empty:
+                continue
+
+            if line is None:
+                break
+            lines.append(line)
+            if line.startswith("Bench:"):
+                print(line, flush=True)
+            if line == "Bench: done":
+                break
+    finally:
+        try:
+            proc.wait(5)
+        except subprocess.TimeoutExpired:
+            proc.kill()
+            proc.wait()
+
+    if "Bench: done" not in lines:
+        tail = "\n".join(lines[-20:])
+        sys.exit(f"{emulator}: the benchmarks didn't finish, is {cue} a -DTETRADE_BENCH=ON build?\n{tail}")
+
+    return lines
+
+
+def parse(lines):
+    results = {"context": {}, "benchmarks": []}
+
+    for line in lines:
+        m = HEADER_RE.search(line)
+        if m:
+            results["context"] = {"frames": int(m.group(2)), "cycles_per_frame": int(m.group(3))}
+            continue
+
+        m = RESULT_RE.search(line)
+        if m:
+            results["benchmarks"].append({
+                "name": m.group(1),
+                "cycles_min": int(m.group(2)),
+                "cycles_avg": int(m.group(3)),
+                "cycles_max": int(m.group(4)),
+                "frame_percent": int(m.group(5)),
+                "prim_bytes": int(m.group(6)),
+            })
+
+    return results
+
+
+def compare(baseline, results, threshold):
+    """Prints the change in average cycles, returns the scenarios that got
+    slower than threshold."""
+    old = {b["name"]: b for b in baseline["benchmarks"]}
+    slower = []
+
+    print(f"{'Scenario':16} {'old avg':>10} {'new avg':>10} {'change':>9}")
+    for b in results["benchmarks"]:
+        if b["name"] not in old:
+            print(f"{b['name']:16} {'':>10} {b['cycles_avg']:10} {'new':>9}")
+            continue
+
+        a = old[b["name"]]["cycles_avg"]
+        change = (b["cycles_avg"] - a) * 100 / a if a else 0
+        mark = ""
+        if change > threshold:
+            mark = " slower"
+            slower.append(b["name"])
+        print(f"{b['name']:16} {a:10} {b['cycles_avg']:10} {change:8.1f}%{mark}")
+
+    return slower
+
+
+def main(argv):
+    args = argv[1:]
+    options = {"--emulator": os.environ.get("PCSX_REDUX", "pcsx-redux"), "--timeout": DEFAULT_TIMEOUT,
+               "--json": None, "--baseline": None, "--threshold": DEFAULT_THRESHOLD}
+
+    while len(args) > 1 and args[0] in options:
+        options[args[0]] = args[1]
+        args = args[2:]
+
+    if len(args) != 1:
+        sys.exit(__doc__)
+
+    lines = run_emulator(options["--emulator"], args[0], float(options["--timeout"]))
+    results = parse(lines)
+
+    if not results["benchmarks"]:
+        sys.exit("no results in the TTY output")
+
+    if options["--json"]:
+        with open(options["--json"], "w") as f:
+            json.dump(results, f, indent=2)
+
+    if options["--baseline"]:
+        with open(options["--baseline"], "r") as f:
+            baseline = json.load(f)
+
+        slower = compare(baseline, results, float(options["--threshold"]))
+        if slower:
+            sys.exit(f"slower than the baseline: {', '.join(slower)}")
+
+
+if __name__ == "__main__":
+    main(sys.argv)
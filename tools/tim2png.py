@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+"""
+Converts a 4bpp or 8bpp TIM back to an RGBA PNG, for turning hand-made TIMs
+into sources for tools/timpack.py.
+
+Colour 0x0000 becomes fully transparent and everything else opaque. The
+semi-transparency bit is dropped, timpack.py sets it again on black so it
+stays opaque.
+
+Usage: tim2png.py <input.tim> <output.png>
+"""
+
+import struct
+import sys
+
+from pngio import write_png
+
+
+def to_rgba(c):
+    if c == 0:
+        return (0, 0, 0, 0)
+
+    r, g, b = c & 31, (c >> 5) & 31, (c >> 10) & 31
+    return ((r << 3) | (r >> 2), (g << 3) | (g >> 2), (b << 3) | (b >> 2), 255)
+
+
+def read_tim(path):
+    with open(path, "rb") as f:
+        data = f.read()
+
+    magic, flags = struct.unpack_from("<II", data, 0)
+    mode = flags & 3
+    if magic & 0xFF != 0x10 or mode > 1 or not flags & 8:
+        sys.exit(f"{path}: only 4bpp and 8bpp TIMs with a CLUT are supported")
+
+    pos = 8
+    length, _, wh = struct.unpack_from("<III", data, pos)
+    clut = struct.unpack_from(f"<{(wh & 0xFFFF) * (wh >> 16)}H", data, pos + 12)
+    pos += length
+
+    _, _, wh = struct.unpack_from("<III", data, pos)
+    w, h = wh & 0xFFFF, wh >> 16
+    pixels = data[pos + 12:pos + 12 + w * h * 2]
+
+    if mode == 1:
+        indices = list(pixels)
+        width = w * 2
+    else:
+        indices = [n for b in pixels for n in (b & 15, b >> 4)]
+        width = w * 4
+
+    return width, h, [to_rgba(clut[i]) for i in indices]
+
+
+def main(argv):
+    if len(argv) != 3:
+        sys.exit(__doc__)
+
+    width, height, pixels = read_tim(argv[1])
+    write_png(argv[2], width, height, pixels)
+
+
+if __name__ == "__main__":
+    main(sys.argv)
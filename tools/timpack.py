@@ -0,0 +1,293 @@
+#!/usr/bin/env python3
+"""
+Builds a texture atlas TIM and a C header of where everything is in it from
+PNG sprite sheets.
+
+The manifest lists one sheet per line:
+    <name> <source.png> <cell width>x<cell height> [lossy]
+Sheets are cut into cells left to right, top to bottom.
+
+- Colours are converted to 15-bit. Fully transparent pixels become 0x0000.
+  Black and partly transparent pixels get the semi-transparency bit, so
+  black stays opaque.
+- The atlas is 4bpp when every cell fits in 16 colours, otherwise 8bpp. In
+  4bpp each cell has its own palette, in 8bpp each sheet does. Cells of
+  sheets marked lossy are reduced to 16 colours by merging the closest
+  colours.
+- Palettes are merged into as few CLUTs as possible, so cells and sheets
+  sharing colours share a CLUT. The TIM holds all of them as one CLUT block,
+  a row per CLUT.
+- Sheets are shelf packed into one texture page, 256 texels wide.
+
+The header gives an AtlasSheet (see graphics2d.h) per sheet, named
+<ATLAS>_<NAME> after the output file and sheet names.
+
+Usage: timpack.py <manifest> <output.tim> <output.h>
+"""
+
+import os
+import struct
+import sys
+
+from pngio import read_png
+
+PAGE_SIZE = 256
+
+
+def to_psx(r, g, b, a):
+    if a == 0:
+        return 0
+
+    c = (r >> 3) | ((g >> 3) << 5) | ((b >> 3) << 10)
+    if a < 255 or c == 0:
+        c |= 0x8000
+    return c
+
+
+def _rgb(c):
+    return (c & 31, (c >> 5) & 31, (c >> 10) & 31)
+
+
+def reduce_colors(pixels, limit):
+    """Merges the closest pair of colours until at most limit are left."""
+    counts = {}
+    for c in pixels:
+        counts[c] = counts.get(c, 0) + 1
+
+    remap = {c: c for c in counts}
+
+    while len(counts) > limit:
+        opaque = [c for c in counts if c != 0]
+        best = None
+
+        for i, a in enumerate(opaque):
+            ra = _rgb(a)
+            for b in opaque[i + 1:]:
+                rb = _rgb(b)
+                d = sum((x - y) ** 2 for x, y in zip(ra, rb))
+                if best is None or d < best[0]:
+                    best = (d, a, b)
+
+        _, a, b = best
+        na, nb = counts.pop(a), counts.pop(b)
+        mixed = [(x * na + y * nb + (na + nb) // 2) // (na + nb) for x, y in zip(_rgb(a), _rgb(b))]
+        c = mixed[0] | (mixed[1] << 5) | (mixed[2] << 10) | ((a | b) & 0x8000)
+        if c == 0:
+            c = 0x8000
+
+        counts[c] = counts.get(c, 0) + na + nb
+        for k, v in remap.items():
+            if v in (a, b):
+                remap[k] = c
+
+    return [remap[c] for c in pixels]
+
+
+class Sheet:
+    def __init__(self, name, path, cell_w, cell_h, lossy):
+        self.name = name
+        self.cell_w = cell_w
+        self.cell_h = cell_h
+        self.lossy = lossy
+
+        self.width, self.height, rgba = read_png(path)
+        if self.width % cell_w or self.height % cell_h:
+            sys.exit(f"{path}: {self.width}x{self.height} is not a multiple of the {cell_w}x{cell_h} cell size")
+        if self.width > PAGE_SIZE or self.height > PAGE_SIZE:
+            sys.exit(f"{path}: larger than a texture page")
+
+        self.cols = self.width // cell_w
+        self.pixels = [to_psx(*p) for p in rgba]
+        self.cells = []
+
+        for cy in range(0, self.height, cell_h):
+            for cx in range(0, self.width, cell_w):
+                self.cells.append([(cx + x, cy + y) for y in range(cell_h) for x in range(cell_w)])
+
+        if lossy:
+            for cell in self.cells:
+                reduced = reduce_colors([self.pixel(x, y) for x, y in cell], 16)
+                for (x, y), c in zip(cell, reduced):
+                    self.pixels[y * self.width + x] = c
+
+        self.u = self.v = 0
+        self.cell_cluts = []
+
+    def pixel(self, x, y):
+        return self.pixels[y * self.width + x]
+
+    def cell_colors(self, cell):
+        return {self.pixel(x, y) for x, y in cell}
+
+
+def read_manifest(path):
+    base = os.path.dirname(os.path.abspath(path))
+    sheets = []
+
+    with open(path, "r") as f:
+        for lineno, line in enumerate(f, 1):
+            line = line.split("#", 1)[0].strip()
+            if not line:
+                continue
+
+            fields = line.split()
+            try:
+                name, source, cell = fields[:3]
+                cell_w, cell_h = (int(n) for n in cell.lower().split("x"))
+                if fields[3:] not in ([], ["lossy"]):
+                    raise ValueError
+            except ValueError:
+                sys.exit(f"{path}:{lineno}: expected '<name> <source.png> <w>x<h> [lossy]'")
+
+            sheets.append(Sheet(name, os.path.join(base, source), cell_w, cell_h, len(fields) == 4))
+
+    return sheets
+
+
+def build_cluts(units, size):
+    """Packs colour sets into CLUTs of size colours, biggest sets first.
+    Returns the CLUTs and the index of the CLUT used by each unit."""
+    cluts = []
+    assignment = [None] * len(units)
+
+    for i in sorted(range(len(units)), key=lambda i: -len(units[i])):
+        colors = units[i]
+        best = None
+
+        for j, clut in enumerate(cluts):
+            if len(clut | colors) <= size:
+                overlap = len(clut & colors)
+                if best is None or overlap > best[0]:
+                    best = (overlap, j)
+
+        if best is None:
+            cluts.append(set(colors))
+            assignment[i] = len(cluts) - 1
+        else:
+            cluts[best[1]] |= colors
+            assignment[i] = best[1]
+
+    # Transparent first, the rest in a stable order
+    ordered = [sorted(clut, key=lambda c: (c != 0, c)) for clut in cluts]
+    return ordered, assignment
+
+
+def pack_sheets(sheets):
+    """Shelf packs sheets into a page, returns the used width and height."""
+    x = y = shelf = width = 0
+
+    for sheet in sorted(sheets, key=lambda s: (-s.height, -s.width)):
+        if x + sheet.width > PAGE_SIZE:
+            x = 0
+            y += shelf
+            shelf = 0
+
+        sheet.u, sheet.v = x, y
+        x += sheet.width
+        shelf = max(shelf, sheet.height)
+        width = max(width, x)
+
+    height = y + shelf
+    if height > PAGE_SIZE:
+        sys.exit("sheets don't fit in one texture page")
+
+    return width, height
+
+
+def build_atlas(sheets):
+    four_bit = all(len(s.cell_colors(c)) <= 16 for s in sheets for c in s.cells)
+    clut_size = 16 if four_bit else 256
+
+    # A palette per cell for 4bpp, per sheet for 8bpp
+    units = []
+    owners = []
+    for s in sheets:
+        if four_bit:
+            for cell in s.cells:
+                units.append(s.cell_colors(cell))
+                owners.append((s, [cell]))
+        else:
+            units.append({c for c in s.pixels})
+            owners.append((s, s.cells))
+
+    for colors, (s, _) in zip(units, owners):
+        if len(colors) > clut_size:
+            sys.exit(f"{s.name}: {len(colors)} colours, more than fit in a CLUT")
+
+    cluts, assignment = build_cluts(units, clut_size)
+
+    width, height = pack_sheets(sheets)
+    texels_per_halfword = 4 if four_bit else 2
+    width = (width + texels_per_halfword - 1) // texels_per_halfword * texels_per_halfword
+
+    indices = [0] * (width * height)
+    for (s, cells), clut_index in zip(owners, assignment):
+        lookup = {c: i for i, c in enumerate(cluts[clut_index])}
+        for cell in cells:
+            s.cell_cluts.append(clut_index)
+            for x, y in cell:
+                indices[(s.v + y) * width + s.u + x] = lookup[s.pixel(x, y)]
+
+    return four_bit, cluts, clut_size, width, height, indices
+
+
+def write_tim(path, four_bit, cluts, clut_size, width, height, indices):
+    clut_data = b"".join(struct.pack(f"<{clut_size}H", *(clut + [0] * (clut_size - len(clut)))) for clut in cluts)
+
+    if four_bit:
+        pixel_data = bytes(indices[i] | (indices[i + 1] << 4) for i in range(0, len(indices), 2))
+        w = width // 4
+    else:
+        pixel_data = bytes(indices)
+        w = width // 2
+
+    with open(path, "wb") as f:
+        # Positions are left at 0, the game's VRam allocator places both
+        f.write(struct.pack("<II", 0x10, (0 if four_bit else 1) | 8))
+        f.write(struct.pack("<IHHHH", 12 + len(clut_data), 0, 0, clut_size, len(cluts)))
+        f.write(clut_data)
+        f.write(struct.pack("<IHHHH", 12 + len(pixel_data), 0, 0, w, height))
+        f.write(pixel_data)
+
+
+def write_header(path, manifest, prefix, sheets):
+    lines = [
+        f"// Generated by tools/timpack.py from {os.path.basename(manifest)}, do not edit.",
+        "",
+        "#pragma once",
+        "",
+        '#include "engine/graphics2d.h"',
+        "",
+    ]
+
+    for s in sheets:
+        ident = f"{prefix}_{s.name.upper()}"
+        cluts = ", ".join(str(c) for c in s.cell_cluts)
+        lines += [
+            f"static const uint8_t {ident}_CLUTS[{len(s.cells)}] = {{ {cluts} }};",
+            f"static const AtlasSheet {ident} = {{ {s.u}, {s.v}, {s.cell_w}, {s.cell_h}, "
+            f"{s.cols}, {len(s.cells)}, {ident}_CLUTS }};",
+            "",
+        ]
+
+    with open(path, "w") as f:
+        f.write("\n".join(lines))
+
+
+def main(argv):
+    if len(argv) != 4:
+        sys.exit(__doc__)
+
+    sheets = read_manifest(argv[1])
+    four_bit, cluts, clut_size, width, height, indices = build_atlas(sheets)
+
+    write_tim(argv[2], four_bit, cluts, clut_size, width, height, indices)
+
+    prefix = os.path.splitext(os.path.basename(argv[2]))[0].upper()
+    write_header(argv[3], argv[1], prefix, sheets)
+
+    print(f"{prefix}: {width}x{height} {'4' if four_bit else '8'}bpp, {len(cluts)} CLUTs")
+
+
+if __name__ == "__main__":
+    main(sys.argv)